@@ -76,7 +76,7 @@ static int zbk_info_get(struct device *dev, struct zio_attribute *zattr,
 
 	return 0;
 }
-struct zio_sysfs_operations zbk_sysfs_ops = {
+static struct zio_sysfs_operations zbk_sysfs_ops = {
 	.conf_set = zbk_conf_set,
 	.info_get = zbk_info_get,
 };
@@ -141,12 +141,6 @@ static void zbk_free_block(struct zio_bi *bi, struct zio_block *block)
 	item = to_item(block);
 	zbki = item->instance;
 
-	if (bi->flags & ZIO_BI_PUSHING) {
-		/* freed while pushing: we hold the bi lock already */
-		zbki->nitem--;
-		goto out_free;
-	}
-
 	spin_lock_irqsave(&bi->lock, flags);
 
 	if (((bi->flags & ZIO_DIR) == ZIO_DIR_OUTPUT) &&
@@ -156,7 +150,6 @@ static void zbk_free_block(struct zio_bi *bi, struct zio_block *block)
 	zbki->nitem--;
 	spin_unlock_irqrestore(&bi->lock, flags);
 
-out_free:
 	kfree(block->data);
 	zio_free_control(zio_get_ctrl(block));
 	kmem_cache_free(zbk_slab, item);
@@ -171,7 +164,7 @@ static int zbk_store_block(struct zio_bi *bi, struct zio_block *block)
 	struct zio_channel *chan = bi->chan;
 	struct zbk_item *item = to_item(block);
 	unsigned long flags;
-	int awake = 0, pushed = 0, isempty;
+	int awake = 0, isempty;
 	int output = (bi->flags & ZIO_DIR) == ZIO_DIR_OUTPUT;
 
 	pr_debug("%s:%d (%p, %p)\n", __func__, __LINE__, bi, block);
@@ -179,17 +172,36 @@ static int zbk_store_block(struct zio_bi *bi, struct zio_block *block)
 	/* add to the buffer instance or push to the trigger */
 	spin_lock_irqsave(&bi->lock, flags);
 	isempty = list_empty(&zbki->list);
-	if (isempty) {
-		if (unlikely(output))
-			pushed = zio_trigger_try_push(bi, chan, block);
-		else
-			awake = 1;
-	}
-	if (!pushed)
+	if (likely(!output) || !isempty || (bi->flags & ZIO_BI_PUSHING)) {
 		list_add_tail(&item->list, &zbki->list);
+		awake = isempty && !output;
+		spin_unlock_irqrestore(&bi->lock, flags);
+		goto out;
+	}
 
+	/*
+	 * Push without our lock, as the trigger takes the cset lock.
+	 * Writers coming meanwhile queue their block: we push them too.
+	 */
+	bi->flags |= ZIO_BI_PUSHING;
+	while (item) {
+		spin_unlock_irqrestore(&bi->lock, flags);
+		if (!zio_trigger_try_push(bi, chan, &item->block)) {
+			spin_lock_irqsave(&bi->lock, flags);
+			list_add(&item->list, &zbki->list); /* still the first */
+			break;
+		}
+		spin_lock_irqsave(&bi->lock, flags);
+		item = NULL;
+		if (!list_empty(&zbki->list)) {
+			item = list_entry(zbki->list.next, struct zbk_item, list);
+			list_del(&item->list);
+		}
+	}
+	bi->flags &= ~ZIO_BI_PUSHING;
 	spin_unlock_irqrestore(&bi->lock, flags);
 
+out:
 	/* if first input, awake user space */
 	if (awake)
 		wake_up_interruptible(&bi->q);
@@ -207,11 +219,6 @@ static struct zio_block *zbk_retr_block(struct zio_bi *bi)
 
 	zbki = to_zbki(bi);
 
-	/* PUSHING is only active temporarily during locked context */
-	if (bi->flags & ZIO_BI_PUSHING)
-		return NULL;
-
-	/* There is no trig->push in our call trace, proceed to get the lock */
 	spin_lock_irqsave(&bi->lock, flags);
 	if (list_empty(&zbki->list))
 		goto out_unlock;
@@ -282,6 +289,7 @@ static const struct zio_buffer_operations zbk_buffer_ops = {
 
 static struct zio_buffer_type zbk_buffer = {
 	.owner =	THIS_MODULE,
+	.flags =	ZIO_BUF_FLAG_OWN_DATA, /* kfree(block->data) */
 	.zattr_set = {
 		.std_zattr = zbk_std_zattr,
 	},
@@ -163,7 +163,7 @@ static int zbk_info_get(struct device *dev, struct zio_attribute *zattr,
 
 	return 0;
 }
-struct zio_sysfs_operations zbk_sysfs_ops = {
+static struct zio_sysfs_operations zbk_sysfs_ops = {
 	.conf_set = zbk_conf_set,
 	.info_get = zbk_info_get,
 };
@@ -228,18 +228,11 @@ static void zbk_free_block(struct zio_bi *bi, struct zio_block *block)
 	item = to_item(block);
 	zbki = item->instance;
 
-	if (bi->flags & ZIO_BI_PUSHING) {
-		/* freed while pushing: we hold the bi lock already */
-		zbki->alloc_size -= item->len;
-		goto out_free;
-	}
-
 	spin_lock_irqsave(&bi->lock, flags);
 	zbki->alloc_size -= item->len;
 	bi->flags &= ~ZIO_BI_NOSPACE;
 	spin_unlock_irqrestore(&bi->lock, flags);
 
-out_free:
 	zio_ffa_free_s(zbki->ffa, item->begin, item->len);
 	zio_free_control(ctrl);
 	kmem_cache_free(zbk_slab, item);
@@ -276,7 +269,7 @@ static int zbk_store_block(struct zio_bi *bi, struct zio_block *block)
 	struct zio_channel *chan = bi->chan;
 	struct zbk_item *item;
 	unsigned long flags;
-	int awake = 0, pushed = 0, output, first;
+	int awake = 0, output, first;
 
 	pr_debug("%s:%d (%p, %p)\n", __func__, __LINE__, bi, block);
 
@@ -288,19 +281,38 @@ static int zbk_store_block(struct zio_bi *bi, struct zio_block *block)
 	/* add to the buffer instance or push to the trigger */
 	spin_lock_irqsave(&bi->lock, flags);
 	first = list_empty(&zbki->list);
-	if (first) {
-		if (unlikely(output))
-			pushed = zio_trigger_try_push(bi, chan, block);
-		else
-			awake = 1;
-	}
-	if (!pushed)
+	if (likely(!output) || !first || (bi->flags & ZIO_BI_PUSHING)) {
 		list_add_tail(&item->list, &zbki->list);
+		awake = first && !output;
+		if (!first && zbki->flags & ZBK_FLAG_MERGE_DATA)
+			zbk_try_merge(zbki, item);
+		spin_unlock_irqrestore(&bi->lock, flags);
+		goto out;
+	}
 
-	if (!first && zbki->flags & ZBK_FLAG_MERGE_DATA)
-		zbk_try_merge(zbki, item);
+	/*
+	 * Push without our lock, as the trigger takes the cset lock.
+	 * Writers coming meanwhile queue their block: we push them too.
+	 */
+	bi->flags |= ZIO_BI_PUSHING;
+	while (item) {
+		spin_unlock_irqrestore(&bi->lock, flags);
+		if (!zio_trigger_try_push(bi, chan, &item->block)) {
+			spin_lock_irqsave(&bi->lock, flags);
+			list_add(&item->list, &zbki->list); /* still the first */
+			break;
+		}
+		spin_lock_irqsave(&bi->lock, flags);
+		item = NULL;
+		if (!list_empty(&zbki->list)) {
+			item = list_entry(zbki->list.next, struct zbk_item, list);
+			list_del(&item->list);
+		}
+	}
+	bi->flags &= ~ZIO_BI_PUSHING;
 	spin_unlock_irqrestore(&bi->lock, flags);
 
+out:
 	/* if first input, awake user space */
 	if (awake)
 		wake_up_interruptible(&bi->q);
@@ -319,11 +331,6 @@ static struct zio_block *zbk_retr_block(struct zio_bi *bi)
 
 	zbki = to_zbki(bi);
 
-	/* PUSHING is only active temporarily during locked context */
-	if (bi->flags & ZIO_BI_PUSHING)
-		return NULL;
-
-	/* There is no trig->push in our call trace, proceed to get the lock */
 	spin_lock_irqsave(&bi->lock, flags);
 	if (list_empty(&zbki->list))
 		goto out_unlock;
@@ -316,6 +316,8 @@ static int zio_can_r_ctrl(struct zio_f_priv *priv)
 	ret = 0;
 	if (chan->user_block)
 		ret = ret_ok;
+	else if (unlikely(bi->cset->ti->flags & ZIO_TI_COMPLETED))
+		ret = POLLHUP; /* end of run */
 	else if (unlikely(bi->cset->ti->flags & ZIO_DISABLED))
 		ret = POLLERR;
 
@@ -343,6 +345,8 @@ static int zio_can_r_data(struct zio_f_priv *priv)
 	mutex_unlock(&chan->user_lock);
 	if (block)
 		return ret_ok;
+	if (unlikely(bi->cset->ti->flags & ZIO_TI_COMPLETED))
+		return POLLHUP; /* end of run */
 	return 0;
 }
 
@@ -444,6 +448,8 @@ static ssize_t zio_generic_read(struct file *f, char __user *ubuf,
 
 	while (1) {
 		rflags = can_read(priv);
+		if (unlikely(rflags == POLLHUP))
+			return 0; /* nshots are over and data is consumed */
 		if (rflags == 0 || rflags == POLLERR) {
 			if (f->f_flags & O_NONBLOCK)
 				return -EAGAIN;
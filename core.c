@@ -121,6 +121,9 @@ static int __init zio_init(void)
 	err = zio_slab_init();
 	if (err)
 		return err;
+	err = zio_done_queue_init();
+	if (err)
+		goto out_done;
 	/* Register ZIO bus */
 	err = bus_register(&zio_bus_type);
 	if (err)
@@ -154,6 +157,8 @@ static int __init zio_init(void)
 out_cdev:
 	bus_unregister(&zio_bus_type);
 out:
+	zio_done_queue_exit();
+out_done:
 	zio_slab_exit();
 	return err;
 }
@@ -168,6 +173,7 @@ static void __exit zio_exit(void)
 	zio_unregister_cdev();
 	/* Remove ZIO bus */
 	bus_unregister(&zio_bus_type);
+	zio_done_queue_exit();
 	zio_slab_exit();
 	pr_info("zio-core had been unloaded\n");
 	return;
@@ -0,0 +1,511 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * zio-bench measures the cost of the framework: the buffer operations
+ * (alloc, store, retr, free) of whatever buffer type the device uses,
+ * and the zio_arm_trigger -> raw_io -> data_done path of its trigger.
+ * It registers a device with one input cset, whose raw_io completes at
+ * once, and it runs a producer and a consumer thread on the chosen CPUs.
+ *
+ * Everything is in debugfs, in "zio-bench/": write the parameters, then
+ * write 1 to "run"; "stats" reports ops/s, percentiles of ns per op and
+ * allocation failures. The device must be otherwise idle while running.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/cpumask.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <asm/uaccess.h>
+
+#include <linux/zio.h>
+#include <linux/zio-buffer.h>
+#include <linux/zio-trigger.h>
+
+ZIO_PARAM_TRIGGER(zbench_trigger);
+ZIO_PARAM_BUFFER(zbench_buffer);
+
+static int zbench_nchan = 1;
+module_param_named(nchan, zbench_nchan, int, 0444);
+
+#define ZBENCH_NCHAN_MAX 64
+
+enum zbench_workload {
+	ZBENCH_WL_BUFFER,	/* producer: alloc+store; consumer: retr+free */
+	ZBENCH_WL_TRIGGER,	/* producer: arm; consumer: retr+free */
+};
+
+enum zbench_op {
+	ZBENCH_ALLOC,
+	ZBENCH_STORE,
+	ZBENCH_RETR,
+	ZBENCH_FREE,
+	ZBENCH_ARM,
+	ZBENCH_NOPS,
+};
+
+static const char *zbench_op_names[ZBENCH_NOPS] = {
+	[ZBENCH_ALLOC] =	"alloc_block",
+	[ZBENCH_STORE] =	"store_block",
+	[ZBENCH_RETR] =		"retr_block",
+	[ZBENCH_FREE] =		"free_block",
+	[ZBENCH_ARM] =		"arm_trigger",
+};
+
+/*
+ * A log-linear histogram: 8 linear steps for each power of two, so a
+ * percentile is known within 12.5%. Each histogram is written by one
+ * thread only, so no locking is needed.
+ */
+#define ZBENCH_SUB_BITS		3
+#define ZBENCH_NBUCKETS		((64 - ZBENCH_SUB_BITS + 1) << ZBENCH_SUB_BITS)
+
+struct zbench_hist {
+	uint64_t		n, sum, min, max;
+	uint64_t		bucket[ZBENCH_NBUCKETS];
+};
+
+static struct {
+	/* parameters, in debugfs */
+	u32			workload;
+	u32			count; /* blocks produced */
+	u32			block_size; /* bytes, buffer workload only */
+	u32			prod_cpu, cons_cpu; /* -1: any */
+
+	/* the run */
+	struct zio_cset		*cset;
+	int			running, stop, producer_done;
+	struct completion	prod_done, cons_done;
+	ktime_t			start, end;
+
+	/* the results */
+	struct zbench_hist	hist[ZBENCH_NOPS];
+	uint64_t		alloc_fail, store_fail;
+} zbench = {
+	.workload = ZBENCH_WL_BUFFER,
+	.count = 100000,
+	.block_size = 4096,
+	.prod_cpu = -1,
+	.cons_cpu = -1,
+};
+
+static struct dentry *zbench_dir;
+
+static int zbench_bucket(uint64_t v)
+{
+	int msb;
+
+	if (v < (1 << ZBENCH_SUB_BITS))
+		return v;
+	msb = fls64(v) - 1;
+	return ((msb - ZBENCH_SUB_BITS + 1) << ZBENCH_SUB_BITS) +
+		((v >> (msb - ZBENCH_SUB_BITS)) & ((1 << ZBENCH_SUB_BITS) - 1));
+}
+
+/* The lowest value in a bucket, the inverse of the above */
+static uint64_t zbench_bucket_value(int b)
+{
+	int shift = (b >> ZBENCH_SUB_BITS) - 1;
+	uint64_t sub = b & ((1 << ZBENCH_SUB_BITS) - 1);
+
+	if (shift < 0)
+		return b;
+	return ((1ULL << ZBENCH_SUB_BITS) | sub) << shift;
+}
+
+static void zbench_account(enum zbench_op op, ktime_t t0, ktime_t t1)
+{
+	struct zbench_hist *h = zbench.hist + op;
+	uint64_t ns = ktime_to_ns(ktime_sub(t1, t0));
+
+	if (!h->n || ns < h->min)
+		h->min = ns;
+	if (ns > h->max)
+		h->max = ns;
+	h->n++;
+	h->sum += ns;
+	h->bucket[zbench_bucket(ns)]++;
+}
+
+/* The value at "permille", as the lower bound of its bucket */
+static uint64_t zbench_percentile(struct zbench_hist *h, int permille)
+{
+	uint64_t target = div_u64(h->n * permille, 1000), seen = 0;
+	int b;
+
+	for (b = 0; b < ZBENCH_NBUCKETS; b++) {
+		seen += h->bucket[b];
+		if (seen > target)
+			return zbench_bucket_value(b);
+	}
+	return h->max;
+}
+
+/*
+ * The device: raw_io completes at once, so zio_arm_trigger runs the
+ * whole path up to data_done before returning
+ */
+static int zbench_raw_io(struct zio_cset *cset)
+{
+	struct zio_channel *chan;
+
+	chan_for_each(chan, cset)
+		if (!chan->active_block)
+			zbench.alloc_fail++; /* only the producer arms */
+	return 0; /* Already done */
+}
+
+static struct zio_cset zbench_cset[] = {
+	{
+		ZIO_SET_OBJ_NAME("bench-in"),
+		.raw_io =	zbench_raw_io,
+		.flags =	ZIO_DIR_INPUT,
+		.n_chan =	1, /* changed at insmod */
+		.ssize =	1,
+	},
+};
+
+static struct zio_device zbench_tmpl = {
+	.owner =		THIS_MODULE,
+	.cset =			zbench_cset,
+	.n_cset =		ARRAY_SIZE(zbench_cset),
+};
+
+static const struct zio_device_id zbench_table[] = {
+	{"zbench", &zbench_tmpl},
+	{},
+};
+
+static struct zio_device *zbench_probed_dev;
+static int zbench_probe(struct zio_device *zdev)
+{
+	zbench_probed_dev = zdev;
+	return 0;
+}
+
+static struct zio_driver zbench_zdrv = {
+	.driver = {
+		.name = "zbench",
+		.owner = THIS_MODULE,
+	},
+	.id_table = zbench_table,
+	.probe = zbench_probe,
+	/* All drivers compiled within the ZIO projects are compatibile
+	   with the last version */
+	.min_version = ZIO_VERSION(1, 1, 0),
+};
+
+/* The two threads */
+static void zbench_produce_block(struct zio_channel *chan)
+{
+	const struct zio_buffer_operations *b_op = chan->bi->b_op;
+	struct zio_block *block;
+	ktime_t t0, t1;
+
+	t0 = ktime_get();
+	block = b_op->alloc_block(chan->bi, zbench.block_size, GFP_KERNEL);
+	t1 = ktime_get();
+	if (!block) {
+		zbench.alloc_fail++;
+		return;
+	}
+	zbench_account(ZBENCH_ALLOC, t0, t1);
+	memcpy(zio_get_ctrl(block), chan->current_ctrl,
+	       zio_control_size(chan));
+
+	t0 = ktime_get();
+	if (b_op->store_block(chan->bi, block)) {
+		zbench.store_fail++;
+		b_op->free_block(chan->bi, block);
+		return;
+	}
+	t1 = ktime_get();
+	zbench_account(ZBENCH_STORE, t0, t1);
+}
+
+static int zbench_producer(void *arg)
+{
+	struct zio_cset *cset = zbench.cset;
+	ktime_t t0;
+	int i;
+
+	for (i = 0; i < zbench.count && !ACCESS_ONCE(zbench.stop); i++) {
+		if (zbench.workload == ZBENCH_WL_BUFFER) {
+			zbench_produce_block(cset->chan + i % cset->n_chan);
+		} else {
+			t0 = ktime_get();
+			zio_arm_trigger(cset->ti);
+			zbench_account(ZBENCH_ARM, t0, ktime_get());
+		}
+		if (need_resched())
+			schedule();
+	}
+	zbench.producer_done = 1;
+	complete(&zbench.prod_done);
+	return 0;
+}
+
+static int zbench_consumer(void *arg)
+{
+	struct zio_cset *cset = zbench.cset;
+	struct zio_channel *chan;
+	struct zio_block *block;
+	ktime_t t0, t1;
+	int done, any;
+
+	do {
+		/* check before the last pass */
+		done = ACCESS_ONCE(zbench.producer_done);
+		any = 0;
+		chan_for_each(chan, cset) {
+			t0 = ktime_get();
+			block = chan->bi->b_op->retr_block(chan->bi);
+			t1 = ktime_get();
+			if (!block)
+				continue;
+			zbench_account(ZBENCH_RETR, t0, t1);
+			any = 1;
+			t0 = ktime_get();
+			chan->bi->b_op->free_block(chan->bi, block);
+			zbench_account(ZBENCH_FREE, t0, ktime_get());
+		}
+		if (!any && need_resched())
+			schedule();
+	} while (any || !done);
+	zbench.end = ktime_get();
+	complete(&zbench.cons_done);
+	return 0;
+}
+
+static struct task_struct *zbench_thread(int (*fn)(void *), u32 cpu,
+					 const char *name)
+{
+	struct task_struct *t;
+
+	t = kthread_create(fn, NULL, "zio-bench-%s", name);
+	if (!IS_ERR(t) && cpu != (u32)-1)
+		kthread_bind(t, cpu);
+	return t;
+}
+
+static int zbench_start(void)
+{
+	struct task_struct *prod, *cons;
+	int i;
+
+	if (zbench.prod_cpu != (u32)-1 && !cpu_online(zbench.prod_cpu))
+		return -EINVAL;
+	if (zbench.cons_cpu != (u32)-1 && !cpu_online(zbench.cons_cpu))
+		return -EINVAL;
+	if (zbench.workload > ZBENCH_WL_TRIGGER || !zbench.block_size)
+		return -EINVAL;
+
+	for (i = 0; i < ZBENCH_NOPS; i++)
+		memset(zbench.hist + i, 0, sizeof(zbench.hist[i]));
+	zbench.alloc_fail = zbench.store_fail = 0;
+	zbench.stop = zbench.producer_done = 0;
+	init_completion(&zbench.prod_done);
+	init_completion(&zbench.cons_done);
+
+	prod = zbench_thread(zbench_producer, zbench.prod_cpu, "prod");
+	if (IS_ERR(prod))
+		return PTR_ERR(prod);
+	cons = zbench_thread(zbench_consumer, zbench.cons_cpu, "cons");
+	if (IS_ERR(cons)) {
+		/* a thread that never ran can't be stopped: let it exit */
+		zbench.stop = 1;
+		wake_up_process(prod);
+		wait_for_completion(&zbench.prod_done);
+		return PTR_ERR(cons);
+	}
+	zbench.running = 1;
+	zbench.start = ktime_get();
+	wake_up_process(cons);
+	wake_up_process(prod);
+	return 0;
+}
+
+/* Returns 0 if idle, after the previous run is collected */
+static int zbench_busy(void)
+{
+	if (!zbench.running)
+		return 0;
+	if (!completion_done(&zbench.prod_done) ||
+	    !completion_done(&zbench.cons_done))
+		return 1;
+	zbench.running = 0;
+	return 0;
+}
+
+/* debugfs */
+static DEFINE_MUTEX(zbench_mutex);
+
+static ssize_t zbench_run_write(struct file *f, const char __user *buf,
+				size_t count, loff_t *offp)
+{
+	char s[8] = {0, };
+	int err;
+
+	if (copy_from_user(s, buf, min(count, sizeof(s) - 1)))
+		return -EFAULT;
+	mutex_lock(&zbench_mutex);
+	if (s[0] == '0') {
+		zbench.stop = 1;
+		err = 0;
+	} else if (zbench_busy()) {
+		err = -EBUSY;
+	} else {
+		err = zbench_start();
+	}
+	mutex_unlock(&zbench_mutex);
+	return err ? err : count;
+}
+
+static const struct file_operations zbench_run_fops = {
+	.owner = THIS_MODULE,
+	.write = zbench_run_write,
+	.llseek = no_llseek,
+};
+
+static int zbench_stats_show(struct seq_file *m, void *v)
+{
+	struct zbench_hist *h;
+	uint64_t ns;
+	int i;
+
+	mutex_lock(&zbench_mutex);
+	if (zbench_busy()) {
+		seq_printf(m, "running\n");
+		goto out;
+	}
+	ns = ktime_to_ns(ktime_sub(zbench.end, zbench.start));
+	seq_printf(m, "workload %s, buffer %s, trigger %s, %i channels\n",
+		   zbench.workload == ZBENCH_WL_BUFFER ? "buffer" : "trigger",
+		   zbench.cset->zbuf->head.name,
+		   zbench.cset->trig->head.name, zbench.cset->n_chan);
+	seq_printf(m, "elapsed-ns %llu alloc-fail %llu store-fail %llu\n",
+		   ns, zbench.alloc_fail, zbench.store_fail);
+	seq_printf(m, "%-12s %10s %10s %8s %8s %8s %8s %8s %8s\n", "op",
+		   "count", "ops/s", "min", "avg", "p50", "p99", "p99.9",
+		   "max");
+	for (i = 0; i < ZBENCH_NOPS; i++) {
+		h = zbench.hist + i;
+		if (!h->n)
+			continue;
+		seq_printf(m, "%-12s %10llu %10llu %8llu %8llu %8llu %8llu "
+			   "%8llu %8llu\n", zbench_op_names[i], h->n,
+			   ns ? div64_u64(h->n * NSEC_PER_SEC, ns) : 0,
+			   h->min, div64_u64(h->sum, h->n),
+			   zbench_percentile(h, 500),
+			   zbench_percentile(h, 990),
+			   zbench_percentile(h, 999), h->max);
+	}
+out:
+	mutex_unlock(&zbench_mutex);
+	return 0;
+}
+
+static int zbench_stats_open(struct inode *inode, struct file *f)
+{
+	return single_open(f, zbench_stats_show, NULL);
+}
+
+static const struct file_operations zbench_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = zbench_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int zbench_debugfs_init(void)
+{
+	zbench_dir = debugfs_create_dir("zio-bench", NULL);
+	if (IS_ERR_OR_NULL(zbench_dir))
+		return zbench_dir ? PTR_ERR(zbench_dir) : -ENOMEM;
+	debugfs_create_u32("workload", 0644, zbench_dir, &zbench.workload);
+	debugfs_create_u32("count", 0644, zbench_dir, &zbench.count);
+	debugfs_create_u32("block-size", 0644, zbench_dir,
+			   &zbench.block_size);
+	debugfs_create_u32("producer-cpu", 0644, zbench_dir,
+			   &zbench.prod_cpu);
+	debugfs_create_u32("consumer-cpu", 0644, zbench_dir,
+			   &zbench.cons_cpu);
+	debugfs_create_file("run", 0200, zbench_dir, NULL, &zbench_run_fops);
+	debugfs_create_file("stats", 0444, zbench_dir, NULL,
+			    &zbench_stats_fops);
+	return 0;
+}
+
+static struct zio_device *zbench_dev;
+
+static int __init zbench_init(void)
+{
+	int err;
+
+	if (zbench_nchan < 1 || zbench_nchan > ZBENCH_NCHAN_MAX) {
+		pr_err("%s: nchan is %i: out of range\n", KBUILD_MODNAME,
+		       zbench_nchan);
+		return -EINVAL;
+	}
+	if (zbench_trigger)
+		zbench_tmpl.preferred_trigger = zbench_trigger;
+	if (zbench_buffer)
+		zbench_tmpl.preferred_buffer = zbench_buffer;
+	zbench_cset[0].n_chan = zbench_nchan;
+
+	err = zio_register_driver(&zbench_zdrv);
+	if (err)
+		return err;
+	zbench_dev = zio_allocate_device();
+	if (IS_ERR(zbench_dev)) {
+		err = PTR_ERR(zbench_dev);
+		goto out_alloc;
+	}
+	zbench_dev->owner = THIS_MODULE;
+	err = zio_register_device(zbench_dev, "zbench", 0);
+	if (err)
+		goto out_dev;
+	zbench.cset = zbench_probed_dev->cset;
+	err = zbench_debugfs_init();
+	if (err)
+		goto out_debugfs;
+	return 0;
+
+out_debugfs:
+	zio_unregister_device(zbench_dev);
+out_dev:
+	zio_free_device(zbench_dev);
+out_alloc:
+	zio_unregister_driver(&zbench_zdrv);
+	return err;
+}
+
+static void __exit zbench_exit(void)
+{
+	debugfs_remove_recursive(zbench_dir);
+	if (zbench.running) {
+		zbench.stop = 1;
+		wait_for_completion(&zbench.prod_done);
+		wait_for_completion(&zbench.cons_done);
+	}
+	zio_unregister_device(zbench_dev);
+	zio_free_device(zbench_dev);
+	zio_unregister_driver(&zbench_zdrv);
+}
+
+module_init(zbench_init);
+module_exit(zbench_exit);
+
+MODULE_VERSION(GIT_VERSION); /* Defined in local Makefile */
+MODULE_DESCRIPTION("Benchmark of ZIO buffers and triggers");
+MODULE_LICENSE("GPL");
+
+ADDITIONAL_VERSIONS;
@@ -25,6 +25,18 @@ ZIO_PARAM_BUFFER(ztdc_buffer);
 int ztdc_irq = -1;
 module_param_named(irq, ztdc_irq, int, 0444);
 
+/* If set, data_done is run by a worker, out of the interrupt handler */
+static int ztdc_defer;
+module_param_named(defer, ztdc_defer, int, 0444);
+
+static void ztdc_data_done(struct zio_cset *cset)
+{
+	if (ztdc_defer)
+		zio_trigger_data_done_defer(cset);
+	else
+		zio_trigger_data_done(cset);
+}
+
 /* The interrupt handler is taking timestamps and filling blocks */
 irqreturn_t ztdc_handler(int irq, void *dev_id)
 {
@@ -33,6 +45,8 @@ irqreturn_t ztdc_handler(int irq, void *dev_id)
 	struct zio_cset *cset;
 	struct zio_channel *chan;
 	struct zio_block *block;
+	unsigned long flags;
+	int done = 0;
 
 	getnstimeofday(&ts);
 
@@ -40,11 +54,15 @@ irqreturn_t ztdc_handler(int irq, void *dev_id)
 	 * fill cset 0: several per block. We return the block only when full,
 	 * Actually, if we get stop_io, we return it as partially-filled.
 	 * The first stamp is saved in the trigger too, whence it reaches the
-	 * control for all channels ad data_done time.
+	 * control for all channels ad data_done time. The cset lock
+	 * protects the block against stop_io and the deferred data_done.
 	 */
 	cset = dev->cset;
 	chan = cset->chan;
+	spin_lock_irqsave(&cset->lock, flags);
 	block = chan->active_block;
+	if (cset->flags & ZIO_CSET_DONE_PENDING)
+		block = NULL; /* full, but not yet stored */
 	if (block) {
 		if (!block->uoff)
 			cset->ti->tstamp = ts;
@@ -53,11 +71,14 @@ irqreturn_t ztdc_handler(int irq, void *dev_id)
 		block->uoff += sizeof(ts);
 		if (block->uoff == block->datalen) {
 			block->uoff = 0; /* for read method */
-			zio_trigger_data_done(cset);
+			done = 1;
 		}
 	} else {
 		chan->current_ctrl->zio_alarms |= ZIO_ALARM_LOST_TRIGGER;
 	}
+	spin_unlock_irqrestore(&cset->lock, flags);
+	if (done)
+		ztdc_data_done(cset);
 
 	/*
 	 * fill cset 1: a zero-size thing: save the stamp in the trigger
@@ -67,14 +88,19 @@ irqreturn_t ztdc_handler(int irq, void *dev_id)
 	 */
 	cset = dev->cset + 1;
 	chan = cset->chan;
+	spin_lock_irqsave(&cset->lock, flags);
 	block = chan->active_block;
+	if (cset->flags & ZIO_CSET_DONE_PENDING)
+		block = NULL;
 	if (block) {
 		cset->ti->tstamp = ts;
 		chan->current_ctrl->nsamples = 1;
-		zio_trigger_data_done(cset);
 	} else {
 		chan->current_ctrl->zio_alarms |= ZIO_ALARM_LOST_TRIGGER;
 	}
+	spin_unlock_irqrestore(&cset->lock, flags);
+	if (block)
+		ztdc_data_done(cset);
 	return IRQ_NONE; /* none because we rely on other devices */
 }
 
@@ -94,7 +120,7 @@ static void ztdc_stop_io(struct zio_cset *cset)
 			continue;
 		if (!block->uoff) {/* Empty: just free it */
 			zio_buffer_free_block(chan->bi, block);
-			chan->active_block = 0;
+			zio_set_active_block(chan, NULL);
 		} else {
 			/* Close up the partial block, and return it */
 			chan->current_ctrl->nsamples =
@@ -29,6 +29,9 @@
 ZIO_PARAM_TRIGGER(zloop_trigger);
 ZIO_PARAM_BUFFER(zloop_buffer);
 
+static int zloop_zerocopy;
+module_param_named(zerocopy, zloop_zerocopy, int, 0644);
+
 /* Name the csets. Use defines so as to stringify them */
 #define ZLOOP_CSET_OUT_LOOP		0
 #define ZLOOP_CSET_IN_LOOP		1
@@ -62,25 +65,31 @@ static struct zloop_cdev_data zloop_cdata[] = {
 /*
  * This is a pretty standard zio driver, with several csets.  Cset 2
  * and later act on the previously-defined data, to communicate with
- * char devs. Cset 0 and 1 work like this: the reader or writer waits
+ * char devs. Cset 0 and 1 are a join: the reader or writer waits
  * until both transfers are pending. When they are, data is exchanged.
  */
-static int zloop_wr_pending, zloop_rd_pending;
-DEFINE_SPINLOCK(zloop_lock);
+static struct zio_join zloop_join;
 
-static int zloop_complete(struct zio_device *zdev, int cset_index)
+static void zloop_join_io(struct zio_join *join)
 {
-	struct zio_cset *cset_out = zdev->cset + ZLOOP_CSET_OUT_LOOP;
-	struct zio_cset *cset_in = zdev->cset + ZLOOP_CSET_IN_LOOP;
+	struct zio_cset *cset_out = join->cset[0];
+	struct zio_cset *cset_in = join->cset[1];
 	struct zio_channel *ch_in, *ch_out;
 	struct zio_control *ctrl_in, *ctrl_out;
+	int zerocopy = zloop_zerocopy;
 	int isize, osize;
 	int i;
 
-	pr_debug("%s: pending is (%i,%i), cset %i\n", __func__,
-		 zloop_rd_pending, zloop_wr_pending, cset_index);
-	/* both are waiting, so clear the bits without locking*/
-	zloop_rd_pending = zloop_wr_pending = 0;
+	pr_debug("%s\n", __func__);
+
+	/*
+	 * With zerocopy, if both buffers allocate data for each block,
+	 * blocks of the same size exchange their data instead of copying:
+	 * the input block keeps its own control.
+	 */
+	if (!(cset_in->zbuf->flags & ZIO_BUF_FLAG_OWN_DATA) ||
+	    !(cset_out->zbuf->flags & ZIO_BUF_FLAG_OWN_DATA))
+		zerocopy = 0;
 
 	/* copy data from the input to the output. Can't use cset_for_each */
 	for (i = 0; i < cset_in->n_chan; i++) {
@@ -112,6 +121,13 @@ static int zloop_complete(struct zio_device *zdev, int cset_index)
 		ctrl_out = zio_get_ctrl(ch_out->active_block);
 		isize = ctrl_in->nsamples;
 		osize = ctrl_out->nsamples;
+		if (zerocopy && osize == isize &&
+		    ch_in->active_block->datalen ==
+		    ch_out->active_block->datalen) {
+			swap(ch_in->active_block->data,
+			     ch_out->active_block->data);
+			continue;
+		}
 		if (osize > isize)
 			osize = isize;
 		memcpy(ch_in->active_block->data, ch_out->active_block->data,
@@ -120,44 +136,11 @@ static int zloop_complete(struct zio_device *zdev, int cset_index)
 			memset(ch_in->active_block->data + osize, 0,
 			       isize - osize);
 	}
-
-	/* One is calling us, the other one must be notified */
-	if (cset_index == cset_out->index)
-		zio_trigger_data_done(cset_in);
-	else
-		zio_trigger_data_done(cset_out);
-	return 0; /* done now, for the caller */
 }
 
-static int zloop_try_complete(struct zio_device *zdev, int cset_index)
+static void zloop_stop_io(struct zio_cset *cset)
 {
-	int ret = -EAGAIN;
-
-	pr_debug("%s -- cset %i\n", __func__, cset_index);
-	spin_lock(&zloop_lock);
-	if (cset_index == ZLOOP_CSET_OUT_LOOP) {
-		if (zloop_wr_pending)
-			goto out_warn;
-		zloop_wr_pending++;
-		if (zloop_rd_pending) {
-			spin_unlock(&zloop_lock);
-			return zloop_complete(zdev, cset_index);
-		}
-	} else {
-		if (zloop_rd_pending)
-			goto out_warn;
-		zloop_rd_pending++;
-		if (zloop_wr_pending) {
-			spin_unlock(&zloop_lock);
-			return zloop_complete(zdev, cset_index);
-		}
-	}
-	spin_unlock(&zloop_lock);
-	return ret;
-out_warn:
-	spin_unlock(&zloop_lock);
-	WARN(1, "%s: counter corruption\n", __func__);
-	return ret;
+	zio_join_stop_io(&zloop_join, cset);
 }
 
 static int zloop_raw_output(struct zio_cset *cset)
@@ -169,7 +152,7 @@ static int zloop_raw_output(struct zio_cset *cset)
 
 	switch (cset->index) {
 	case ZLOOP_CSET_OUT_LOOP:
-		return zloop_try_complete(cset->zdev, cset->index);
+		return zio_join_raw_io(&zloop_join, cset);
 
 	case ZLOOP_CSET_OUT_DATA:
 		index = ZLOOP_TYPE_READ_DATA;
@@ -193,7 +176,7 @@ static int zloop_raw_input(struct zio_cset *cset)
 
 	switch (cset->index) {
 	case ZLOOP_CSET_IN_LOOP:
-		return zloop_try_complete(cset->zdev, cset->index);
+		return zio_join_raw_io(&zloop_join, cset);
 	case ZLOOP_CSET_IN_DATA:
 		return -EAGAIN; /* FIXME */
 	}
@@ -212,6 +195,13 @@ static int zloop_probe(struct zio_device *zdev)
 	return 0;
 }
 
+/* The join refers to the csets of the device: empty it for next probe */
+static int zloop_remove(struct zio_device *zdev)
+{
+	zio_join_init(&zloop_join, zloop_join_io);
+	return 0;
+}
+
 
 /* I want the cset id it be part of the name, to ease the user */
 #define SET_OBJ_NAME_NUM(_name, _num) \
@@ -222,6 +212,7 @@ static struct zio_cset zloop_cset[] = {
 	[ZLOOP_CSET_OUT_LOOP] = {
 		SET_OBJ_NAME_NUM("out-loop", ZLOOP_CSET_OUT_LOOP),
 		.raw_io =	zloop_raw_output,
+		.stop_io =	zloop_stop_io,
 		.flags =	ZIO_DIR_OUTPUT,
 		.n_chan =	2,
 		.ssize =	1,
@@ -229,6 +220,7 @@ static struct zio_cset zloop_cset[] = {
 	[ZLOOP_CSET_IN_LOOP] = {
 		SET_OBJ_NAME_NUM("in-loop", ZLOOP_CSET_IN_LOOP),
 		.raw_io =	zloop_raw_input,
+		.stop_io =	zloop_stop_io,
 		.flags =	ZIO_DIR_INPUT,
 		.n_chan =	2,
 		.ssize =	1,
@@ -274,6 +266,7 @@ static struct zio_driver zloop_zdrv = {
 	},
 	.id_table = zloop_table,
 	.probe = zloop_probe,
+	.remove = zloop_remove,
 	/* All drivers compiled within the ZIO projects are compatibile
 	   with the last version */
 	.min_version = ZIO_VERSION(1, 1, 0),
@@ -469,6 +462,7 @@ static struct zio_device *zloop_hwdev;
 
 static int __init zloop_init(void)
 {
+	struct zio_cset *cset;
 	int err, i;
 
 	if (zloop_trigger)
@@ -480,6 +474,7 @@ static int __init zloop_init(void)
 		spin_lock_init(&zloop_cdata[i].lock);
 		init_waitqueue_head(&zloop_cdata[i].q);
 	}
+	zio_join_init(&zloop_join, zloop_join_io);
 
 	err = zio_register_driver(&zloop_zdrv);
 	if (err)
@@ -493,12 +488,19 @@ static int __init zloop_init(void)
 	err = zio_register_device(zloop_hwdev, "zloop", 0);
 	if (err)
 		goto out_dev;
+	/* The order matters to zloop_join_io: output first */
+	cset = zloop_probed_dev->cset;
+	err = zio_join_add(&zloop_join, cset + ZLOOP_CSET_OUT_LOOP);
+	if (!err)
+		err = zio_join_add(&zloop_join, cset + ZLOOP_CSET_IN_LOOP);
+	if (err)
+		goto out_unregister;
 	err = zloop_register_miscdevs();
 	if (err)
-		goto out_misc;
+		goto out_unregister;
 	return 0;
-out_misc:
-	zio_unregister_device(zloop_hwdev);
+out_unregister:
+	zio_unregister_device(zloop_hwdev); /* it empties the join too */
 out_dev:
 	zio_free_device(zloop_hwdev);
 out_alloc:
@@ -0,0 +1,532 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * zio-synth is a synthetic source (and sink) meant for benchmarking: the
+ * cost of filling blocks must be negligible, so that what we measure is
+ * the framework. Patterns are generated one 64-bit word at a time (several
+ * samples per word, with no carry between samples), or copied from a
+ * pre-computed period for the sine wave.
+ *
+ * The number of channels and the sample size are chosen at insmod time,
+ * the number of samples is the "post-samples" of the trigger. Each cset
+ * can complete synchronously (in raw_io), from a high-resolution timer or
+ * from a kernel thread; the two latter can be paced at "rate" blocks per
+ * second.
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+
+#include <linux/zio.h>
+#include <linux/zio-sysfs.h>
+#include <linux/zio-buffer.h>
+#include <linux/zio-trigger.h>
+
+#define ZSYNTH_VERSION ZIO_HEX_VERSION(1, 0, 0)
+
+ZIO_PARAM_TRIGGER(zsynth_trigger);
+ZIO_PARAM_BUFFER(zsynth_buffer);
+
+static int zsynth_nchan = 4;
+module_param_named(nchan, zsynth_nchan, int, 0444);
+static int zsynth_ssize = 2;
+module_param_named(ssize, zsynth_ssize, int, 0444);
+
+#define ZSYNTH_NCHAN_MAX	64
+#define ZSYNTH_SINE_N		256 /* samples in one period */
+
+enum zsynth_cset_index {
+	ZSYNTH_CSET_IN,
+	ZSYNTH_CSET_OUT,
+};
+
+enum zsynth_ext {
+	ZSYNTH_PATTERN,
+	ZSYNTH_COMPLETION,
+	ZSYNTH_RATE,
+	ZSYNTH_ARM_PAIR,
+};
+
+enum zsynth_pattern {
+	ZSYNTH_PATTERN_COUNTER,
+	ZSYNTH_PATTERN_PRNG,
+	ZSYNTH_PATTERN_SINE,
+};
+
+enum zsynth_completion {
+	ZSYNTH_COMPLETION_SYNC,
+	ZSYNTH_COMPLETION_HRTIMER,
+	ZSYNTH_COMPLETION_KTHREAD,
+};
+
+struct zsynth_chan {
+	uint64_t		count; /* counter: next sample */
+	uint64_t		seed; /* prng: xorshift state */
+	unsigned int		phase; /* sine: next sample in the period */
+};
+
+/* One per cset: the completion machinery and the channel state */
+struct zsynth_cset {
+	struct zio_cset		*cset;
+	struct hrtimer		timer;
+	struct task_struct	*thread;
+	unsigned long		kick; /* bit 0: the thread must complete */
+	ktime_t			next; /* when the next block is due */
+	ktime_t			due; /* when the current block is due */
+	struct zsynth_chan	*chan;
+};
+
+static struct zsynth_cset zsynth_csets[2];
+static void *zsynth_sine; /* one period, in the sample size */
+
+ZIO_ATTR_DEFINE_STD(ZIO_DEV, zsynth_zattr_dev) = {
+	ZIO_SET_ATTR_VERSION(ZSYNTH_VERSION),
+};
+
+ZIO_ATTR_DEFINE_STD(ZIO_DEV, zsynth_zattr_cset) = {
+	/* changed at insmod, according to the sample size */
+	ZIO_ATTR(zdev, ZIO_ATTR_NBITS, ZIO_RO_PERM, 0, 16),
+};
+
+/* Writing "arm-pair" arms both csets at once, for stimulus/response */
+static struct zio_attribute zsynth_dev_ext[] = {
+	ZIO_PARAM_EXT("arm-pair", ZIO_WO_PERM, ZSYNTH_ARM_PAIR, 0),
+};
+
+static struct zio_attribute zsynth_in_ext[] = {
+	ZIO_PARAM_RNG("pattern", ZIO_RW_PERM, ZSYNTH_PATTERN,
+		      ZSYNTH_PATTERN_COUNTER, 0, ZSYNTH_PATTERN_SINE),
+	ZIO_PARAM_RNG("completion", ZIO_RW_PERM, ZSYNTH_COMPLETION,
+		      ZSYNTH_COMPLETION_SYNC, 0, ZSYNTH_COMPLETION_KTHREAD),
+	ZIO_PARAM_RNG("rate", ZIO_RW_PERM, ZSYNTH_RATE, 0,
+		      0, 1000 * 1000 * 1000),
+};
+
+static struct zio_attribute zsynth_out_ext[] = {
+	ZIO_PARAM_RNG("completion", ZIO_RW_PERM, ZSYNTH_COMPLETION,
+		      ZSYNTH_COMPLETION_SYNC, 0, ZSYNTH_COMPLETION_KTHREAD),
+	ZIO_PARAM_RNG("rate", ZIO_RW_PERM, ZSYNTH_RATE, 0,
+		      0, 1000 * 1000 * 1000),
+};
+
+static uint32_t zsynth_ext_val(struct zio_cset *cset, enum zsynth_ext id)
+{
+	struct zio_attribute_set *zset = &cset->zattr_set;
+	int i;
+
+	for (i = 0; i < zset->n_ext_attr; i++)
+		if (zset->ext_zattr[i].id == id)
+			return zset->ext_zattr[i].value;
+	return 0;
+}
+
+static int zsynth_conf_set(struct device *dev, struct zio_attribute *zattr,
+			   uint32_t usr_val)
+{
+	struct zio_device *zdev;
+	struct zio_cset *csets[2];
+
+	/* Values are checked by the core and read back at each raw_io */
+	if (zattr->id != ZSYNTH_ARM_PAIR)
+		return 0;
+
+	/* The response (input) is started before the stimulus (output) */
+	zdev = to_zio_dev(dev);
+	csets[0] = &zdev->cset[ZSYNTH_CSET_IN];
+	csets[1] = &zdev->cset[ZSYNTH_CSET_OUT];
+	return zio_arm_csets(csets, ARRAY_SIZE(csets));
+}
+
+static const struct zio_sysfs_operations zsynth_sysfs_ops = {
+	.conf_set = zsynth_conf_set,
+};
+
+/* The shift of sample i within a 64-bit word, in native endianness */
+static inline int zsynth_lane(int i, int lanes, int bits)
+{
+#ifdef __BIG_ENDIAN
+	return (lanes - 1 - i) * bits;
+#else
+	return i * bits;
+#endif
+}
+
+/*
+ * Counter: one word holds 8/ssize samples, and each of them is incremented
+ * by the number of lanes, masking the top bit of each lane so that
+ * carries don't propagate to the next sample.
+ */
+static void zsynth_fill_counter(struct zsynth_chan *c, uint64_t *p, int len)
+{
+	int i, lanes = 8 / zsynth_ssize, bits = zsynth_ssize * 8;
+	uint64_t mask = bits == 64 ? ~0ULL : (1ULL << bits) - 1;
+	uint64_t word = 0, inc = 0, hi = 0;
+
+	for (i = 0; i < lanes; i++) {
+		word |= ((c->count + i) & mask) <<
+			zsynth_lane(i, lanes, bits);
+		inc |= (uint64_t)lanes << zsynth_lane(i, lanes, bits);
+		hi |= 1ULL << (zsynth_lane(i, lanes, bits) + bits - 1);
+	}
+	for (i = 0; i < len / 8; i++) {
+		p[i] = word;
+		word = ((word & ~hi) + inc) ^ (word & hi);
+	}
+	memcpy(p + i, &word, len % 8);
+	c->count += len / zsynth_ssize;
+}
+
+/* PRNG: xorshift64*, one word per step */
+static void zsynth_fill_prng(struct zsynth_chan *c, uint64_t *p, int len)
+{
+	uint64_t x = c->seed, word;
+	int i;
+
+	for (i = 0; i <= len / 8; i++) {
+		x ^= x >> 12;
+		x ^= x << 25;
+		x ^= x >> 27;
+		word = x * 2685821657736338717ULL;
+		if (i < len / 8)
+			p[i] = word;
+		else
+			memcpy(p + i, &word, len % 8);
+	}
+	c->seed = x;
+}
+
+/* Sine: copy from the pre-computed period */
+static void zsynth_fill_sine(struct zsynth_chan *c, void *p, int len)
+{
+	int n, period = ZSYNTH_SINE_N * zsynth_ssize;
+	int off = c->phase * zsynth_ssize;
+
+	c->phase = (c->phase + len / zsynth_ssize) % ZSYNTH_SINE_N;
+	while (len) {
+		n = min(len, period - off);
+		memcpy(p, zsynth_sine + off, n);
+		p += n;
+		len -= n;
+		off = 0;
+	}
+}
+
+static void zsynth_fill(struct zsynth_cset *zs)
+{
+	uint32_t pattern = zsynth_ext_val(zs->cset, ZSYNTH_PATTERN);
+	struct zio_channel *chan;
+	struct zio_block *block;
+	struct zsynth_chan *c;
+
+	chan_for_each(chan, zs->cset) {
+		block = chan->active_block;
+		if (!block)
+			continue;
+		c = zs->chan + chan->index;
+		switch (pattern) {
+		case ZSYNTH_PATTERN_COUNTER:
+			zsynth_fill_counter(c, block->data, block->datalen);
+			break;
+		case ZSYNTH_PATTERN_PRNG:
+			zsynth_fill_prng(c, block->data, block->datalen);
+			break;
+		case ZSYNTH_PATTERN_SINE:
+			zsynth_fill_sine(c, block->data, block->datalen);
+			break;
+		}
+	}
+}
+
+/* Build one period of the sine, by recurrence in Q30 fixed point */
+static int zsynth_sine_init(void)
+{
+	int64_t k = 2146836866; /* 2 * cos(2 * pi / N), Q30 */
+	int64_t s0 = 0, s1 = 26248010; /* amplitude 0x3fc00000 */
+	int64_t s, v;
+	int bits = zsynth_ssize * 8;
+	int i;
+
+	zsynth_sine = kmalloc(ZSYNTH_SINE_N * zsynth_ssize, GFP_KERNEL);
+	if (!zsynth_sine)
+		return -ENOMEM;
+	for (i = 0; i < ZSYNTH_SINE_N; i++) {
+		s = i ? s1 : s0;
+		if (i > 1) {
+			s = ((k * s1) >> 30) - s0;
+			s0 = s1;
+			s1 = s;
+		}
+		v = bits < 32 ? s >> (31 - bits) : s * (1LL << (bits - 31));
+		switch (zsynth_ssize) {
+		case 1:
+			((int8_t *)zsynth_sine)[i] = v;
+			break;
+		case 2:
+			((int16_t *)zsynth_sine)[i] = v;
+			break;
+		case 4:
+			((int32_t *)zsynth_sine)[i] = v;
+			break;
+		case 8:
+			((int64_t *)zsynth_sine)[i] = v;
+			break;
+		}
+	}
+	return 0;
+}
+
+/* The transfer is over: fill input blocks and report to the trigger */
+static void zsynth_complete(struct zsynth_cset *zs)
+{
+	struct zio_cset *cset = zs->cset;
+
+	if ((cset->flags & ZIO_DIR) == ZIO_DIR_INPUT)
+		zsynth_fill(zs);
+	zio_cset_busy_clear(cset, 1);
+	zio_trigger_data_done(cset);
+}
+
+static enum hrtimer_restart zsynth_fn(struct hrtimer *timer)
+{
+	zsynth_complete(container_of(timer, struct zsynth_cset, timer));
+	return HRTIMER_NORESTART;
+}
+
+static int zsynth_thread(void *arg)
+{
+	struct zsynth_cset *zs = arg;
+	ktime_t next;
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!test_and_clear_bit(0, &zs->kick)) {
+			schedule();
+			continue;
+		}
+		next = zs->due;
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		schedule_hrtimeout(&next, HRTIMER_MODE_ABS);
+		zsynth_complete(zs);
+	}
+	return 0;
+}
+
+/*
+ * Data is only generated when the transfer completes. Asynchronous
+ * transfers mark the cset busy, so they can't be aborted half-way.
+ */
+static int zsynth_raw_io(struct zio_cset *cset)
+{
+	struct zsynth_cset *zs = zsynth_csets + cset->index;
+	uint32_t rate = zsynth_ext_val(cset, ZSYNTH_RATE);
+	ktime_t now, due;
+
+	zs->cset = cset;
+	switch (zsynth_ext_val(cset, ZSYNTH_COMPLETION)) {
+	case ZSYNTH_COMPLETION_SYNC:
+		if ((cset->flags & ZIO_DIR) == ZIO_DIR_INPUT)
+			zsynth_fill(zs);
+		return 0; /* Already done */
+
+	case ZSYNTH_COMPLETION_HRTIMER:
+	case ZSYNTH_COMPLETION_KTHREAD:
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	/* Pace at "rate": the next block is due one period after this one */
+	now = ktime_get();
+	due = ktime_to_ns(zs->next) > ktime_to_ns(now) ? zs->next : now;
+	zs->next = rate ? ktime_add_ns(due, div_u64(NSEC_PER_SEC, rate)) : now;
+
+	zio_cset_busy_set(cset, 1);
+	if (zsynth_ext_val(cset, ZSYNTH_COMPLETION) ==
+	    ZSYNTH_COMPLETION_HRTIMER) {
+		hrtimer_start(&zs->timer, due, HRTIMER_MODE_ABS);
+	} else {
+		zs->due = due;
+		set_bit(0, &zs->kick);
+		wake_up_process(zs->thread);
+	}
+	return -EAGAIN; /* data_done later */
+}
+
+static struct zio_cset zsynth_cset[] = {
+	[ZSYNTH_CSET_IN] = {
+		ZIO_SET_OBJ_NAME("synth-in"),
+		.raw_io =	zsynth_raw_io,
+		.n_chan =	4, /* changed at insmod */
+		.ssize =	2, /* changed at insmod */
+		.flags =	ZIO_DIR_INPUT | ZIO_CSET_TYPE_ANALOG,
+		.zattr_set = {
+			.std_zattr = zsynth_zattr_cset,
+			.ext_zattr = zsynth_in_ext,
+			.n_ext_attr = ARRAY_SIZE(zsynth_in_ext),
+		},
+	},
+	[ZSYNTH_CSET_OUT] = {
+		ZIO_SET_OBJ_NAME("synth-out"),
+		.raw_io =	zsynth_raw_io,
+		.n_chan =	4, /* changed at insmod */
+		.ssize =	2, /* changed at insmod */
+		.flags =	ZIO_DIR_OUTPUT | ZIO_CSET_TYPE_ANALOG,
+		.zattr_set = {
+			.std_zattr = zsynth_zattr_cset,
+			.ext_zattr = zsynth_out_ext,
+			.n_ext_attr = ARRAY_SIZE(zsynth_out_ext),
+		},
+	},
+};
+
+static struct zio_device zsynth_tmpl = {
+	.owner =		THIS_MODULE,
+	.cset =			zsynth_cset,
+	.n_cset =		ARRAY_SIZE(zsynth_cset),
+	.s_op =			&zsynth_sysfs_ops,
+	.zattr_set = {
+		.std_zattr = zsynth_zattr_dev,
+		.ext_zattr = zsynth_dev_ext,
+		.n_ext_attr = ARRAY_SIZE(zsynth_dev_ext),
+	}
+};
+
+static struct zio_device *zsynth_dev;
+static const struct zio_device_id zsynth_table[] = {
+	{"zsynth", &zsynth_tmpl},
+	{},
+};
+
+static struct zio_driver zsynth_zdrv = {
+	.driver = {
+		.name = "zsynth",
+		.owner = THIS_MODULE,
+	},
+	.id_table = zsynth_table,
+	/* All drivers compiled within the ZIO projects are compatibile
+	   with the last version */
+	.min_version = ZIO_VERSION(1, 1, 0),
+};
+
+/* Undo the first n entries of zsynth_csets_init (their timer is set up) */
+static void zsynth_csets_exit(int n)
+{
+	struct zsynth_cset *zs;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		zs = zsynth_csets + i;
+		if (zs->thread)
+			kthread_stop(zs->thread);
+		hrtimer_cancel(&zs->timer);
+		kfree(zs->chan);
+	}
+	kfree(zsynth_sine);
+}
+
+static int zsynth_csets_init(void)
+{
+	struct zsynth_cset *zs;
+	int i, j, err;
+
+	err = zsynth_sine_init();
+	if (err)
+		return err;
+	for (i = 0; i < ARRAY_SIZE(zsynth_csets); i++) {
+		zs = zsynth_csets + i;
+		hrtimer_init(&zs->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+		zs->timer.function = zsynth_fn;
+		zs->chan = kcalloc(zsynth_nchan, sizeof(*zs->chan), GFP_KERNEL);
+		if (!zs->chan)
+			goto out;
+		for (j = 0; j < zsynth_nchan; j++) /* any non-zero seed */
+			zs->chan[j].seed = 0x9e3779b97f4a7c15ULL * (j + 1);
+		zs->thread = kthread_run(zsynth_thread, zs, "zsynth/%i", i);
+		if (IS_ERR(zs->thread)) {
+			err = PTR_ERR(zs->thread);
+			zs->thread = NULL;
+			goto out_err;
+		}
+	}
+	return 0;
+out:
+	err = -ENOMEM;
+out_err:
+	zsynth_csets_exit(i + 1);
+	return err;
+}
+
+static int __init zsynth_init(void)
+{
+	int err, i;
+
+	if (zsynth_nchan < 1 || zsynth_nchan > ZSYNTH_NCHAN_MAX) {
+		pr_err("%s: nchan is %i: out of range\n", KBUILD_MODNAME,
+		       zsynth_nchan);
+		return -EINVAL;
+	}
+	if (zsynth_ssize != 1 && zsynth_ssize != 2 && zsynth_ssize != 4 &&
+	    zsynth_ssize != 8) {
+		pr_err("%s: ssize is %i: must be 1, 2, 4 or 8\n",
+		       KBUILD_MODNAME, zsynth_ssize);
+		return -EINVAL;
+	}
+
+	/* customize the driver and register it */
+	if (zsynth_trigger)
+		zsynth_tmpl.preferred_trigger = zsynth_trigger;
+	if (zsynth_buffer)
+		zsynth_tmpl.preferred_buffer = zsynth_buffer;
+	for (i = 0; i < ARRAY_SIZE(zsynth_cset); i++) {
+		zsynth_cset[i].n_chan = zsynth_nchan;
+		zsynth_cset[i].ssize = zsynth_ssize;
+	}
+	zsynth_zattr_cset[ZIO_ATTR_NBITS].value = zsynth_ssize * 8;
+
+	err = zsynth_csets_init();
+	if (err)
+		return err;
+	err = zio_register_driver(&zsynth_zdrv);
+	if (err)
+		goto out_csets;
+	zsynth_dev = zio_allocate_device();
+	if (IS_ERR(zsynth_dev)) {
+		err = PTR_ERR(zsynth_dev);
+		goto out_all;
+	}
+	zsynth_dev->owner = THIS_MODULE;
+	err = zio_register_device(zsynth_dev, "zsynth", 0);
+	if (err)
+		goto out_dev;
+	return 0;
+out_dev:
+	zio_free_device(zsynth_dev);
+out_all:
+	zio_unregister_driver(&zsynth_zdrv);
+out_csets:
+	zsynth_csets_exit(ARRAY_SIZE(zsynth_csets));
+	return err;
+}
+
+static void __exit zsynth_exit(void)
+{
+	zio_unregister_device(zsynth_dev);
+	zio_free_device(zsynth_dev);
+	zio_unregister_driver(&zsynth_zdrv);
+	zsynth_csets_exit(ARRAY_SIZE(zsynth_csets));
+}
+
+module_init(zsynth_init);
+module_exit(zsynth_exit);
+
+MODULE_VERSION(GIT_VERSION); /* Defined in local Makefile */
+MODULE_DESCRIPTION("A synthetic source and sink, for benchmarking");
+MODULE_LICENSE("GPL");
+
+ADDITIONAL_VERSIONS;
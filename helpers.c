@@ -10,6 +10,12 @@
 #include <linux/init.h>
 #include <linux/types.h>
 #include <linux/delay.h>
+#include <linux/percpu.h>
+#include <linux/workqueue.h>
+#include <linux/kthread.h>
+#include <linux/sched.h>
+#include <linux/cpumask.h>
+#include <linux/mutex.h>
 
 #include <linux/zio.h>
 #include <linux/zio-sysfs.h>
@@ -25,10 +31,42 @@ static void __zio_internal_abort_free(struct zio_cset *cset)
 	chan_for_each(chan, cset) {
 		block = chan->active_block;
 		zio_buffer_free_block(chan->bi, block);
-		chan->active_block = NULL;
+		zio_set_active_block(chan, NULL);
 	}
 }
 
+/* Release the next blocks of all channels, as they may be stale */
+static void __zio_free_queued(struct zio_cset *cset)
+{
+	struct zio_channel *chan;
+	int i;
+
+	for (i = 0; i < cset->n_chan; i++) {
+		chan = &cset->chan[i];
+		while (chan->n_queued)
+			zio_buffer_free_block(chan->bi,
+					chan->queued[--chan->n_queued]);
+	}
+}
+
+/* Change the number of active blocks, releasing the queued ones in excess */
+void zio_cset_set_active_blocks(struct zio_cset *cset, unsigned int n)
+{
+	struct zio_channel *chan;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&cset->lock, flags);
+	cset->active_blocks = n;
+	for (i = 0; i < cset->n_chan; i++) {
+		chan = &cset->chan[i];
+		while (chan->n_queued > n - 1)
+			zio_buffer_free_block(chan->bi,
+					chan->queued[--chan->n_queued]);
+	}
+	spin_unlock_irqrestore(&cset->lock, flags);
+}
+
 /*
  * zio_trigger_abort
  * This is a ZIO helper to invoke the abort function. This must be used when
@@ -46,7 +84,7 @@ int __zio_trigger_abort_disable(struct zio_cset *cset, int disable)
 	spin_lock_irqsave(&cset->lock, flags);
 
 	/* If we are hardware-busy, cannot abort (the caller may retry) */
-	if (cset->flags & ZIO_CSET_HW_BUSY) {
+	if (cset->flags & (ZIO_CSET_HW_BUSY | ZIO_CSET_DONE_PENDING)) {
 		spin_unlock_irqrestore(&cset->lock, flags);
 		return -EAGAIN;
 	}
@@ -67,6 +105,12 @@ int __zio_trigger_abort_disable(struct zio_cset *cset, int disable)
 			__zio_internal_abort_free(cset);
 		ti->flags &= (~ZIO_TI_ARMED);
 	}
+	/* Even if not armed, blocks may wait in queues or in the history */
+	__zio_free_queued(cset);
+	if (ti->t_op->flush)
+		ti->t_op->flush(ti);
+	if (cset->history)
+		__zio_history_reset(cset);
 	if (disable)
 		ti->flags |= ZIO_DISABLED;
 	spin_unlock_irqrestore(&cset->lock, flags);
@@ -74,29 +118,74 @@ int __zio_trigger_abort_disable(struct zio_cset *cset, int disable)
 }
 EXPORT_SYMBOL(__zio_trigger_abort_disable);
 
+/*
+ * With more active blocks, the first queued one becomes active, and the
+ * queue is refilled, so the driver always knows where the next data goes.
+ * Called with the cset lock held.
+ */
+static void __zio_chan_queue(struct zio_channel *chan, int datalen)
+{
+	struct zio_cset *cset = chan->cset;
+	struct zio_block *block;
+	int i;
+
+	/* Blocks of the wrong size were queued before a configuration */
+	for (i = 0; i < chan->n_queued; i++)
+		if (chan->queued[i]->datalen != datalen)
+			break;
+	while (chan->n_queued > min(i, (int)cset->active_blocks - 1))
+		zio_buffer_free_block(chan->bi, chan->queued[--chan->n_queued]);
+
+	if (chan->n_queued) {
+		zio_set_active_block(chan, chan->queued[0]);
+		memmove(chan->queued, chan->queued + 1,
+			--chan->n_queued * sizeof(chan->queued[0]));
+	} else {
+		zio_set_active_block(chan, zio_buffer_alloc_block(chan->bi,
+							datalen, GFP_ATOMIC));
+	}
+	while (chan->n_queued < cset->active_blocks - 1) {
+		block = zio_buffer_alloc_block(chan->bi, datalen, GFP_ATOMIC);
+		if (!block)
+			break; /* we'll try again at next arm */
+		chan->queued[chan->n_queued++] = block;
+	}
+}
+
 static int __zio_arm_input_trigger(struct zio_ti *ti)
 {
-	struct zio_buffer_type *zbuf;
 	struct zio_block *block;
-	struct zio_device *zdev;
 	struct zio_cset *cset;
 	struct zio_channel *chan;
 	struct zio_control *ctrl;
-	int i, datalen;
+	int i, datalen, nsamples;
+	unsigned long flags;
 
 	cset = ti->cset;
-	zdev = cset->zdev;
-	zbuf = cset->zbuf;
 
-	/* Allocate the buffer for the incoming sample, in active channels */
+	/* In history mode, we acquire continuously in chunks */
+	nsamples = ti->nsamples;
+	if (unlikely(cset->history))
+		nsamples = zio_history_chunk(cset);
+
+	/*
+	 * Allocate the buffer for the incoming sample, in active channels.
+	 * The lock serializes active_block against channel enable/disable
+	 */
+	spin_lock_irqsave(&cset->lock, flags);
 	chan_for_each(chan, cset) {
 		ctrl = chan->current_ctrl;
-		ctrl->nsamples = ti->nsamples;
-		datalen = ctrl->ssize * ti->nsamples;
+		ctrl->nsamples = nsamples;
+		datalen = ctrl->ssize * nsamples;
+		if (cset->active_blocks > 1) {
+			__zio_chan_queue(chan, datalen);
+			continue;
+		}
 		block = zio_buffer_alloc_block(chan->bi, datalen, GFP_ATOMIC);
 		/* If alloc error, it is reported at data_done time */
-		chan->active_block = block;
+		zio_set_active_block(chan, block);
 	}
+	spin_unlock_irqrestore(&cset->lock, flags);
 	i = cset->raw_io(cset);
 
 	return i;
@@ -116,16 +205,76 @@ static int __zio_arm_output_trigger(struct zio_ti *ti)
 static int __zio_trigger_data_done(struct zio_cset *cset);
 
 /*
- * When a software trigger fires, it should call this function. It
- * used to be called zio_fire_trigger, but actually it only arms the trigger.
- * When hardware is self-timed, the actual trigger fires later.
+ * A self-timed cset is re-armed in a loop by zio_arm_trigger. If the
+ * cset has a budget (and thus an acquisition thread), when the budget
+ * is over we stop looping and the thread re-arms later; so a device
+ * that completes synchronously can't monopolize the caller.
  */
-void zio_arm_trigger(struct zio_ti *ti)
+static int zio_arm_trigger_defer(struct zio_cset *cset, int n, ktime_t start)
+{
+	unsigned long flags;
+	int defer = 0;
+
+	if (!cset->acq_thread)
+		return 0;
+	if (cset->arm_budget && n >= cset->arm_budget)
+		defer = 1;
+	else if (cset->arm_budget_ns &&
+		 ktime_to_ns(ktime_sub(ktime_get(), start)) >=
+		 cset->arm_budget_ns)
+		defer = 1;
+	if (!defer)
+		return 0;
+
+	spin_lock_irqsave(&cset->lock, flags);
+	if (cset->acq_thread) {
+		cset->flags |= ZIO_CSET_REARM_PENDING;
+		wake_up_process(cset->acq_thread);
+	} else {
+		defer = 0; /* thread just stopped: go on looping */
+	}
+	spin_unlock_irqrestore(&cset->lock, flags);
+	return defer;
+}
+
+/* Start the I/O of an armed trigger; on error the blocks are released */
+static int __zio_arm_io(struct zio_ti *ti)
 {
 	struct zio_channel *chan;
 	unsigned long flags;
 	int ret;
 
+	if (ti->t_op->arm)
+		ret = ti->t_op->arm(ti);
+	else if (likely((ti->flags & ZIO_DIR) == ZIO_DIR_INPUT))
+		ret = __zio_arm_input_trigger(ti);
+	else
+		ret = __zio_arm_output_trigger(ti);
+
+	/* If arm fails release all active_blocks */
+	if (ret && ret != -EAGAIN) {
+		/* Error: Free blocks */
+		dev_err(&ti->head.dev,
+			"raw_io failed (%i), cannot arm trigger\n", ret);
+		spin_lock_irqsave(&ti->cset->lock, flags);
+		chan_for_each(chan, ti->cset) {
+			zio_buffer_free_block(chan->bi, chan->active_block);
+			zio_set_active_block(chan, NULL);
+			chan->current_ctrl->zio_alarms |=
+						ZIO_ALARM_LOST_TRIGGER;
+		}
+		spin_unlock_irqrestore(&ti->cset->lock, flags);
+	}
+	return ret;
+}
+
+/* Internal version, used to re-arm: it is not a trigger event */
+void __zio_arm_trigger(struct zio_ti *ti)
+{
+	unsigned long flags;
+	ktime_t start = ktime_get();
+	int ret, n = 0;
+
 	do {
 		/* if trigger is disabled or already pending, return */
 		spin_lock_irqsave(&ti->cset->lock, flags);
@@ -138,33 +287,16 @@ void zio_arm_trigger(struct zio_ti *ti)
 		getnstimeofday(&ti->tstamp);
 		spin_unlock_irqrestore(&ti->cset->lock, flags);
 
-		if (ti->t_op->arm)
-			ret = ti->t_op->arm(ti);
-		else if (likely((ti->flags & ZIO_DIR) == ZIO_DIR_INPUT))
-			ret = __zio_arm_input_trigger(ti);
-		else
-			ret = __zio_arm_output_trigger(ti);
-
-		/* If arm fails release all active_blocks */
-		if (ret && ret != -EAGAIN) {
-			/* Error: Free blocks */
-			dev_err(&ti->head.dev,
-				"raw_io failed (%i), cannot arm trigger\n",
-				ret);
-			chan_for_each(chan, ti->cset) {
-				zio_buffer_free_block(chan->bi,
-						      chan->active_block);
-				chan->active_block = NULL;
-				chan->current_ctrl->zio_alarms |=
-							ZIO_ALARM_LOST_TRIGGER;
-			}
-		}
+		ret = __zio_arm_io(ti);
 
 		/* error or -EGAINA */
 		if (ret)
 			break;
-
-	} while (__zio_trigger_data_done(ti->cset));
+		if (!__zio_trigger_data_done(ti->cset))
+			break;
+		if (zio_arm_trigger_defer(ti->cset, ++n, start))
+			return; /* the acquisition thread goes on */
+	} while (1);
 
 	if (ret == -EAGAIN)
 		return;
@@ -174,8 +306,191 @@ void zio_arm_trigger(struct zio_ti *ti)
 	ti->flags &= ~ZIO_TI_ARMED;
 	spin_unlock_irqrestore(&ti->cset->lock, flags);
 }
+
+/*
+ * When a software trigger fires, it should call this function. It
+ * used to be called zio_fire_trigger, but actually it only arms the trigger.
+ * When hardware is self-timed, the actual trigger fires later.
+ * In history mode acquisition is continuous, so the trigger event only
+ * marks the position of the block within the stream of samples.
+ */
+void zio_arm_trigger(struct zio_ti *ti)
+{
+	if (unlikely(ti->cset->history) && zio_history_fire(ti->cset))
+		return;
+	__zio_arm_trigger(ti);
+}
 EXPORT_SYMBOL(zio_arm_trigger);
 
+/*
+ * Arm several csets as one transaction: either all of them are armed, or
+ * none is and -EBUSY is returned (a trigger is disabled, already armed or
+ * in history mode). The cset locks are taken in address order, so callers
+ * with overlapping sets can't deadlock. Then I/O is started in the order
+ * of the array (e.g., the response before the stimulus); if it fails for
+ * one cset, those not completed yet are aborted. A cset that is hardware
+ * busy can't be aborted, and we may hold a spinlock, so we can't wait:
+ * it completes normally, and -EINPROGRESS tells the caller.
+ */
+int zio_arm_csets(struct zio_cset **csets, unsigned int n)
+{
+	struct zio_cset *sorted[ZIO_JOIN_MAX];
+	int ret[ZIO_JOIN_MAX];
+	struct timespec now;
+	struct zio_ti *ti;
+	unsigned long flags;
+	int i, j, err = 0;
+
+	if (!n || n > ZIO_JOIN_MAX)
+		return -EINVAL;
+	for (i = 0; i < n; i++) { /* insertion sort, n is small */
+		for (j = i; j > 0 && sorted[j - 1] > csets[i]; j--)
+			sorted[j] = sorted[j - 1];
+		sorted[j] = csets[i];
+	}
+	for (i = 1; i < n; i++)
+		if (sorted[i] == sorted[i - 1])
+			return -EINVAL;
+
+	getnstimeofday(&now);
+	local_irq_save(flags);
+	for (i = 0; i < n; i++)
+		spin_lock_nested(&sorted[i]->lock, i);
+	for (i = 0; i < n; i++) {
+		ti = sorted[i]->ti;
+		if ((ti->flags & ZIO_STATUS) == ZIO_DISABLED ||
+		    (ti->flags & ZIO_TI_ARMED) || sorted[i]->history)
+			err = -EBUSY;
+	}
+	for (i = 0; !err && i < n; i++) {
+		ti = sorted[i]->ti;
+		ti->flags |= ZIO_TI_ARMED;
+		ti->tstamp = now; /* all of them share the time stamp */
+	}
+	for (i = n - 1; i >= 0; i--)
+		spin_unlock(&sorted[i]->lock);
+	local_irq_restore(flags);
+	if (err)
+		return err;
+
+	for (i = 0; i < n; i++) {
+		ret[i] = __zio_arm_io(csets[i]->ti);
+		if (ret[i] && ret[i] != -EAGAIN)
+			break;
+	}
+	if (i == n) {
+		for (i = 0; i < n; i++)
+			if (!ret[i])
+				zio_trigger_data_done(csets[i]);
+		return 0;
+	}
+
+	/* Failure: the failed one and the ones not started are un-armed */
+	err = ret[i];
+	for (j = i; j < n; j++) {
+		spin_lock_irqsave(&csets[j]->lock, flags);
+		csets[j]->ti->flags &= ~ZIO_TI_ARMED;
+		spin_unlock_irqrestore(&csets[j]->lock, flags);
+	}
+	for (j = 0; j < i; j++) {
+		if (!ret[j])
+			zio_trigger_data_done(csets[j]); /* already over */
+		else if (__zio_trigger_abort_disable(csets[j], 0) == -EAGAIN)
+			err = -EINPROGRESS; /* this one is still armed */
+	}
+	return err;
+}
+EXPORT_SYMBOL(zio_arm_csets);
+
+/*
+ * A join pairs the data transfers of several csets, as a loop-back does:
+ * every member calls zio_join_raw_io from its raw_io method, and when all
+ * of them are pending, the io method of the join runs with all the
+ * active blocks in place. Then all members complete together.
+ */
+void zio_join_init(struct zio_join *join, void (*io)(struct zio_join *join))
+{
+	memset(join, 0, sizeof(*join));
+	spin_lock_init(&join->lock);
+	join->io = io;
+}
+EXPORT_SYMBOL(zio_join_init);
+
+int zio_join_add(struct zio_join *join, struct zio_cset *cset)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&join->lock, flags);
+	if (join->n == ZIO_JOIN_MAX)
+		ret = -ENOSPC;
+	else
+		join->cset[join->n++] = cset;
+	spin_unlock_irqrestore(&join->lock, flags);
+	return ret;
+}
+EXPORT_SYMBOL(zio_join_add);
+
+static int zio_join_index(struct zio_join *join, struct zio_cset *cset)
+{
+	int i;
+
+	for (i = 0; i < join->n; i++)
+		if (join->cset[i] == cset)
+			return i;
+	return -1;
+}
+
+/*
+ * This is called by raw_io: it returns -EAGAIN if other members are
+ * still missing, or 0 after the transfer (the other members have been
+ * completed, the caller completes as usual)
+ */
+int zio_join_raw_io(struct zio_join *join, struct zio_cset *cset)
+{
+	unsigned long flags, all;
+	int i, me;
+
+	spin_lock_irqsave(&join->lock, flags);
+	me = zio_join_index(join, cset);
+	if (me < 0 || (join->pending & (1UL << me))) {
+		spin_unlock_irqrestore(&join->lock, flags);
+		WARN(1, "%s: cset %s: not a member or already pending\n",
+		     __func__, cset->head.name);
+		return -EBUSY;
+	}
+	join->pending |= 1UL << me;
+	all = (1UL << join->n) - 1;
+	if (join->pending != all) {
+		spin_unlock_irqrestore(&join->lock, flags);
+		return -EAGAIN;
+	}
+	/* Transfer under the lock, so members can't be stopped meanwhile */
+	join->pending = 0;
+	join->io(join);
+	spin_unlock_irqrestore(&join->lock, flags);
+
+	for (i = 0; i < join->n; i++)
+		if (i != me)
+			zio_trigger_data_done(join->cset[i]);
+	return 0;
+}
+EXPORT_SYMBOL(zio_join_raw_io);
+
+/* This is the stop_io of a member: called with the cset lock held */
+void zio_join_stop_io(struct zio_join *join, struct zio_cset *cset)
+{
+	int me;
+
+	spin_lock(&join->lock);
+	me = zio_join_index(join, cset);
+	if (me >= 0)
+		join->pending &= ~(1UL << me);
+	spin_unlock(&join->lock);
+	__zio_internal_abort_free(cset);
+}
+EXPORT_SYMBOL(zio_join_stop_io);
+
 /*
  * zio_trigger_data_done
  * This is a ZIO helper to invoke the data_done trigger operation when a data
@@ -188,6 +503,28 @@ EXPORT_SYMBOL(zio_arm_trigger);
  * to notify if the trigger was rearmed or not.
  */
 
+/*
+ * If the trigger is programmed for a number of shots, count this one.
+ * At the last shot, the trigger is disabled (so it won't arm again,
+ * whoever calls zio_arm_trigger), its own event source is stopped like
+ * a disable from sysfs does, and readers are woken up, to get
+ * end-of-file when the buffer is empty. Called with the cset lock held.
+ */
+int __zio_trigger_last_shot(struct zio_ti *ti)
+{
+	uint32_t nshots = zio_ti_std_val(ti, ZIO_ATTR_TRIG_N_SHOTS);
+	struct zio_channel *chan;
+
+	if (!nshots || ++ti->shots < nshots)
+		return 0;
+	ti->flags |= ZIO_DISABLED | ZIO_TI_COMPLETED;
+	if (ti->t_op->change_status)
+		ti->t_op->change_status(ti, ZIO_DISABLED);
+	chan_for_each(chan, ti->cset)
+		wake_up_interruptible(&chan->bi->q);
+	return 1;
+}
+
 /* Internal version, doesn't rearm. Called by zio_fire_trigger() above */
 static int __zio_trigger_data_done(struct zio_cset *cset)
 {
@@ -198,12 +535,17 @@ static int __zio_trigger_data_done(struct zio_cset *cset)
 	if (unlikely(!(cset->ti->flags & ZIO_TI_ARMED)))
 		dev_dbg(&cset->head.dev, "data-done: un-armed trigger\n");
 
-	if (cset->ti->t_op->data_done)
+	if (unlikely(cset->history)) /* it counts shots by itself */
+		must_rearm = zio_history_data_done(cset);
+	else if (cset->ti->t_op->data_done)
 		must_rearm = cset->ti->t_op->data_done(cset);
 	else
 		must_rearm = zio_generic_data_done(cset);
 
 	cset->ti->flags &= ~ZIO_TI_ARMED;
+	cset->flags &= ~ZIO_CSET_DONE_PENDING;
+	if (!cset->history && unlikely(__zio_trigger_last_shot(cset->ti)))
+		must_rearm = 0;
 	spin_unlock_irqrestore(&cset->lock, flags);
 
 	return must_rearm;
@@ -214,21 +556,272 @@ int zio_trigger_data_done(struct zio_cset *cset)
 	int must_rearm = __zio_trigger_data_done(cset);
 
 	if (must_rearm)
-		zio_arm_trigger(cset->ti);
+		__zio_arm_trigger(cset->ti);
 
 	return must_rearm; /* Actually, "already_rearmed" */
 }
 EXPORT_SYMBOL(zio_trigger_data_done);
 
+/*
+ * Deferred data_done. Copying controls and storing blocks for every
+ * enabled channel may take a long time with interrupts disabled. So the
+ * driver may just mark the transfer as complete, and the data_done
+ * is run later by a per-cpu worker, which serves all queued csets in
+ * a single batch. Until then, the cset is DONE_PENDING and can't be
+ * aborted, like when it is HW_BUSY.
+ */
+struct zio_done_queue {
+	spinlock_t		lock;
+	struct list_head	list;
+	struct work_struct	work;
+};
+static DEFINE_PER_CPU(struct zio_done_queue, zio_done_queue);
+static struct workqueue_struct *zio_done_wq;
+
+static void zio_done_work(struct work_struct *work)
+{
+	struct zio_done_queue *q;
+	struct zio_cset *cset, *tmp;
+	unsigned long flags;
+	LIST_HEAD(batch);
+
+	q = container_of(work, struct zio_done_queue, work);
+	spin_lock_irqsave(&q->lock, flags);
+	list_splice_init(&q->list, &batch);
+	spin_unlock_irqrestore(&q->lock, flags);
+
+	list_for_each_entry_safe(cset, tmp, &batch, list_done) {
+		list_del_init(&cset->list_done);
+		zio_trigger_data_done(cset);
+	}
+}
+
+void zio_trigger_data_done_defer(struct zio_cset *cset)
+{
+	struct zio_done_queue *q;
+	unsigned long flags;
+	int cpu, pending;
+
+	spin_lock_irqsave(&cset->lock, flags);
+	pending = cset->flags & ZIO_CSET_DONE_PENDING;
+	cset->flags |= ZIO_CSET_DONE_PENDING;
+	spin_unlock_irqrestore(&cset->lock, flags);
+	if (pending)
+		return; /* already queued */
+
+	cpu = get_cpu();
+	q = &per_cpu(zio_done_queue, cpu);
+	spin_lock_irqsave(&q->lock, flags);
+	list_add_tail(&cset->list_done, &q->list);
+	spin_unlock_irqrestore(&q->lock, flags);
+	queue_work_on(cpu, zio_done_wq, &q->work);
+	put_cpu();
+}
+EXPORT_SYMBOL(zio_trigger_data_done_defer);
+
+/*
+ * The acquisition thread of a cset only re-arms the trigger when
+ * zio_arm_trigger() ran out of budget, and then sleeps again.
+ */
+static int zio_acq_thread(void *data)
+{
+	struct zio_cset *cset = data;
+	unsigned long flags;
+	int pending;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (kthread_should_stop())
+			break;
+		spin_lock_irqsave(&cset->lock, flags);
+		pending = cset->flags & ZIO_CSET_REARM_PENDING;
+		cset->flags &= ~ZIO_CSET_REARM_PENDING;
+		spin_unlock_irqrestore(&cset->lock, flags);
+		if (!pending) {
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+		__zio_arm_trigger(cset->ti);
+		cond_resched();
+	}
+	__set_current_state(TASK_RUNNING);
+	return 0;
+}
+
+static DEFINE_MUTEX(zio_acq_mutex);
+
+/* History mode re-arms forever, so only unregistering may force a stop */
+static int __zio_cset_acq_stop(struct zio_cset *cset, int force)
+{
+	struct task_struct *t = cset->acq_thread;
+	unsigned long flags;
+	int pending;
+
+	if (!t)
+		return 0;
+	spin_lock_irqsave(&cset->lock, flags);
+	if (cset->history && !force) {
+		spin_unlock_irqrestore(&cset->lock, flags);
+		return -EBUSY;
+	}
+	cset->acq_thread = NULL;
+	spin_unlock_irqrestore(&cset->lock, flags);
+	kthread_stop(t);
+
+	/* If the thread didn't re-arm, do it here */
+	spin_lock_irqsave(&cset->lock, flags);
+	pending = cset->flags & ZIO_CSET_REARM_PENDING;
+	cset->flags &= ~ZIO_CSET_REARM_PENDING;
+	spin_unlock_irqrestore(&cset->lock, flags);
+	if (pending)
+		__zio_arm_trigger(cset->ti);
+	return 0;
+}
+
+void zio_cset_acq_stop(struct zio_cset *cset)
+{
+	mutex_lock(&zio_acq_mutex);
+	__zio_cset_acq_stop(cset, 1);
+	mutex_unlock(&zio_acq_mutex);
+}
+
+static int zio_acq_cpu_valid(int cpu)
+{
+	return cpu == -1 || (cpu >= 0 && cpu < nr_cpu_ids && cpu_online(cpu));
+}
+
+static int zio_acq_prio_valid(int prio)
+{
+	return prio >= 0 && prio < MAX_USER_RT_PRIO;
+}
+
+/* Apply the configuration; called with zio_acq_mutex held */
+static int __zio_cset_acq_config(struct zio_cset *cset)
+{
+	struct sched_param param = { .sched_priority = cset->acq_prio };
+	struct task_struct *t;
+
+	if (!cset->arm_budget && !cset->arm_budget_ns)
+		return __zio_cset_acq_stop(cset, 0);
+	t = cset->acq_thread;
+	if (!t) {
+		t = kthread_create(zio_acq_thread, cset, "zio-acq/%s-%i",
+				   dev_name(&cset->zdev->head.dev),
+				   cset->index);
+		if (IS_ERR(t))
+			return PTR_ERR(t);
+	}
+	if (cset->acq_cpu >= 0)
+		set_cpus_allowed_ptr(t, cpumask_of(cset->acq_cpu));
+	else
+		set_cpus_allowed_ptr(t, cpu_possible_mask);
+	sched_setscheduler(t, cset->acq_prio ? SCHED_FIFO : SCHED_NORMAL,
+			   &param);
+	if (!cset->acq_thread) {
+		cset->acq_thread = t;
+		wake_up_process(t);
+	}
+	return 0;
+}
+
+/*
+ * Apply the re-arm budget and thread configuration of a cset: the
+ * thread only exists if there is a budget. Called in process context.
+ */
+int zio_cset_acq_config(struct zio_cset *cset)
+{
+	int err;
+
+	if (cset->arm_budget < 0 || cset->arm_budget_ns < 0 ||
+	    !zio_acq_cpu_valid(cset->acq_cpu) ||
+	    !zio_acq_prio_valid(cset->acq_prio))
+		return -EINVAL;
+
+	mutex_lock(&zio_acq_mutex);
+	err = __zio_cset_acq_config(cset);
+	mutex_unlock(&zio_acq_mutex);
+	return err;
+}
+
+/*
+ * Change one of the four values above (value points into the cset):
+ * it is checked first, and only stored if the configuration applies.
+ */
+int zio_cset_acq_set(struct zio_cset *cset, int *value, int val)
+{
+	unsigned long flags;
+	int err, old;
+
+	if (value == &cset->acq_cpu)
+		err = zio_acq_cpu_valid(val) ? 0 : -EINVAL;
+	else if (value == &cset->acq_prio)
+		err = zio_acq_prio_valid(val) ? 0 : -EINVAL;
+	else /* a budget */
+		err = val < 0 ? -EINVAL : 0;
+	if (err)
+		return err;
+
+	mutex_lock(&zio_acq_mutex);
+	spin_lock_irqsave(&cset->lock, flags);
+	old = *value;
+	*value = val;
+	spin_unlock_irqrestore(&cset->lock, flags);
+	err = __zio_cset_acq_config(cset);
+	if (err) {
+		spin_lock_irqsave(&cset->lock, flags);
+		*value = old;
+		spin_unlock_irqrestore(&cset->lock, flags);
+	}
+	mutex_unlock(&zio_acq_mutex);
+	return err;
+}
+
+int __init zio_done_queue_init(void)
+{
+	struct zio_done_queue *q;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		q = &per_cpu(zio_done_queue, cpu);
+		spin_lock_init(&q->lock);
+		INIT_LIST_HEAD(&q->list);
+		INIT_WORK(&q->work, zio_done_work);
+	}
+	/* Not unbound: each cpu serves the csets it queued */
+	zio_done_wq = alloc_workqueue("zio-done", WQ_HIGHPRI, 0);
+	if (!zio_done_wq)
+		return -ENOMEM;
+	return 0;
+}
+
+/* Wait for the workers, so a cset they still use can be freed */
+void zio_done_queue_flush(void)
+{
+	flush_workqueue(zio_done_wq);
+}
+
+void zio_done_queue_exit(void) /* not __exit: called from zio_init too */
+{
+	destroy_workqueue(zio_done_wq);
+}
+
 
 int zio_generic_push_block(struct zio_ti *ti,
 			   struct zio_channel *chan,
 			   struct zio_block *block)
 {
+	unsigned long flags;
+	int err = 0;
+
+	/* The buffer calls us out of its lock, as the cset lock comes first */
+	spin_lock_irqsave(&chan->cset->lock, flags);
 	if (chan->active_block)
-		return -EBUSY;
-	chan->active_block = block;
+		err = -EBUSY;
+	else
+		zio_set_active_block(chan, block);
+	spin_unlock_irqrestore(&chan->cset->lock, flags);
 
-	return 0;
+	return err;
 }
 EXPORT_SYMBOL(zio_generic_push_block);
@@ -0,0 +1,356 @@
+/*
+ * Copyright 2026 CERN
+ * Author: Alessandro Rubini <rubini@gnudd.com>
+ *
+ * GNU GPLv2 or later
+ *
+ * Software pre-trigger: the cset acquires continuously, in chunks of
+ * samples, and the core keeps the last "pre-samples" of each channel in
+ * a circular history. When the trigger fires, the block returned to the
+ * buffer is assembled from the history and the following "post-samples".
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include <linux/zio.h>
+#include <linux/zio-buffer.h>
+#include <linux/zio-trigger.h>
+#include "zio-internal.h"
+
+struct zio_history_chan {
+	void			*ring;
+	struct zio_block	*block;		/* being assembled */
+};
+
+struct zio_history {
+	struct zio_cset		*cset;
+	unsigned int		chunk;		/* samples per acquisition */
+	unsigned int		pre;		/* ring size, in samples */
+	unsigned int		head, filled;	/* ring status, in samples */
+	unsigned int		npre;		/* of the current event */
+	unsigned int		post_left;	/* 0: no event being assembled */
+	int			event;		/* pending: offset in next chunk */
+	struct timespec		tstamp;		/* of the current event */
+	struct timespec		tstamp_pending;
+	struct zio_history_chan	chan[0];
+};
+
+/* Copy n samples to the ring, starting at sample pos (wrapping around) */
+static void __ring_put(struct zio_history *h, void *ring, unsigned int pos,
+		       void *src, unsigned int n, unsigned int ssize)
+{
+	unsigned int i;
+
+	if (!h->pre || !n)
+		return;
+	if (n > h->pre) { /* only the last ones matter */
+		src += (n - h->pre) * ssize;
+		pos += n - h->pre;
+		n = h->pre;
+	}
+	pos %= h->pre;
+	i = min(n, h->pre - pos);
+	memcpy(ring + pos * ssize, src, i * ssize);
+	memcpy(ring, src + i * ssize, (n - i) * ssize);
+}
+
+/* Copy out the n samples that precede sample pos in the ring */
+static void __ring_get(struct zio_history *h, void *ring, unsigned int pos,
+		       void *dst, unsigned int n, unsigned int ssize)
+{
+	unsigned int start, i;
+
+	if (!n)
+		return;
+	start = (pos % h->pre + h->pre - n) % h->pre;
+	i = min(n, h->pre - start);
+	memcpy(dst, ring + start * ssize, i * ssize);
+	memcpy(dst + i * ssize, ring, (n - i) * ssize);
+}
+
+static void __zio_history_lost(struct zio_cset *cset, int alarm)
+{
+	struct zio_channel *chan;
+
+	chan_for_each(chan, cset)
+		chan->current_ctrl->zio_alarms |= alarm;
+}
+
+/* Forget the history and any event being assembled: cset lock is held */
+void __zio_history_reset(struct zio_cset *cset)
+{
+	struct zio_history *h = cset->history;
+	int i;
+
+	for (i = 0; i < cset->n_chan; i++) {
+		if (!h->chan[i].block)
+			continue;
+		zio_buffer_free_block(cset->chan[i].bi, h->chan[i].block);
+		h->chan[i].block = NULL;
+	}
+	h->head = h->filled = 0;
+	h->post_left = 0;
+	h->event = -1;
+}
+
+/* The number of pre-samples changed: allocate new rings */
+static void __zio_history_resize(struct zio_history *h, unsigned int pre)
+{
+	struct zio_cset *cset = h->cset;
+	size_t size;
+	int i;
+
+	__zio_history_reset(cset);
+	for (i = 0; i < cset->n_chan; i++) {
+		kfree(h->chan[i].ring);
+		h->chan[i].ring = NULL;
+	}
+	h->pre = 0;
+	for (i = 0; pre && i < cset->n_chan; i++) {
+		size = pre * cset->chan[i].current_ctrl->ssize;
+		h->chan[i].ring = kmalloc(size, GFP_ATOMIC);
+		if (!h->chan[i].ring) {
+			/* no history: retry at next chunk */
+			__zio_history_lost(cset, ZIO_ALARM_LOST_BLOCK);
+			return;
+		}
+	}
+	h->pre = pre;
+}
+
+/* The event is over: return the blocks and count the shot */
+static int __zio_history_complete(struct zio_history *h)
+{
+	struct zio_cset *cset = h->cset;
+	struct zio_channel *chan;
+	struct zio_control *ctrl;
+	struct zio_block *block;
+
+	chan_for_each(chan, cset) {
+		block = h->chan[chan->index].block;
+		h->chan[chan->index].block = NULL;
+
+		ctrl = chan->current_ctrl;
+		ctrl->seq_num++;
+		ctrl->tstamp.secs = h->tstamp.tv_sec;
+		ctrl->tstamp.ticks = h->tstamp.tv_nsec;
+		ctrl->tstamp.bins = 0;
+		if (!block)
+			continue;
+
+		/* The trigger point is marked by the actual pre-samples */
+		memcpy(zio_get_ctrl(block), ctrl, zio_control_size(chan));
+		ctrl = zio_get_ctrl(block);
+		ctrl->nsamples = ctrl->ssize ? block->uoff / ctrl->ssize : 0;
+		ctrl->attr_trigger.std_mask |= 1 << ZIO_ATTR_TRIG_PRE_SAMP;
+		ctrl->attr_trigger.std_val[ZIO_ATTR_TRIG_PRE_SAMP] = h->npre;
+		block->datalen = block->uoff;
+		block->uoff = 0;
+		zio_buffer_store_block(chan->bi, block);
+	}
+	return __zio_trigger_last_shot(cset->ti);
+}
+
+/*
+ * This replaces data_done in history mode, and is called with the
+ * cset lock held. Every chunk goes to the history, and if an event
+ * is pending it starts a new block. The return value asks to re-arm,
+ * because acquisition is continuous until the last of nshots.
+ */
+int zio_history_data_done(struct zio_cset *cset)
+{
+	struct zio_history *h = cset->history;
+	struct zio_ti *ti = cset->ti;
+	struct zio_history_chan *hc;
+	struct zio_channel *chan;
+	struct zio_block *block;
+	unsigned int n = 0, pre, post, ssize, start = 0, m = 0;
+	int event = -1;
+
+	pre = zio_ti_std_val(ti, ZIO_ATTR_TRIG_PRE_SAMP);
+	post = zio_ti_std_val(ti, ZIO_ATTR_TRIG_POST_SAMP);
+	if (pre != h->pre)
+		__zio_history_resize(h, pre);
+
+	/* All channels acquired the same number of samples */
+	chan_for_each(chan, cset) {
+		if (chan->active_block && chan->current_ctrl->ssize) {
+			n = chan->active_block->datalen /
+				chan->current_ctrl->ssize;
+			break;
+		}
+	}
+
+	/* Data-driven triggers look for events in the new chunk */
+	if (ti->t_op->scan) {
+		event = ti->t_op->scan(ti, n);
+		if (event >= 0 && h->event < 0 && !h->post_left) {
+			h->event = event;
+			h->tstamp_pending = ti->tstamp;
+		}
+		event = -1;
+	}
+
+	if (h->event >= 0) {
+		if (h->post_left) {
+			/* Still busy with the previous one */
+			__zio_history_lost(cset, ZIO_ALARM_LOST_TRIGGER);
+		} else {
+			event = start = min_t(unsigned int, h->event, n);
+			h->tstamp = h->tstamp_pending;
+			h->npre = min(h->pre, h->filled + event);
+			h->post_left = post;
+		}
+		h->event = -1;
+	}
+	if (h->post_left)
+		m = min(n - start, h->post_left);
+
+	chan_for_each(chan, cset) {
+		hc = h->chan + chan->index;
+		ssize = chan->current_ctrl->ssize;
+		block = chan->active_block;
+		zio_set_active_block(chan, NULL);
+		if (!block) {
+			chan->current_ctrl->zio_alarms |= ZIO_ALARM_LOST_BLOCK;
+			continue;
+		}
+
+		if (event >= 0) {
+			/* History up to the event, then copy it out */
+			__ring_put(h, hc->ring, h->head, block->data, event,
+				   ssize);
+			hc->block = zio_buffer_alloc_block(chan->bi,
+					(h->npre + post) * ssize, GFP_ATOMIC);
+			if (hc->block) {
+				__ring_get(h, hc->ring, h->head + event,
+					   hc->block->data, h->npre, ssize);
+				hc->block->uoff = h->npre * ssize;
+			} else {
+				chan->current_ctrl->zio_alarms |=
+							ZIO_ALARM_LOST_BLOCK;
+			}
+			__ring_put(h, hc->ring, h->head + event,
+				   block->data + event * ssize, n - event,
+				   ssize);
+		} else {
+			__ring_put(h, hc->ring, h->head, block->data, n,
+				   ssize);
+		}
+
+		/* Post-samples go straight from the chunk to the block */
+		if (m && hc->block) {
+			memcpy(hc->block->data + hc->block->uoff,
+			       block->data + start * ssize, m * ssize);
+			hc->block->uoff += m * ssize;
+		}
+		zio_buffer_free_block(chan->bi, block);
+	}
+
+	if (h->pre) {
+		h->head = (h->head + n) % h->pre;
+		h->filled = min(h->filled + n, h->pre);
+	}
+	if (m) {
+		h->post_left -= m;
+		if (!h->post_left && __zio_history_complete(h))
+			return 0; /* nshots are over */
+	}
+	return 1;
+}
+
+/*
+ * A trigger event, in history mode: it is recorded, and the next chunk
+ * starts the block. The function returns 0 if acquisition is not running
+ * yet, so the caller arms the trigger to start it.
+ */
+int zio_history_fire(struct zio_cset *cset)
+{
+	struct zio_history *h = cset->history;
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&cset->lock, flags);
+	if ((cset->ti->flags & ZIO_STATUS) == ZIO_DISABLED) {
+		spin_unlock_irqrestore(&cset->lock, flags);
+		return 1;
+	}
+	if (h->event >= 0)
+		__zio_history_lost(cset, ZIO_ALARM_LOST_TRIGGER);
+	getnstimeofday(&h->tstamp_pending);
+	h->event = 0;
+	ret = cset->ti->flags & ZIO_TI_ARMED;
+	spin_unlock_irqrestore(&cset->lock, flags);
+	return ret;
+}
+
+unsigned int zio_history_chunk(struct zio_cset *cset)
+{
+	return cset->history->chunk;
+}
+
+void zio_history_free(struct zio_cset *cset, struct zio_history *h)
+{
+	int i;
+
+	if (!h)
+		return;
+	for (i = 0; i < cset->n_chan; i++) {
+		if (h->chan[i].block)
+			zio_buffer_free_block(cset->chan[i].bi,
+					      h->chan[i].block);
+		kfree(h->chan[i].ring);
+	}
+	kfree(h);
+}
+
+/*
+ * Enter history mode, with chunks of the given number of samples, or
+ * leave it (chunk = 0). Acquisition restarts at the next trigger event.
+ * As re-arming is continuous, a synchronous device would loop forever
+ * in the caller of zio_arm_trigger: a re-arm budget is required, so the
+ * acquisition thread takes over (and the budget can't be removed).
+ */
+int zio_history_set(struct zio_cset *cset, unsigned int chunk)
+{
+	struct zio_history *h = NULL, *old;
+	unsigned long flags;
+	int tflags, err = 0;
+
+	if (chunk && (cset->flags & ZIO_DIR) == ZIO_DIR_OUTPUT)
+		return -EINVAL;
+	if (chunk && !cset->acq_thread)
+		return -EINVAL; /* no arm-budget */
+	if (!chunk && cset->ti->t_op->scan)
+		return -EBUSY; /* the trigger only works in history mode */
+	if (chunk) {
+		h = kzalloc(sizeof(*h) + cset->n_chan * sizeof(h->chan[0]),
+			    GFP_KERNEL);
+		if (!h)
+			return -ENOMEM;
+		h->cset = cset;
+		h->chunk = chunk;
+		h->event = -1;
+	}
+
+	tflags = zio_trigger_abort_disable(cset, 1);
+	spin_lock_irqsave(&cset->lock, flags);
+	old = cset->history;
+	if (h && !cset->acq_thread) {
+		/* The budget was removed meanwhile: undo, freeing h */
+		err = -EINVAL;
+		old = h;
+	} else {
+		cset->history = h;
+	}
+	if ((tflags & ZIO_STATUS) == ZIO_ENABLED)
+		cset->ti->flags &= ~ZIO_DISABLED;
+	spin_unlock_irqrestore(&cset->lock, flags);
+	zio_history_free(cset, old);
+
+	if (zio_cset_early_arm(cset))
+		__zio_arm_trigger(cset->ti);
+	return err;
+}
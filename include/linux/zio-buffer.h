@@ -47,6 +47,7 @@ struct zio_buffer_type {
 
 /* buffer_type->flags */
 #define ZIO_BUF_FLAG_ALLOC_FOPS	0x00000001 /* set by zio-core */
+#define ZIO_BUF_FLAG_OWN_DATA	0x00000002 /* data is allocated per-block */
 
 extern const struct file_operations zio_generic_file_operations;
 
@@ -85,7 +86,7 @@ struct zio_bi {
 /* first 4bit are reserved for zio object universal flags */
 enum zio_bi_flag_mask {
 	/* Status */
-	ZIO_BI_PUSHING = 0x10,	/* a push is being performed */
+	ZIO_BI_PUSHING = 0x10,	/* a push is being performed (unlocked) */
 	ZIO_BI_NOSPACE = 0x20, /**< No space left in the buffer
 				  (e.g. buffer is full ) */
 	/* Configuration */
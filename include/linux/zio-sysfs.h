@@ -81,6 +81,12 @@ enum zio_chn_bin_attr {
 	__ZIO_BIN_ATTR_NUM,
 };
 
+enum zio_dev_bin_attr {
+	ZIO_BIN_CONFIG = 0,		/* many attributes at once */
+	ZIO_BIN_SNAPSHOT,		/* all attribute values */
+	__ZIO_DEV_BIN_ATTR_NUM,
+};
+
 extern const char zio_zdev_attr_names[_ZIO_DEV_ATTR_STD_NUM][ZIO_NAME_LEN];
 extern const char zio_trig_attr_names[_ZIO_TRG_ATTR_STD_NUM][ZIO_NAME_LEN];
 extern const char zio_zbuf_attr_names[_ZIO_BUF_ATTR_STD_NUM][ZIO_NAME_LEN];
@@ -34,6 +34,7 @@ struct zio_ti {
 
 	unsigned long		flags;		/* input or output, etc */
 	int			nsamples;
+	unsigned int		shots;		/* completed, for nshots */
 	spinlock_t		lock;
 	/* This is for software stamping */
 	struct timespec		tstamp;
@@ -48,6 +49,7 @@ struct zio_ti {
 /* first 4bit are reserved for zio object universal flags */
 enum zio_ti_flag_mask {
 	ZIO_TI_ARMED = 0x10,		/* trigger is armed, device rules */
+	ZIO_TI_COMPLETED = 0x20,	/* nshots are over: end of run */
 };
 
 #define to_zio_ti(obj) container_of(obj, struct zio_ti, head.dev)
@@ -63,6 +65,29 @@ static inline uint32_t zio_ti_std_val(struct zio_ti *ti,
 
 void zio_arm_trigger(struct zio_ti *ti);
 
+/*
+ * Several csets can be armed as one transaction (all or none), and their
+ * transfers can be joined: each member calls zio_join_raw_io from raw_io
+ * and uses zio_join_stop_io as stop_io; when all members are pending the
+ * io method moves data between their active blocks, and all of them
+ * complete. Both are in helpers.c.
+ */
+#define ZIO_JOIN_MAX 8 /* also the limit of lockdep subclasses */
+
+struct zio_join {
+	spinlock_t		lock;
+	unsigned int		n;
+	struct zio_cset		*cset[ZIO_JOIN_MAX];
+	unsigned long		pending; /* bitmask of members in raw_io */
+	void			(*io)(struct zio_join *join);
+};
+
+int zio_arm_csets(struct zio_cset **csets, unsigned int n);
+void zio_join_init(struct zio_join *join, void (*io)(struct zio_join *join));
+int zio_join_add(struct zio_join *join, struct zio_cset *cset);
+int zio_join_raw_io(struct zio_join *join, struct zio_cset *cset);
+void zio_join_stop_io(struct zio_join *join, struct zio_cset *cset);
+
 /*
  * When a buffer has a complete block of data, it can send it to the trigger
  * using push_block. The trigger can either accept it (returns 0) or not
@@ -119,10 +144,29 @@ struct zio_trigger_operations {
 	void			(*abort)(struct zio_ti *ti);
 	int			(*arm)(struct zio_ti *ti);
 	int			(*data_done)(struct zio_cset *cset);
+	/*
+	 * In history mode, scan is called for each acquired chunk, before
+	 * it is stored in the history. It returns the offset of the first
+	 * event in the chunk, or -1 if there is none. Such a trigger
+	 * can't be used out of history mode, so history can't be left.
+	 */
+	int			(*scan)(struct zio_ti *ti, unsigned int n);
+	/*
+	 * At every abort (armed or not) the trigger must release the blocks
+	 * it keeps for later, before the buffer may change. Cset lock held.
+	 */
+	void			(*flush)(struct zio_ti *ti);
 };
 
 int zio_trigger_data_done(struct zio_cset *cset);
 
+/*
+ * This, in helpers.c, can be called in atomic context instead of the
+ * above: it only queues the cset, and the actual data_done is run
+ * later, by a worker bound to the current CPU
+ */
+void zio_trigger_data_done_defer(struct zio_cset *cset);
+
 /* This, in helpers.c, uses the cset spinlock and may return -EAGAIN */
 int __zio_trigger_abort_disable(struct zio_cset *cset, int disable);
 
@@ -153,7 +197,6 @@ static inline int zio_trigger_abort_disable(struct zio_cset *cset, int disable)
 static inline int zio_generic_data_done(struct zio_cset *cset)
 {
 	int self_timed = cset->flags & ZIO_CSET_SELF_TIMED;
-	struct zio_buffer_type *zbuf;
 	struct zio_channel *chan;
 	struct zio_block *block;
 	struct zio_control *ctrl;
@@ -163,7 +206,6 @@ static inline int zio_generic_data_done(struct zio_cset *cset)
 	pr_debug("%s:%d\n", __func__, __LINE__);
 
 	ti = cset->ti;
-	zbuf = cset->zbuf;
 
 	/* Input and output are very similar by now */
 	chan_for_each(chan, cset) {
@@ -172,7 +214,7 @@ static inline int zio_generic_data_done(struct zio_cset *cset)
 		ctrl = chan->current_ctrl;
 
 		/* Remove the block from active block */
-		chan->active_block = NULL;
+		zio_set_active_block(chan, NULL);
 
 		/* Update the current control: sequence and timestamp */
 		ctrl->seq_num++;
@@ -198,30 +240,35 @@ static inline int zio_generic_data_done(struct zio_cset *cset)
 
 	/* Only for output: prepare the next event if any is ready */
 	chan_for_each(chan, cset)
-		chan->active_block = zio_buffer_retr_block(chan->bi);
+		zio_set_active_block(chan, zio_buffer_retr_block(chan->bi));
 
 	return (self_timed ? 1 : 0);
 }
 
+/*
+ * zio_all_block_ready
+ * It returns 1 if all channels have an active_block, otherwise it returns 0
+ */
+static inline unsigned int zio_all_block_ready(struct zio_cset *cset)
+{
+	return atomic_read(&cset->n_chan_ready) == cset->n_chan_enabled;
+}
+
 /**
- * This helper try to push a block to the trigger
+ * This helper try to push a block to the trigger. The buffer must not
+ * hold its own lock, as the trigger takes the cset lock (and may arm)
  */
 static inline int zio_trigger_try_push(struct zio_bi *bi,
 				       struct zio_channel *chan,
 				       struct zio_block *block)
 {
 	struct zio_ti *ti = chan->cset->ti;
-	int pushed;
 
 	/* chek if trigger is disabled */
 	if (unlikely((ti->flags & ZIO_STATUS) == ZIO_DISABLED))
 		return 0;
 
-	/* Keep the lock, but mark we are pushing so trigger-user won't retr */
-	bi->flags |= ZIO_BI_PUSHING;
-	pushed = (ti->t_op->push_block(ti, chan, block) == 0);
-	bi->flags &=  ~ZIO_BI_PUSHING;
-	return pushed;
+	return ti->t_op->push_block(ti, chan, block) == 0;
 }
 
 #endif /* __ZIO_TRIGGER_H__ */
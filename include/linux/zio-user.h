@@ -158,6 +158,7 @@ struct zio_tlv {
 #define ZIO_ALARM_LOST_BLOCK	(1 << 0)	/* It happened */
 #define ZIO_ALARM_LOST_TRIGGER	(1 << 1)	/* Same, cset-wide */
 #define ZIO_ALARM_LOST_SNIFF	(1 << 2)	/* Sniff-device specific */
+#define ZIO_ALARM_UNDERRUN	(1 << 3)	/* Output ran out of blocks */
 
 /*
  * The following data item is the control structure that is being exchanged
@@ -214,6 +215,65 @@ struct zio_control {
 
 #define ZIO_CONTROL_INTERLEAVE_DATA	0x00000040 /* for interleaved data */
 
+/*
+ * Many attributes of a device can be changed at once, by writing an array
+ * of the following items to the "config" binary file of the device. All of
+ * them are checked before any is applied; the triggers are stopped and
+ * re-armed once, and the controls updated once. The write fails as a whole.
+ * At most ZIO_CONFIG_MAX_ITEMS items are accepted: sysfs truncates longer
+ * writes to the file size, so libzio_config refuses them with E2BIG.
+ */
+#define ZIO_CONFIG_NAME_LEN	32
+#define ZIO_CONFIG_MAX_ITEMS	64
+
+enum zio_config_obj {
+	ZIO_CONFIG_DEV = 0,
+	ZIO_CONFIG_CSET,
+	ZIO_CONFIG_CHAN,
+	ZIO_CONFIG_TRIG,	/* the trigger instance of the cset */
+	ZIO_CONFIG_BUF,		/* the buffer instance of the channel */
+	__ZIO_CONFIG_OBJ_NUM,
+};
+
+struct zio_config_item {
+	uint8_t obj;		/* enum zio_config_obj */
+	uint8_t filler;
+	uint16_t cset;		/* unless obj is the device */
+	uint16_t chan;		/* for channels and buffers */
+	uint16_t reserved;
+	uint32_t value;
+	uint32_t reserved2;
+	char name[ZIO_CONFIG_NAME_LEN];	/* as in sysfs, nul-terminated */
+};
+
+/*
+ * The "snapshot" binary file of the device returns all attribute values
+ * of the device, its csets, triggers, channels and buffers: a header,
+ * one record per object, and a copy of the header. Standard values are
+ * at their index, extended ones (parameters too) in the driver's order.
+ * Each read(2) is done under the device lock; "seq" counts configuration
+ * changes, so if header and trailer differ the file must be read again.
+ */
+#define ZIO_SNAPSHOT_VERSION	1
+
+struct zio_snapshot_header {
+	uint16_t version;	/* ZIO_SNAPSHOT_VERSION */
+	uint16_t objsize;	/* sizeof(struct zio_snapshot_obj) */
+	uint32_t nobj;
+	uint32_t seq;
+	uint32_t size;		/* of the whole file */
+};
+
+/* Records are the device, then for each cset: cset, trigger, chan, buf... */
+struct zio_snapshot_obj {
+	uint8_t obj;		/* enum zio_config_obj */
+	uint8_t filler;
+	uint16_t cset;
+	uint16_t chan;
+	uint16_t reserved;
+	struct zio_ctrl_attr attr;
+};
+
 #ifdef __KERNEL__
 /*
  * Compile-time check that the control structure is the right size.
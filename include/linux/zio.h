@@ -23,16 +23,19 @@ extern const uint32_t zio_version;
 #include <linux/list.h>
 #include <linux/string.h>
 #include <linux/spinlock.h>
+#include <linux/bitops.h>
 
 #include <linux/zio-sysfs.h>
 
 #define ZIO_NR_MINORS  (1<<16) /* Ask for 64k minors: no harm done... */
+#define ZIO_ACTIVE_BLOCKS_MAX 8 /* per channel, for gapless acquisition */
 
 /* Name the data structures */
 struct zio_device; /* both type (a.k.a. driver) and instance (a.k.a. device) */
 struct zio_channel; struct zio_cset;
 struct zio_buffer_type; struct zio_bi; struct zio_block;
 struct zio_trigger_type; struct zio_ti;
+struct zio_history;
 
 struct zio_device_operations;
 struct zio_buffer_operations;
@@ -129,6 +132,7 @@ struct zio_device {
 	uint32_t				dev_id; /* Driver-specific id */
 	struct module				*owner;
 	spinlock_t				lock; /* for all attr ops */
+	uint32_t				config_seq; /* changes */
 	unsigned long				flags;
 	struct zio_attribute_set		zattr_set;
 	const struct zio_sysfs_operations	*s_op;
@@ -178,10 +182,24 @@ struct zio_cset {
 	/* The cset is an array of channels */
 	struct zio_channel	*chan;
 	unsigned int		n_chan;
+	unsigned long		*chan_enabled;	/* bitmap, see chan_for_each */
+	unsigned int		n_chan_enabled;
+	atomic_t		n_chan_ready;	/* enabled, with active_block */
 
 	void			*priv_d;	/* private for the device */
 
 	struct list_head	list_cset;	/* for cset global list */
+	struct list_head	list_done;	/* for deferred data_done */
+
+	/* Self-timed re-arm: budget for each call, then defer to thread */
+	int			arm_budget;	/* events, 0 = unbounded */
+	int			arm_budget_ns;	/* time, 0 = unbounded */
+	int			acq_cpu;	/* -1 = any cpu */
+	int			acq_prio;	/* SCHED_FIFO if not 0 */
+	struct task_struct	*acq_thread;
+
+	struct zio_history	*history;	/* software pre-trigger */
+	unsigned int		active_blocks;	/* per channel, 1 = no queue */
 	int			minor, maxminor;
 	char			*default_zbuf;
 	char			*default_trig;
@@ -201,6 +219,8 @@ enum zio_cset_flags {
 	ZIO_CSET_CHAN_INTERLEAVE= 0x200, /* 1 if cset can interleave */
 	ZIO_CSET_INTERLEAVE_ONLY= 0x400, /* 1 if interleave only */
 	ZIO_CSET_HW_BUSY	= 0x800, /* set by driver, delays abort */
+	ZIO_CSET_DONE_PENDING	= 0x1000, /* deferred data_done, delays abort */
+	ZIO_CSET_REARM_PENDING	= 0x2000, /* acq_thread must re-arm */
 };
 
 /* Check the flags so we know whether to arm immediately or not */
@@ -238,11 +258,24 @@ struct zio_channel {
 	struct zio_block	*user_block;	/* being transferred w/ user */
 	struct mutex		user_lock;
 	struct zio_block	*active_block;	/* being managed by hardware */
+	/* next blocks, already allocated, if the cset has active_blocks > 1 */
+	struct zio_block	*queued[ZIO_ACTIVE_BLOCKS_MAX - 1];
+	unsigned int		n_queued;
 
 	void			(*change_flags)(struct zio_obj_head *head,
 						unsigned long mask);
 };
 
+/*
+ * The next blocks a driver may start filling, while the active one
+ * completes: at data_done time the first of them becomes active.
+ */
+static inline struct zio_block *zio_chan_queued_block(struct zio_channel *chan,
+						      unsigned int i)
+{
+	return i < chan->n_queued ? chan->queued[i] : NULL;
+}
+
 /* first 4bit are reserved for zio object universal flags */
 enum zio_chan_flags {
 	ZIO_CHAN_POLAR		= 0x10,	/* 0 is positive - 1 is negative*/
@@ -250,19 +283,16 @@ enum zio_chan_flags {
 	ZIO_CHAN_POLAR_NEGATIVE	= 0x10,
 };
 
-/* get each channel from cset */
+/* get each channel from cset: the enabled ones are a bitmap in the cset */
 static inline struct zio_channel *zio_first_enabled_chan(struct zio_cset *cset,
 						struct zio_channel *chan)
 {
-	if (unlikely(chan - cset->chan >= cset->n_chan))
-		return NULL;
-	while (1) {
-		if (!(chan->flags & ZIO_DISABLED))
-			return chan; /* if is enabled, use this */
-		if (chan->index+1 == cset->n_chan)
-			return NULL; /* no more channels */
-		chan++;
-	}
+	unsigned long i;
+
+	i = find_next_bit(cset->chan_enabled, cset->n_chan, chan - cset->chan);
+	if (i >= cset->n_chan)
+		return NULL; /* no more channels */
+	return cset->chan + i;
 }
 #define chan_for_each(cptr, cset)				\
 		for (cptr = cset->chan;				\
@@ -278,12 +308,23 @@ static inline struct zio_channel *zio_first_enabled_chan(struct zio_cset *cset,
  * after the complete consumption of the information provided by this function
  */
 static inline unsigned int zio_get_n_chan_enabled(struct zio_cset *cset) {
-	struct zio_channel *chan;
-	unsigned int n_chan = 0;
+	return cset->n_chan_enabled;
+}
+
+/*
+ * Enabled channels holding an active block are counted in the cset, so
+ * a trigger knows in O(1) when all of them are ready. Whoever changes
+ * chan->active_block must do it through this function, with the cset lock.
+ */
+static inline void zio_set_active_block(struct zio_channel *chan,
+					struct zio_block *block)
+{
+	struct zio_cset *cset = chan->cset;
 
-	chan_for_each(chan, cset)
-		++n_chan;
-	return n_chan;
+	if (!chan->active_block != !block &&
+	    test_bit(chan->index, cset->chan_enabled))
+		atomic_add(block ? 1 : -1, &cset->n_chan_ready);
+	chan->active_block = block;
 }
 
 /* We suggest all drivers have these options */
@@ -181,6 +181,10 @@ found:
 	}
 	/* split the cell: "new" is the busy head, ffa still points to c */
 	new = kzalloc(sizeof(*new), gfp);
+	if (!new) {
+		spin_unlock_irqrestore(&ffa->lock, flags);
+		return ZIO_FFA_NOSPACE;
+	}
 	new->begin = c->begin;
 	new->end = new->begin + size;
 	c->begin = new->end;
@@ -208,18 +212,28 @@ void zio_ffa_free_s(struct zio_ffa *ffa, unsigned long addr, size_t size)
 			break;
 	BUG_ON(!c);
 	BUG_ON(c->status == FFA_FREE);
-	if (c->begin != addr) {
-		/* add a busy cell before us */
+	if (c->begin != addr)
 		prev = kzalloc(sizeof(*prev), GFP_ATOMIC);
+	if (c->end != end)
+		next = kzalloc(sizeof(*next), GFP_ATOMIC);
+	if ((c->begin != addr && !prev) || (c->end != end && !next)) {
+		/* can't split the cell: the area stays busy until reset */
+		pr_err("%s: no memory, losing 0x%08lx-0x%08lx\n", __func__,
+		       addr, end);
+		kfree(prev);
+		kfree(next);
+		goto out;
+	}
+	if (prev) {
+		/* add a busy cell before us */
 		prev->begin = c->begin;
 		prev->end = addr;
 		prev->status = c->status;
 		c->begin = addr;
 		list_add_tail(&prev->list, &c->list);
 	}
-	if (c->end != addr + size) {
+	if (next) {
 		/* add a busy cell after us */
-		next = kzalloc(sizeof(*next), GFP_ATOMIC);
 		next->begin = end;
 		next->end = c->end;
 		next->status = c->status;
@@ -233,7 +247,7 @@ void zio_ffa_free_s(struct zio_ffa *ffa, unsigned long addr, size_t size)
 		ffa_merge(ffa, next);
 	if (!prev || !next)
 		ffa_merge(ffa, c);
-
+out:
 	TRACE_FFA(ffa, "after free");
 	spin_unlock_irqrestore(&ffa->lock, flags);
 }
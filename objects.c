@@ -430,17 +430,21 @@ int zio_change_current_trigger(struct zio_cset *cset, char *name)
 		goto out_put;
 	}
 
-	/* Ok, we are done. Kill the current trigger to replace it*/
+	/* Ok, we are done. Stop the current trigger to replace it */
 	zio_trigger_abort_disable(cset, 1);
-	__ti_destroy(trig_old, ti_old);
-	zio_trigger_put(trig_old, cset->zdev->owner);
 
-	/* Set new trigger and rename "trigger-tmp" to "trigger" */
+	/* Set new trigger; config and snapshot walk it with the device lock */
+	spin_lock(&cset->zdev->lock);
 	spin_lock_irqsave(&cset->lock, flags);
 	cset->trig = trig;
 	cset->ti = ti;
-	err = device_rename(&ti->head.dev, "trigger");
 	spin_unlock_irqrestore(&cset->lock, flags);
+	spin_unlock(&cset->zdev->lock);
+
+	/* Kill the old one, then rename "trigger-tmp" to "trigger" */
+	__ti_destroy(trig_old, ti_old);
+	zio_trigger_put(trig_old, cset->zdev->owner);
+	err = device_rename(&ti->head.dev, "trigger");
 
 	WARN(err, "%s: cannot rename trigger folder for cset%d\n", __func__,
 	     cset->index);
@@ -456,7 +460,7 @@ int zio_change_current_trigger(struct zio_cset *cset, char *name)
 
 	/* Finally, arm it if so needed */
 	if (zio_cset_early_arm(cset))
-		zio_arm_trigger(ti);
+		__zio_arm_trigger(ti);
 
 	return 0;
 
@@ -527,18 +531,22 @@ int zio_change_current_buffer(struct zio_cset *cset, char *name)
 	}
 	tflags = zio_trigger_abort_disable(cset, 1);
 
+	/* Swap the instances under the device lock, as config and snapshot */
+	spin_lock(&cset->zdev->lock);
+	for (i = 0; i < cset->n_chan; ++i)
+		swap(cset->chan[i].bi, bi_vector[i]);
+	cset->zbuf = zbuf;
+	spin_unlock(&cset->zdev->lock);
+
 	for (i = 0; i < cset->n_chan; ++i) {
-		/* Delete old buffer instance */
-		__bi_destroy(zbuf_old, cset->chan[i].bi);
-		/* Assign new buffer instance */
-		cset->chan[i].bi = bi_vector[i];
-		/* Rename buffer-tmp to trigger */
+		/* Delete old buffer instance, now in the vector */
+		__bi_destroy(zbuf_old, bi_vector[i]);
+		/* Rename buffer-tmp to buffer */
 		err = device_rename(&cset->chan[i].bi->head.dev, "buffer");
 		if (err)
 			WARN(1, "%s: cannot rename buffer folder for"
 				" cset%d:chan%d\n", __func__, cset->index, i);
 	}
-	cset->zbuf = zbuf;
 	kfree(bi_vector);
 	zio_buffer_put(zbuf_old, cset->zdev->owner);
 
@@ -549,7 +557,7 @@ int zio_change_current_buffer(struct zio_cset *cset, char *name)
 
 	/* Finally, arm the trigger if so needed */
 	if (zio_cset_early_arm(cset))
-		zio_arm_trigger(ti);
+		__zio_arm_trigger(ti);
 
 	return 0;
 
@@ -888,7 +896,16 @@ static int cset_register(struct zio_cset *cset, struct zio_cset *cset_t)
 	struct zio_ti *ti = NULL;
 
 	cset->head.zobj_type = ZIO_CSET;
+	cset->acq_cpu = -1; /* the template may only set budget and prio */
+	/* The template may ask for more active blocks, for DMA streaming */
+	cset->active_blocks = clamp_t(unsigned int, cset->active_blocks,
+				      1, ZIO_ACTIVE_BLOCKS_MAX);
 	zio_cset_assign_flags(cset, cset_t);
+	if (cset->active_blocks > 1 &&
+	    (cset->flags & ZIO_DIR) == ZIO_DIR_OUTPUT) {
+		pr_err("ZIO: output csets can't have more active blocks\n");
+		return -EINVAL;
+	}
 	if (cset->flags & ZIO_CSET_CHAN_INTERLEAVE)
 		cset->n_chan++;	/* add a channel during allocation */
 
@@ -916,6 +933,7 @@ static int cset_register(struct zio_cset *cset, struct zio_cset *cset_t)
 	snprintf(cset_name, ZIO_NAME_LEN, "cset%i", cset->index);
 	dev_set_name(&cset->head.dev, cset_name);
 	spin_lock_init(&cset->lock);
+	INIT_LIST_HEAD(&cset->list_done);
 	cset->head.dev.type = &cset_device_type;
 	cset->head.dev.parent = &cset->zdev->head.dev;
 	err = device_register(&cset->head.dev);
@@ -953,6 +971,13 @@ static int cset_register(struct zio_cset *cset, struct zio_cset *cset_t)
 	cset->chan = kzalloc(size, GFP_KERNEL);
 	if (!cset->chan)
 		goto out_n_chan;
+	cset->chan_enabled = kcalloc(BITS_TO_LONGS(cset->n_chan),
+				     sizeof(unsigned long), GFP_KERNEL);
+	if (!cset->chan_enabled) {
+		err = -ENOMEM;
+		goto out_bitmap;
+	}
+	atomic_set(&cset->n_chan_ready, 0);
 
 	/* Setup interleaved channel if it exists */
 	cset->interleave = zio_assign_interleave_channel(cset);
@@ -974,6 +999,11 @@ static int cset_register(struct zio_cset *cset, struct zio_cset *cset_t)
 		if (cset->flags & ZIO_CSET_INTERLEAVE_ONLY)
 			cset->chan[i].flags |= ZIO_DISABLED;
 	}
+	/* Now the flags are final: fill the bitmap of enabled channels */
+	spin_lock(&cset->zdev->lock);
+	for (i = 0; i < cset->n_chan; i++)
+		__zio_chan_sync_enabled(&cset->chan[i]);
+	spin_unlock(&cset->zdev->lock);
 
 	spin_lock(&zstat->lock);
 	list_add(&cset->list_cset, &zstat->list_cset);
@@ -984,14 +1014,19 @@ static int cset_register(struct zio_cset *cset, struct zio_cset *cset_t)
 	ti->flags &= ~ZIO_DISABLED;
 	spin_unlock_irqrestore(&cset->lock, flags);
 
+	if (zio_cset_acq_config(cset))
+		dev_warn(&cset->head.dev, "invalid re-arm budget or thread\n");
+
 	if (zio_cset_early_arm(cset))
-		zio_arm_trigger(ti);
+		__zio_arm_trigger(ti);
 
 	return 0;
 
 out_reg:
 	for (j = i-1; j >= 0; j--)
 		chan_unregister(&cset->chan[j]);
+	kfree(cset->chan_enabled);
+out_bitmap:
 	kfree(cset->chan);
 out_n_chan:
 	__ti_destroy(cset->trig, ti);
@@ -1019,11 +1054,17 @@ static void cset_unregister(struct zio_cset *cset)
 	spin_lock(&zstat->lock);
 	list_del(&cset->list_cset);
 	spin_unlock(&zstat->lock);
-	/* Make it idle */
+	/* Make it idle: a done worker may be re-arming after DONE_PENDING */
 	zio_trigger_abort_disable(cset, 1);
+	zio_done_queue_flush();
+	zio_cset_acq_stop(cset);
+	zio_history_free(cset, cset->history);
+	cset->history = NULL;
 	/* Unregister all child channels */
 	for (i = 0; i < cset->n_chan; i++)
 		chan_unregister(&cset->chan[i]);
+	kfree(cset->chan_enabled);
+	cset->chan_enabled = NULL;
 
 	/* destroy instance and decrement trigger usage */
 	__ti_destroy(cset->trig, cset->ti);
@@ -1134,7 +1175,15 @@ int __zdev_register(struct zio_device *parent,
 	err = device_register(&zdev->head.dev);
 	if (err)
 		goto out_dev;
-
+	if (ZIO_HAS_BINARY_CONTROL) {
+		for (i = 0; i < __ZIO_DEV_BIN_ATTR_NUM; ++i) {
+			/* Create the sysfs binary file for configuration */
+			err = sysfs_create_bin_file(&zdev->head.dev.kobj,
+						    &zio_dev_bin_attr[i]);
+			if (err)
+				goto out_bin_attr;
+		}
+	}
 
 	size = sizeof(struct zio_cset) * zdev->n_cset;
 	zdev->cset = kzalloc(size, GFP_KERNEL);
@@ -1162,6 +1211,13 @@ out_cset:
 		cset_unregister(&zdev->cset[i]);
 	kfree(zdev->cset);
 out_alloc_cset:
+	i = __ZIO_DEV_BIN_ATTR_NUM;
+out_bin_attr:
+	if (ZIO_HAS_BINARY_CONTROL) {
+		while (i--)
+			sysfs_remove_bin_file(&zdev->head.dev.kobj,
+					      &zio_dev_bin_attr[i]);
+	}
 	device_unregister(&zdev->head.dev);
 out_dev:
 	zobj_unregister(&zstat->all_devices, &zdev->head);
@@ -1177,6 +1233,10 @@ void __zdev_unregister(struct zio_device *zdev)
 
 	for (i = 0; i < zdev->n_cset; ++i)
 		cset_unregister(&zdev->cset[i]);
+	if (ZIO_HAS_BINARY_CONTROL)
+		for (i = 0; i < __ZIO_DEV_BIN_ATTR_NUM; ++i)
+			sysfs_remove_bin_file(&zdev->head.dev.kobj,
+					      &zio_dev_bin_attr[i]);
 	device_unregister(&zdev->head.dev);
 }
 
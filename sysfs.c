@@ -107,6 +107,12 @@ spinlock_t *__zio_get_dev_spinlock(struct zio_obj_head *head)
 	return lock;
 }
 
+/* Count a configuration change, for the snapshot; called with the lock */
+static inline void __zio_config_changed(spinlock_t *lock)
+{
+	container_of(lock, struct zio_device, lock)->config_seq++;
+}
+
 
 /*
  * used to init and update sysfs attribute value into a control.
@@ -323,6 +329,35 @@ int __zattr_dev_init_ctrl(struct zio_device *zdev)
 	return 0;
 }
 
+/*
+ * Reflect the enable status of a channel in the bitmap of its cset, used
+ * by chan_for_each, and in the count of ready channels (see
+ * zio_set_active_block). Called with the device spinlock, after any change;
+ * the cset lock serializes against the data path setting active_block.
+ */
+void __zio_chan_sync_enabled(struct zio_channel *chan)
+{
+	struct zio_cset *cset = chan->cset;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cset->lock, flags);
+	if (chan->flags & ZIO_DISABLED) {
+		if (!test_and_clear_bit(chan->index, cset->chan_enabled))
+			goto out;
+		cset->n_chan_enabled--;
+		if (chan->active_block)
+			atomic_dec(&cset->n_chan_ready);
+	} else {
+		if (test_and_set_bit(chan->index, cset->chan_enabled))
+			goto out;
+		cset->n_chan_enabled++;
+		if (chan->active_block)
+			atomic_inc(&cset->n_chan_ready);
+	}
+out:
+	spin_unlock_irqrestore(&cset->lock, flags);
+}
+
 /**
  * The function perform a post processing of the enable status of a channel
  * when it change. This implements the enable/disable policies when there is
@@ -431,6 +466,7 @@ int __zio_object_enable(struct zio_obj_head *head, unsigned int enable)
 			__ctrl_update_nsamples(chan->cset->ti);
 			__chan_enable_interleave(chan, enable);
 		}
+		__zio_chan_sync_enabled(chan);
 
 		/* channel callback */
 		if (chan->change_flags)
@@ -448,6 +484,10 @@ int __zio_object_enable(struct zio_obj_head *head, unsigned int enable)
 			return i;
 
 		spin_lock_irqsave(&ti->cset->lock, flags);
+		if (!status) { /* enabling starts a new run of nshots */
+			ti->shots = 0;
+			ti->flags &= ~ZIO_TI_COMPLETED;
+		}
 		if (ti->t_op->change_status)
 			ti->t_op->change_status(ti, status);
 		spin_unlock_irqrestore(&ti->cset->lock, flags);
@@ -516,7 +556,12 @@ static ssize_t zobj_store_cur_trig(struct device *dev,
 	}
 
 	err = zio_change_current_trigger(to_zio_cset(dev), buf_tmp);
-	return err ? err : count;
+	if (err)
+		return err;
+	spin_lock(&to_zio_cset(dev)->zdev->lock);
+	to_zio_cset(dev)->zdev->config_seq++;
+	spin_unlock(&to_zio_cset(dev)->zdev->lock);
+	return count;
 }
 /* Print the current buffer name */
 static ssize_t zobj_show_cur_zbuf(struct device *dev,
@@ -542,7 +587,12 @@ static ssize_t zobj_store_cur_zbuf(struct device *dev,
 	}
 
 	err = zio_change_current_buffer(to_zio_cset(dev), buf_tmp);
-	return err ? err : count;
+	if (err)
+		return err;
+	spin_lock(&to_zio_cset(dev)->zdev->lock);
+	to_zio_cset(dev)->zdev->config_seq++;
+	spin_unlock(&to_zio_cset(dev)->zdev->lock);
+	return count;
 }
 /* Print the current enable status */
 static ssize_t zobj_show_enable(struct device *dev,
@@ -573,6 +623,8 @@ static ssize_t zobj_store_enable(struct device *dev,
 	do {
 		spin_lock(lock);
 		err = __zio_object_enable(head, val);
+		if (!err)
+			__zio_config_changed(lock);
 		spin_unlock(lock);
 		if (err == -EAGAIN)
 			msleep(1);
@@ -668,13 +720,15 @@ static ssize_t zattr_store(struct device *dev, struct device_attribute *attr,
 
 	/* Configure the attribute */
 	err = __zio_conf_set(head, zattr, (uint32_t)val);
+	if (!err)
+		__zio_config_changed(lock);
 
 	if (head->zobj_type == ZIO_TI) {
 		/* restore trigger status */
 		if (ti && ((tflags & ZIO_STATUS) == ZIO_ENABLED))
 			ti->flags = (ti->flags & ~ZIO_STATUS) | ZIO_ENABLED;
 		if (ti && (tflags & ZIO_TI_ARMED))
-			zio_arm_trigger(ti);
+			__zio_arm_trigger(ti);
 	}
 
 	spin_unlock(lock);
@@ -829,6 +883,97 @@ static ssize_t zio_show_dire(struct device *dev,
 	return sprintf(buf, "%s\n", cset->flags & ZIO_DIR ? "output" : "input");
 }
 
+/*
+ * Re-arm budget and acquisition thread of a self-timed cset. The
+ * four attributes are all integers, so they share show and store.
+ */
+static int *zio_cset_acq_value(struct zio_cset *cset, const char *name)
+{
+	if (!strcmp(name, "arm-budget"))
+		return &cset->arm_budget;
+	if (!strcmp(name, "arm-budget-ns"))
+		return &cset->arm_budget_ns;
+	if (!strcmp(name, "acq-cpu"))
+		return &cset->acq_cpu;
+	return &cset->acq_prio;
+}
+static ssize_t zio_show_acq(struct device *dev,
+			    struct device_attribute *attr, char *buf)
+{
+	struct zio_cset *cset = to_zio_cset(dev);
+	int *value = zio_cset_acq_value(cset, attr->attr.name);
+
+	return sprintf(buf, "%d\n", *value);
+}
+static ssize_t zio_store_acq(struct device *dev,
+			     struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct zio_cset *cset = to_zio_cset(dev);
+	int *value = zio_cset_acq_value(cset, attr->attr.name);
+	long val;
+	int err;
+
+	if (kstrtol(buf, 0, &val))
+		return -EINVAL;
+	if (val < INT_MIN || val > INT_MAX)
+		return -ERANGE;
+	err = zio_cset_acq_set(cset, value, val);
+	return err ? err : count;
+}
+
+/*
+ * Software pre-trigger: the number of samples acquired at each arm,
+ * continuously, to feed the history (0 means normal acquisition)
+ */
+static ssize_t zio_show_history(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct zio_cset *cset = to_zio_cset(dev);
+
+	return sprintf(buf, "%u\n",
+		       cset->history ? zio_history_chunk(cset) : 0);
+}
+static ssize_t zio_store_history(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct zio_cset *cset = to_zio_cset(dev);
+	unsigned long val;
+	int err;
+
+	if (kstrtoul(buf, 0, &val))
+		return -EINVAL;
+	err = zio_history_set(cset, val);
+	return err ? err : count;
+}
+
+/*
+ * Active blocks per channel: with more than one, the next blocks are
+ * allocated in advance, so the driver can stream with no gaps
+ */
+static ssize_t zio_show_active_blocks(struct device *dev,
+				      struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", to_zio_cset(dev)->active_blocks);
+}
+static ssize_t zio_store_active_blocks(struct device *dev,
+				       struct device_attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct zio_cset *cset = to_zio_cset(dev);
+	unsigned long val;
+
+	if (kstrtoul(buf, 0, &val))
+		return -EINVAL;
+	if (!val || val > ZIO_ACTIVE_BLOCKS_MAX)
+		return -EINVAL;
+	if (val > 1 && (cset->flags & ZIO_DIR) == ZIO_DIR_OUTPUT)
+		return -EINVAL;
+	zio_cset_set_active_blocks(cset, val);
+	return count;
+}
+
 /**
  * It configures the buffer preference:
  * 0 - it will keep the oldest block when the buffer is full
@@ -911,6 +1056,416 @@ static ssize_t zobj_show_address(struct file *file, struct kobject *kobj,
 
 }
 
+/*
+ * zdev_store_config
+ * it applies a list of attribute values (struct zio_config_item) as a whole
+ */
+struct zio_config_op {
+	struct zio_obj_head *head;
+	struct zio_attribute *zattr;
+	struct zio_cset *cset;		/* NULL for device attributes */
+	uint32_t old;
+};
+
+struct zio_config_cset {
+	int touched;
+	int tflags;
+};
+
+static struct zio_attribute *__zattr_find(struct zio_attribute_set *zattr_set,
+					  const char *name)
+{
+	struct zio_attribute *zattr;
+	int i;
+
+	for (i = 0; i < zattr_set->n_std_attr; ++i) {
+		zattr = &zattr_set->std_zattr[i];
+		if (zattr->index == ZIO_ATTR_INDEX_NONE)
+			continue; /* unused std attribute */
+		if (!strcmp(zattr->attr.attr.name, name))
+			return zattr;
+	}
+	for (i = 0; i < zattr_set->n_ext_attr; ++i) {
+		zattr = &zattr_set->ext_zattr[i];
+		if (!strcmp(zattr->attr.attr.name, name))
+			return zattr;
+	}
+	return NULL;
+}
+
+/* Check the indexes, so the item names an object that exists */
+static int __zconf_check(struct zio_device *zdev, struct zio_config_item *item)
+{
+	if (item->obj >= __ZIO_CONFIG_OBJ_NUM)
+		return -EINVAL;
+	if (strnlen(item->name, ZIO_CONFIG_NAME_LEN) == ZIO_CONFIG_NAME_LEN)
+		return -EINVAL;
+	if (item->obj == ZIO_CONFIG_DEV)
+		return 0;
+	if (item->cset >= zdev->n_cset)
+		return -ENODEV;
+	if (item->obj != ZIO_CONFIG_CHAN && item->obj != ZIO_CONFIG_BUF)
+		return 0;
+	if (item->chan >= zdev->cset[item->cset].n_chan)
+		return -ENODEV;
+	return 0;
+}
+
+/* Find object and attribute, and check the value; called with the lock */
+static int __zconf_resolve(struct zio_device *zdev,
+			   struct zio_config_item *item, struct zio_config_op *op)
+{
+	struct zio_attribute_set *zattr_set;
+	struct zio_attribute *zattr;
+	struct zio_cset *cset = NULL;
+	uint32_t val = item->value;
+
+	if (item->obj != ZIO_CONFIG_DEV)
+		cset = &zdev->cset[item->cset];
+	switch (item->obj) {
+	case ZIO_CONFIG_DEV:
+		op->head = &zdev->head;
+		break;
+	case ZIO_CONFIG_CSET:
+		op->head = &cset->head;
+		break;
+	case ZIO_CONFIG_CHAN:
+		op->head = &cset->chan[item->chan].head;
+		break;
+	case ZIO_CONFIG_TRIG:
+		op->head = &cset->ti->head;
+		break;
+	case ZIO_CONFIG_BUF:
+		op->head = &cset->chan[item->chan].bi->head;
+		break;
+	}
+	op->cset = cset;
+
+	zattr_set = zio_get_from_obj(op->head, zattr_set);
+	zattr = __zattr_find(zattr_set, item->name);
+	if (!zattr) {
+		dev_err(&zdev->head.dev, "%s: no attribute \"%s\"\n",
+			dev_name(&op->head->dev), item->name);
+		return -ENOENT;
+	}
+	if (!zattr->s_op || !zattr->s_op->conf_set ||
+	    !(zattr->attr.attr.mode & S_IWUGO))
+		return -EACCES;
+	/* Same as zattr_store: 'min == max' means no range */
+	if (zattr->min != zattr->max &&
+	    (val < zattr->min || val > zattr->max)) {
+		dev_err(&zdev->head.dev, "%s: value %u exceed range [%u, %u]\n",
+			zattr->attr.attr.name, val, zattr->min, zattr->max);
+		return -EINVAL;
+	}
+	op->zattr = zattr;
+	return 0;
+}
+
+/*
+ * Copy the new values into the current controls, once per cset. This is
+ * __zio_attr_propagate_value for all the items, under a single I/O lock.
+ */
+static void __zconf_propagate(struct zio_device *zdev, struct zio_config_op *op,
+			      int n, struct zio_config_cset *zc)
+{
+	struct zio_control *ctrl;
+	struct zio_cset *cset;
+	unsigned long flags;
+	int c, i, j;
+
+	for (c = 0; c < zdev->n_cset; ++c) {
+		if (!zc[c].touched)
+			continue;
+		cset = &zdev->cset[c];
+		spin_lock_irqsave(&cset->lock, flags);
+		for (i = 0; i < n; ++i) {
+			if (op[i].head->zobj_type == ZIO_TI &&
+			    op[i].cset == cset) {
+				__ctrl_update_nsamples(cset->ti);
+				break;
+			}
+		}
+		for (j = 0; j < cset->n_chan; ++j) {
+			ctrl = cset->chan[j].current_ctrl;
+			for (i = 0; i < n; ++i) {
+				if (!(op[i].zattr->flags & ZIO_ATTR_CONTROL))
+					continue;
+				switch (op[i].head->zobj_type) {
+				case ZIO_DEV:
+					break;
+				case ZIO_CSET:
+					if (op[i].cset != cset)
+						continue;
+					break;
+				case ZIO_CHAN:
+					if (op[i].head != &cset->chan[j].head)
+						continue;
+					break;
+				case ZIO_TI:
+					if (op[i].cset == cset)
+						__zattr_valcpy(&ctrl->attr_trigger,
+							       op[i].zattr);
+					continue;
+				default:
+					continue;
+				}
+				__zattr_valcpy(&ctrl->attr_channel, op[i].zattr);
+			}
+		}
+		spin_unlock_irqrestore(&cset->lock, flags);
+	}
+}
+
+static ssize_t zdev_store_config(struct file *file, struct kobject *kobj,
+				 struct bin_attribute *bin_attr,
+				 char *buf, loff_t off, size_t count)
+{
+	struct zio_config_item *item = (struct zio_config_item *)buf;
+	struct zio_config_cset *zc;
+	struct zio_config_op *op;
+	struct zio_device *zdev;
+	struct zio_ti *ti;
+	int c, i, n, err = 0;
+
+	/* This file must be written entirely */
+	if (off != 0)
+		return -ESPIPE; /* Illegal seek */
+	if (!count || count % sizeof(*item))
+		return -EINVAL;
+	n = count / sizeof(*item);
+
+	zdev = to_zio_dev(container_of(kobj, struct device, kobj));
+	op = kcalloc(n, sizeof(*op), GFP_KERNEL);
+	zc = kcalloc(zdev->n_cset, sizeof(*zc), GFP_KERNEL);
+	if (!op || !zc) {
+		err = -ENOMEM;
+		goto out_free;
+	}
+	for (i = 0; i < n; ++i) {
+		err = __zconf_check(zdev, &item[i]);
+		if (err)
+			goto out_free;
+		if (item[i].obj != ZIO_CONFIG_DEV) {
+			zc[item[i].cset].touched = 1;
+			continue;
+		}
+		for (c = 0; c < zdev->n_cset; ++c)
+			zc[c].touched = 1;
+	}
+
+	/* Find and check all of them before stopping any trigger */
+	spin_lock(&zdev->lock);
+	for (i = 0; i < n; ++i) {
+		err = __zconf_resolve(zdev, &item[i], &op[i]);
+		if (err)
+			break;
+	}
+	spin_unlock(&zdev->lock);
+	if (err)
+		goto out_free;
+
+	/* Stop the triggers once; this may sleep, so it's out of the lock */
+	for (c = 0; c < zdev->n_cset; ++c)
+		if (zc[c].touched)
+			zc[c].tflags = zio_trigger_abort_disable(&zdev->cset[c],
+								 1);
+
+	spin_lock(&zdev->lock);
+	/* Meanwhile, the trigger or buffer instances may have been replaced */
+	for (i = 0; i < n; ++i) {
+		if (item[i].obj != ZIO_CONFIG_TRIG &&
+		    item[i].obj != ZIO_CONFIG_BUF)
+			continue;
+		err = __zconf_resolve(zdev, &item[i], &op[i]);
+		if (err)
+			goto out_restore;
+	}
+	for (i = 0; i < n; ++i) {
+		op[i].old = op[i].zattr->value;
+		err = op[i].zattr->s_op->conf_set(&op[i].head->dev, op[i].zattr,
+						  item[i].value);
+		if (err)
+			break;
+		op[i].zattr->value = item[i].value;
+	}
+	if (err) {
+		/* Back to the previous values, in reverse order */
+		dev_err(&zdev->head.dev, "config: \"%s\" failed (%i)\n",
+			item[i].name, err);
+		while (--i >= 0) {
+			op[i].zattr->s_op->conf_set(&op[i].head->dev,
+						    op[i].zattr, op[i].old);
+			op[i].zattr->value = op[i].old;
+		}
+		goto out_restore;
+	}
+	__zconf_propagate(zdev, op, n, zc);
+	zdev->config_seq++;
+
+out_restore:
+	/* restore trigger status, as zattr_store does */
+	for (c = 0; c < zdev->n_cset; ++c) {
+		if (!zc[c].touched)
+			continue;
+		ti = zdev->cset[c].ti;
+		if ((zc[c].tflags & ZIO_STATUS) == ZIO_ENABLED)
+			ti->flags = (ti->flags & ~ZIO_STATUS) | ZIO_ENABLED;
+		if (zc[c].tflags & ZIO_TI_ARMED)
+			__zio_arm_trigger(ti);
+	}
+	spin_unlock(&zdev->lock);
+out_free:
+	kfree(zc);
+	kfree(op);
+	return err ? err : count;
+}
+
+/*
+ * zdev_read_snapshot
+ * it returns all attribute values of the device. Sysfs passes at most a
+ * page at a time, so each call builds only the records in its window.
+ */
+struct zio_snapshot_ctx {
+	char *buf;
+	loff_t off;
+	size_t count;
+	loff_t pos;		/* of the next record in the file */
+};
+
+static int __zsnap_wanted(struct zio_snapshot_ctx *ctx, size_t size)
+{
+	return ctx->pos + (loff_t)size > ctx->off &&
+		ctx->pos < ctx->off + (loff_t)ctx->count;
+}
+
+static void __zsnap_copy(struct zio_snapshot_ctx *ctx, void *rec, size_t size)
+{
+	loff_t start = max(ctx->pos, ctx->off);
+	loff_t end = min(ctx->pos + (loff_t)size,
+			 ctx->off + (loff_t)ctx->count);
+
+	if (start < end)
+		memcpy(ctx->buf + (start - ctx->off), rec + (start - ctx->pos),
+		       end - start);
+	ctx->pos += size;
+}
+
+static int __zsnap_obj(struct zio_snapshot_ctx *ctx, struct zio_obj_head *head,
+		       int obj, int cset, int chan)
+{
+	struct zio_attribute_set *zattr_set;
+	struct zio_snapshot_obj rec;
+	struct zio_attribute *zattr;
+	int i, j = 0, err;
+
+	if (!__zsnap_wanted(ctx, sizeof(rec))) {
+		ctx->pos += sizeof(rec);
+		return 0;
+	}
+	memset(&rec, 0, sizeof(rec));
+	rec.obj = obj;
+	rec.cset = cset;
+	rec.chan = chan;
+	zattr_set = zio_get_from_obj(head, zattr_set);
+	/* Extended ones by position in the set, as parameters have no index */
+	for (i = 0; i < zattr_set->n_std_attr + zattr_set->n_ext_attr; ++i) {
+		if (i < zattr_set->n_std_attr) {
+			zattr = &zattr_set->std_zattr[i];
+			if (zattr->index == ZIO_ATTR_INDEX_NONE)
+				continue; /* unused std attribute */
+		} else {
+			j = i - zattr_set->n_std_attr;
+			if (j >= ZIO_MAX_EXT_ATTR)
+				break;
+			zattr = &zattr_set->ext_zattr[j];
+		}
+		/* Same as zattr_show: the driver may know better */
+		if (zattr->s_op && zattr->s_op->info_get) {
+			err = zattr->s_op->info_get(&head->dev, zattr,
+						    &zattr->value);
+			if (err)
+				return err;
+		}
+		if (i < zattr_set->n_std_attr) {
+			rec.attr.std_mask |= (1 << i);
+			rec.attr.std_val[i] = zattr->value;
+		} else {
+			rec.attr.ext_mask |= (1 << j);
+			rec.attr.ext_val[j] = zattr->value;
+		}
+	}
+	__zsnap_copy(ctx, &rec, sizeof(rec));
+	return 0;
+}
+
+static int __zsnap_cset(struct zio_snapshot_ctx *ctx, struct zio_cset *cset)
+{
+	int i, err;
+
+	err = __zsnap_obj(ctx, &cset->head, ZIO_CONFIG_CSET, cset->index, 0);
+	if (!err)
+		err = __zsnap_obj(ctx, &cset->ti->head, ZIO_CONFIG_TRIG,
+				  cset->index, 0);
+	for (i = 0; !err && i < cset->n_chan; ++i) {
+		err = __zsnap_obj(ctx, &cset->chan[i].head, ZIO_CONFIG_CHAN,
+				  cset->index, i);
+		if (!err)
+			err = __zsnap_obj(ctx, &cset->chan[i].bi->head,
+					  ZIO_CONFIG_BUF, cset->index, i);
+	}
+	return err;
+}
+
+static ssize_t zdev_read_snapshot(struct file *file, struct kobject *kobj,
+				  struct bin_attribute *bin_attr,
+				  char *buf, loff_t off, size_t count)
+{
+	struct zio_snapshot_ctx ctx = {.buf = buf, .off = off};
+	struct zio_snapshot_header hdr;
+	struct zio_device *zdev;
+	int i, err = 0;
+
+	zdev = to_zio_dev(container_of(kobj, struct device, kobj));
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.version = ZIO_SNAPSHOT_VERSION;
+	hdr.objsize = sizeof(struct zio_snapshot_obj);
+	hdr.nobj = 1;
+	for (i = 0; i < zdev->n_cset; ++i)
+		hdr.nobj += 2 + 2 * zdev->cset[i].n_chan;
+	hdr.size = 2 * sizeof(hdr) + hdr.nobj * hdr.objsize;
+
+	if (off >= hdr.size)
+		return 0;
+	if (count > hdr.size - off)
+		count = hdr.size - off;
+	ctx.count = count;
+
+	spin_lock(&zdev->lock);
+	hdr.seq = zdev->config_seq;
+	__zsnap_copy(&ctx, &hdr, sizeof(hdr));
+	err = __zsnap_obj(&ctx, &zdev->head, ZIO_CONFIG_DEV, 0, 0);
+	for (i = 0; !err && i < zdev->n_cset; ++i)
+		err = __zsnap_cset(&ctx, &zdev->cset[i]);
+	__zsnap_copy(&ctx, &hdr, sizeof(hdr));
+	spin_unlock(&zdev->lock);
+
+	return err ? err : count;
+}
+
+struct bin_attribute zio_dev_bin_attr[] = {
+	[ZIO_BIN_CONFIG] = {
+		.attr = { .name = "config", .mode = ZIO_WO_PERM, },
+		.size = ZIO_CONFIG_MAX_ITEMS * sizeof(struct zio_config_item),
+		.write = zdev_store_config,
+	},
+	[ZIO_BIN_SNAPSHOT] = {
+		.attr = { .name = "snapshot", .mode = ZIO_RO_PERM, },
+		.size = 0, /* it depends on the device */
+		.read = zdev_read_snapshot,
+	},
+};
+
 struct bin_attribute zio_bin_attr[] = {
 	[ZIO_BIN_CTRL] = {
 		.attr = { .name = "current-control", .mode = ZIO_RO_PERM, },
@@ -938,6 +1493,12 @@ enum zio_default_attribute_numeration {
 	ZIO_DAN_ALAR,	/* alarms */
 	ZIO_DAN_DIRE,   /* direction */
 	ZIO_DAN_PREF,	/* prefer-new */
+	ZIO_DAN_ABUD,	/* arm-budget */
+	ZIO_DAN_ABNS,	/* arm-budget-ns */
+	ZIO_DAN_ACPU,	/* acq-cpu */
+	ZIO_DAN_APRI,	/* acq-prio */
+	ZIO_DAN_HIST,	/* history-chunk */
+	ZIO_DAN_ACTB,	/* active-blocks */
 };
 
 /* default zio attributes */
@@ -962,6 +1523,19 @@ static struct device_attribute zio_default_attributes[] = {
 				zio_show_dire, NULL),
 	[ZIO_DAN_PREF] = __ATTR(prefer-new, ZIO_RW_PERM,
 				zio_show_pref, zio_store_pref),
+	[ZIO_DAN_ABUD] = __ATTR(arm-budget, ZIO_RW_PERM,
+				zio_show_acq, zio_store_acq),
+	[ZIO_DAN_ABNS] = __ATTR(arm-budget-ns, ZIO_RW_PERM,
+				zio_show_acq, zio_store_acq),
+	[ZIO_DAN_ACPU] = __ATTR(acq-cpu, ZIO_RW_PERM,
+				zio_show_acq, zio_store_acq),
+	[ZIO_DAN_APRI] = __ATTR(acq-prio, ZIO_RW_PERM,
+				zio_show_acq, zio_store_acq),
+	[ZIO_DAN_HIST] = __ATTR(history-chunk, ZIO_RW_PERM,
+				zio_show_history, zio_store_history),
+	[ZIO_DAN_ACTB] = __ATTR(active-blocks, ZIO_RW_PERM,
+				zio_show_active_blocks,
+				zio_store_active_blocks),
 	__ATTR_NULL,
 };
 /* default attributes for most of the zio objects */
@@ -981,6 +1555,12 @@ static struct attribute *def_cset_attrs_ptr[] = {
 	&zio_default_attributes[ZIO_DAN_CTRI].attr,
 	&zio_default_attributes[ZIO_DAN_CBUF].attr,
 	&zio_default_attributes[ZIO_DAN_DIRE].attr,
+	&zio_default_attributes[ZIO_DAN_ABUD].attr,
+	&zio_default_attributes[ZIO_DAN_ABNS].attr,
+	&zio_default_attributes[ZIO_DAN_ACPU].attr,
+	&zio_default_attributes[ZIO_DAN_APRI].attr,
+	&zio_default_attributes[ZIO_DAN_HIST].attr,
+	&zio_default_attributes[ZIO_DAN_ACTB].attr,
 	NULL,
 };
 /* default attributes for channel */
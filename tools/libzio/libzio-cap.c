@@ -0,0 +1,546 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * The ZIO capture format: see libzio-cap.h
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "libzio-cap.h"
+
+#define CAP_ALIGN(x)	(((x) + 7) & ~(uint64_t)7)
+
+/*
+ * Writing
+ */
+static int cap_chunk(struct libzio_cap_writer *w, uint32_t type,
+		     uint32_t stream, const void *p1, size_t l1,
+		     const void *p2, size_t l2)
+{
+	static const char zeros[8];
+	struct zio_cap_chunk c = {type, stream, l1 + l2};
+	size_t pad = CAP_ALIGN(c.len) - c.len;
+
+	if (w->out(w->priv, &c, sizeof(c)) < 0 ||
+	    w->out(w->priv, p1, l1) < 0 ||
+	    (l2 && w->out(w->priv, p2, l2) < 0) ||
+	    (pad && w->out(w->priv, zeros, pad) < 0))
+		return -1;
+	w->offset += sizeof(c) + c.len + pad;
+	return 0;
+}
+
+static int cap_flush_index(struct libzio_cap_writer *w)
+{
+	struct zio_cap_index *index = w->index;
+	uint64_t offset = w->offset;
+
+	if (!index->n)
+		return 0;
+	index->prev = w->last_index;
+	if (cap_chunk(w, ZIO_CAP_INDEX, 0, index,
+		      sizeof(*index) + index->n * sizeof(index->e[0]),
+		      NULL, 0) < 0)
+		return -1;
+	w->last_index = offset;
+	index->n = 0;
+	return 0;
+}
+
+int libzio_cap_init(struct libzio_cap_writer *w, unsigned int period,
+		    int (*out)(void *priv, const void *buf, size_t len),
+		    void *priv)
+{
+	struct zio_cap_header h = {
+		.magic = ZIO_CAP_MAGIC,
+		.version = ZIO_CAP_VERSION,
+		.byteorder = ZIO_CAP_BYTEORDER,
+	};
+
+	memset(w, 0, sizeof(*w));
+	w->out = out;
+	w->priv = priv;
+	w->period = period ? period : 1;
+	w->index = calloc(1, sizeof(*w->index) +
+			  w->period * sizeof(w->index->e[0]));
+	if (!w->index)
+		return -1;
+	if (out(priv, &h, sizeof(h)) < 0)
+		return -1;
+	w->offset = sizeof(h);
+	return 0;
+}
+
+int libzio_cap_stream(struct libzio_cap_writer *w, uint32_t stream,
+		      const char *name)
+{
+	char buf[ZIO_CAP_NAMELEN] = {0,};
+
+	strncpy(buf, name, sizeof(buf) - 1);
+	w->nstreams++;
+	return cap_chunk(w, ZIO_CAP_STREAM, stream, buf, sizeof(buf),
+			 NULL, 0);
+}
+
+size_t libzio_cap_block_size(size_t datalen)
+{
+	return sizeof(struct zio_cap_chunk) +
+		CAP_ALIGN(sizeof(struct zio_control) + datalen);
+}
+
+int libzio_cap_block(struct libzio_cap_writer *w, uint32_t stream,
+		     const struct zio_control *ctrl, const void *data,
+		     size_t datalen)
+{
+	struct zio_cap_entry *e = w->index->e + w->index->n;
+
+	e->offset = w->offset;
+	e->len = sizeof(*ctrl) + datalen;
+	e->stream = stream;
+	e->seq_num = ctrl->seq_num;
+	e->secs = ctrl->tstamp.secs;
+	e->ticks = ctrl->tstamp.ticks;
+	if (cap_chunk(w, ZIO_CAP_BLOCK, stream, ctrl, sizeof(*ctrl),
+		      data, datalen) < 0)
+		return -1;
+	w->nblocks++;
+	if (++w->index->n == w->period)
+		return cap_flush_index(w);
+	return 0;
+}
+
+int libzio_cap_finish(struct libzio_cap_writer *w)
+{
+	struct zio_cap_footer f;
+	int ret = -1;
+
+	if (!w->index) /* not started, or already finished */
+		return -1;
+	if (cap_flush_index(w) < 0)
+		goto out;
+	f.last_index = w->last_index;
+	f.nblocks = w->nblocks;
+	f.nstreams = w->nstreams;
+	ret = cap_chunk(w, ZIO_CAP_FOOTER, 0, &f, sizeof(f), NULL, 0);
+out:
+	free(w->index);
+	w->index = NULL;
+	return ret;
+}
+
+/*
+ * Reading
+ */
+struct libzio_cap_stream {
+	uint32_t id;
+	char name[ZIO_CAP_NAMELEN];
+	struct zio_cap_entry *e;
+	long n, size;
+};
+
+struct libzio_cap {
+	int fd;
+	uint64_t size;
+	int indexed;
+	int nstreams;
+	struct libzio_cap_stream *s;
+};
+
+static int cap_pread(struct libzio_cap *cap, void *buf, size_t len,
+		     uint64_t offset)
+{
+	ssize_t i = pread(cap->fd, buf, len, offset);
+
+	if (i < 0)
+		return -1;
+	if (i != len) {
+		errno = EIO; /* truncated file */
+		return -1;
+	}
+	return 0;
+}
+
+static struct libzio_cap_stream *cap_stream(struct libzio_cap *cap,
+					    uint32_t id, int create)
+{
+	struct libzio_cap_stream *s;
+	int i;
+
+	for (i = 0; i < cap->nstreams; i++)
+		if (cap->s[i].id == id)
+			return cap->s + i;
+	if (!create) {
+		errno = ENOENT;
+		return NULL;
+	}
+	s = realloc(cap->s, (cap->nstreams + 1) * sizeof(*s));
+	if (!s)
+		return NULL;
+	cap->s = s;
+	s += cap->nstreams++;
+	memset(s, 0, sizeof(*s));
+	s->id = id;
+	snprintf(s->name, sizeof(s->name), "stream-%u", id);
+	return s;
+}
+
+static int cap_add_entry(struct libzio_cap *cap, const struct zio_cap_entry *e)
+{
+	struct libzio_cap_stream *s = cap_stream(cap, e->stream, 1);
+	struct zio_cap_entry *new;
+
+	if (!s)
+		return -1;
+	if (s->n == s->size) {
+		new = realloc(s->e, (s->size * 2 + 64) * sizeof(*new));
+		if (!new)
+			return -1;
+		s->e = new;
+		s->size = s->size * 2 + 64;
+	}
+	s->e[s->n++] = *e;
+	return 0;
+}
+
+static int cap_add_stream(struct libzio_cap *cap, struct zio_cap_chunk *c,
+			  uint64_t offset)
+{
+	struct libzio_cap_stream *s = cap_stream(cap, c->stream, 1);
+
+	if (!s)
+		return -1;
+	if (cap_pread(cap, s->name, sizeof(s->name), offset + sizeof(*c)) < 0)
+		return -1;
+	s->name[sizeof(s->name) - 1] = '\0';
+	return 0;
+}
+
+/* Without a footer: every chunk is looked at, up to a truncated one */
+static int cap_scan(struct libzio_cap *cap)
+{
+	struct zio_cap_chunk c;
+	struct zio_cap_entry e;
+	struct zio_control ctrl;
+	uint64_t offset = sizeof(struct zio_cap_header);
+
+	while (offset + sizeof(c) <= cap->size) {
+		if (cap_pread(cap, &c, sizeof(c), offset) < 0)
+			return -1;
+		if (offset + sizeof(c) + c.len > cap->size)
+			break;
+		switch (c.type) {
+		case ZIO_CAP_STREAM:
+			if (cap_add_stream(cap, &c, offset) < 0)
+				return -1;
+			break;
+		case ZIO_CAP_BLOCK:
+			if (c.len < sizeof(ctrl))
+				break;
+			if (cap_pread(cap, &ctrl, sizeof(ctrl),
+				      offset + sizeof(c)) < 0)
+				return -1;
+			e.offset = offset;
+			e.len = c.len;
+			e.stream = c.stream;
+			e.seq_num = ctrl.seq_num;
+			e.secs = ctrl.tstamp.secs;
+			e.ticks = ctrl.tstamp.ticks;
+			if (cap_add_entry(cap, &e) < 0)
+				return -1;
+			break;
+		}
+		offset += sizeof(c) + CAP_ALIGN(c.len);
+	}
+	return 0;
+}
+
+/* With a footer: the streams at the beginning, then the index chain */
+static int cap_load(struct libzio_cap *cap, struct zio_cap_footer *f)
+{
+	struct zio_cap_chunk c;
+	struct zio_cap_index index;
+	struct zio_cap_entry *e;
+	uint64_t *p, *chain = NULL, offset = sizeof(struct zio_cap_header);
+	long i, j, n = 0, size = 0;
+	int ret = -1;
+
+	while (offset + sizeof(c) <= cap->size) {
+		if (cap_pread(cap, &c, sizeof(c), offset) < 0)
+			return -1;
+		if (c.type != ZIO_CAP_STREAM)
+			break;
+		if (cap_add_stream(cap, &c, offset) < 0)
+			return -1;
+		offset += sizeof(c) + CAP_ALIGN(c.len);
+	}
+
+	for (offset = f->last_index; offset; offset = index.prev) {
+		if (n == size) {
+			size = size * 2 + 64;
+			p = realloc(chain, size * sizeof(*chain));
+			if (!p)
+				goto out;
+			chain = p;
+		}
+		chain[n++] = offset;
+		if (cap_pread(cap, &c, sizeof(c), offset) < 0 ||
+		    cap_pread(cap, &index, sizeof(index),
+			      offset + sizeof(c)) < 0)
+			goto out;
+		if (c.type != ZIO_CAP_INDEX || index.prev >= offset) {
+			errno = EPROTO;
+			goto out;
+		}
+	}
+
+	/* The chain goes backwards, the entries are wanted in file order */
+	for (i = n - 1; i >= 0; i--) {
+		if (cap_pread(cap, &index, sizeof(index),
+			      chain[i] + sizeof(c)) < 0)
+			goto out;
+		e = malloc(index.n * sizeof(*e));
+		if (!e)
+			goto out;
+		if (cap_pread(cap, e, index.n * sizeof(*e),
+			      chain[i] + sizeof(c) + sizeof(index)) < 0) {
+			free(e);
+			goto out;
+		}
+		for (j = 0; j < index.n; j++)
+			if (cap_add_entry(cap, e + j) < 0)
+				break;
+		free(e);
+		if (j < index.n)
+			goto out;
+	}
+	ret = 0;
+out:
+	free(chain);
+	return ret;
+}
+
+struct libzio_cap *libzio_cap_open(const char *path)
+{
+	struct {
+		struct zio_cap_chunk c;
+		struct zio_cap_footer f;
+	} tail;
+	struct zio_cap_header h;
+	struct libzio_cap *cap;
+	struct stat st;
+
+	cap = calloc(1, sizeof(*cap));
+	if (!cap)
+		return NULL;
+	cap->fd = open(path, O_RDONLY);
+	if (cap->fd < 0 || fstat(cap->fd, &st) < 0)
+		goto err;
+	cap->size = st.st_size;
+	if (cap_pread(cap, &h, sizeof(h), 0) < 0)
+		goto err;
+	if (memcmp(h.magic, ZIO_CAP_MAGIC, sizeof(h.magic)) ||
+	    h.version != ZIO_CAP_VERSION ||
+	    h.byteorder != ZIO_CAP_BYTEORDER) {
+		errno = EPROTO;
+		goto err;
+	}
+
+	if (cap->size >= sizeof(h) + sizeof(tail) &&
+	    cap_pread(cap, &tail, sizeof(tail),
+		      cap->size - sizeof(tail)) == 0 &&
+	    tail.c.type == ZIO_CAP_FOOTER && tail.c.len == sizeof(tail.f) &&
+	    tail.f.last_index < cap->size) {
+		cap->indexed = 1;
+		if (cap_load(cap, &tail.f) == 0)
+			return cap;
+		/* A bad index: forget what was loaded, and scan */
+		cap->indexed = 0;
+		while (cap->nstreams)
+			free(cap->s[--cap->nstreams].e);
+	}
+	if (cap_scan(cap) == 0)
+		return cap;
+err:
+	libzio_cap_close(cap);
+	return NULL;
+}
+
+void libzio_cap_close(struct libzio_cap *cap)
+{
+	int i, err = errno;
+
+	for (i = 0; i < cap->nstreams; i++)
+		free(cap->s[i].e);
+	free(cap->s);
+	if (cap->fd >= 0)
+		close(cap->fd);
+	free(cap);
+	errno = err;
+}
+
+int libzio_cap_indexed(struct libzio_cap *cap)
+{
+	return cap->indexed;
+}
+
+int libzio_cap_nstreams(struct libzio_cap *cap)
+{
+	return cap->nstreams;
+}
+
+const char *libzio_cap_name(struct libzio_cap *cap, uint32_t stream)
+{
+	struct libzio_cap_stream *s = cap_stream(cap, stream, 0);
+
+	return s ? s->name : NULL;
+}
+
+long libzio_cap_nblocks(struct libzio_cap *cap, uint32_t stream)
+{
+	struct libzio_cap_stream *s = cap_stream(cap, stream, 0);
+
+	return s ? s->n : -1;
+}
+
+const struct zio_cap_entry *libzio_cap_entry(struct libzio_cap *cap,
+					     uint32_t stream, long i)
+{
+	struct libzio_cap_stream *s = cap_stream(cap, stream, 0);
+
+	if (!s)
+		return NULL;
+	if (i < 0 || i >= s->n) {
+		errno = ERANGE;
+		return NULL;
+	}
+	return s->e + i;
+}
+
+/* Binary searches: the first entry not before the key */
+long libzio_cap_find_seq(struct libzio_cap *cap, uint32_t stream,
+			 uint32_t seq_num)
+{
+	struct libzio_cap_stream *s = cap_stream(cap, stream, 0);
+	long lo = 0, hi, mid;
+
+	if (!s)
+		return -1;
+	hi = s->n;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (s->e[mid].seq_num < seq_num)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == s->n) {
+		errno = ENOENT;
+		return -1;
+	}
+	return lo;
+}
+
+long libzio_cap_find_time(struct libzio_cap *cap, uint32_t stream,
+			  uint64_t secs, uint64_t ticks)
+{
+	struct libzio_cap_stream *s = cap_stream(cap, stream, 0);
+	struct zio_cap_entry *e;
+	long lo = 0, hi, mid;
+
+	if (!s)
+		return -1;
+	hi = s->n;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		e = s->e + mid;
+		if (e->secs < secs || (e->secs == secs && e->ticks < ticks))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == s->n) {
+		errno = ENOENT;
+		return -1;
+	}
+	return lo;
+}
+
+int libzio_cap_map(struct libzio_cap *cap, uint32_t stream, long i, long n,
+		   struct libzio_cap_range *r)
+{
+	struct libzio_cap_stream *s = cap_stream(cap, stream, 0);
+	uint64_t page = getpagesize(), end;
+
+	if (!s)
+		return -1;
+	if (i < 0 || n <= 0 || i + n > s->n) {
+		errno = ERANGE;
+		return -1;
+	}
+	r->start = s->e[i].offset & ~(page - 1);
+	end = s->e[i + n - 1].offset + sizeof(struct zio_cap_chunk) +
+		s->e[i + n - 1].len;
+	r->maplen = end - r->start;
+	r->map = mmap(NULL, r->maplen, PROT_READ, MAP_SHARED, cap->fd,
+		      r->start);
+	if (r->map == MAP_FAILED) {
+		r->map = NULL;
+		return -1;
+	}
+	return 0;
+}
+
+int libzio_cap_get(struct libzio_cap *cap, struct libzio_cap_range *r,
+		   uint32_t stream, long i, struct libzio_cap_block *b)
+{
+	const struct zio_cap_entry *e = libzio_cap_entry(cap, stream, i);
+	void *p;
+
+	if (!e)
+		return -1;
+	if (e->offset < r->start || e->offset + sizeof(struct zio_cap_chunk)
+	    + e->len > r->start + r->maplen) {
+		errno = ERANGE;
+		return -1;
+	}
+	p = r->map + (e->offset - r->start) + sizeof(struct zio_cap_chunk);
+	b->ctrl = p;
+	b->data = p + sizeof(*b->ctrl);
+	b->datalen = e->len - sizeof(*b->ctrl);
+	return 0;
+}
+
+void libzio_cap_unmap(struct libzio_cap_range *r)
+{
+	if (r->map)
+		munmap(r->map, r->maplen);
+	r->map = NULL;
+}
+
+long libzio_cap_read(struct libzio_cap *cap, uint32_t stream, long i,
+		     struct zio_control *ctrl, void *data, size_t len)
+{
+	const struct zio_cap_entry *e = libzio_cap_entry(cap, stream, i);
+	uint64_t offset;
+	size_t datalen;
+
+	if (!e)
+		return -1;
+	offset = e->offset + sizeof(struct zio_cap_chunk);
+	datalen = e->len - sizeof(*ctrl);
+	if (cap_pread(cap, ctrl, sizeof(*ctrl), offset) < 0)
+		return -1;
+	if (len > datalen)
+		len = datalen;
+	if (len && cap_pread(cap, data, len, offset + sizeof(*ctrl)) < 0)
+		return -1;
+	return datalen;
+}
@@ -0,0 +1,145 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * The ZIO capture format, as written by zio-record, and the functions to
+ * write and read it.
+ *
+ * A file is a header and a sequence of chunks, each of them aligned to 8
+ * bytes. "stream" chunks name the channels, "block" chunks carry a
+ * control and its data, "index" chunks list the blocks written since the
+ * previous index (and point back to it); a "footer" chunk closes the
+ * file and points to the last index. A reader finds all blocks by
+ * following the index chain from the footer, and then looks for a
+ * sequence number or a time with a binary search; a file without a
+ * footer (the recorder died) is read by scanning all chunks.
+ *
+ * Everything is in native byte order, as the control is; the header
+ * tells which one it is.
+ */
+#ifndef __LIBZIO_CAP_H__
+#define __LIBZIO_CAP_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/zio-user.h>
+
+#define ZIO_CAP_MAGIC		"ZIOCAP\0"
+#define ZIO_CAP_VERSION		1
+#define ZIO_CAP_BYTEORDER	0x01020304
+#define ZIO_CAP_NAMELEN		64
+
+struct zio_cap_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteorder;
+};
+
+enum zio_cap_type {
+	ZIO_CAP_STREAM = 1,	/* payload: the channel name */
+	ZIO_CAP_BLOCK,		/* payload: control and data */
+	ZIO_CAP_INDEX,		/* payload: zio_cap_index */
+	ZIO_CAP_FOOTER,		/* payload: zio_cap_footer */
+};
+
+struct zio_cap_chunk {
+	uint32_t type;
+	uint32_t stream;	/* for streams and blocks */
+	uint64_t len;		/* of the payload, before the padding */
+};
+
+struct zio_cap_entry {
+	uint64_t offset;	/* of the block chunk */
+	uint64_t len;		/* of its payload */
+	uint32_t stream;
+	uint32_t seq_num;
+	uint64_t secs;
+	uint64_t ticks;
+};
+
+struct zio_cap_index {
+	uint64_t prev;		/* the previous index chunk, 0 if none */
+	uint64_t n;
+	struct zio_cap_entry e[];
+};
+
+struct zio_cap_footer {
+	uint64_t last_index;	/* 0 if there is none */
+	uint64_t nblocks;
+	uint64_t nstreams;
+};
+
+/*
+ * Writing: chunks are passed to "out", in order. A file is started by
+ * init, the streams are added before their blocks, finish writes the
+ * last index and the footer. "period" is the number of blocks per index.
+ */
+struct libzio_cap_writer {
+	int (*out)(void *priv, const void *buf, size_t len);
+	void *priv;
+	uint64_t offset;
+	uint64_t last_index;
+	uint64_t nblocks, nstreams;
+	unsigned int period;
+	struct zio_cap_index *index;
+};
+
+extern int libzio_cap_init(struct libzio_cap_writer *w, unsigned int period,
+			   int (*out)(void *priv, const void *buf, size_t len),
+			   void *priv);
+extern int libzio_cap_stream(struct libzio_cap_writer *w, uint32_t stream,
+			     const char *name);
+extern int libzio_cap_block(struct libzio_cap_writer *w, uint32_t stream,
+			    const struct zio_control *ctrl, const void *data,
+			    size_t datalen);
+extern int libzio_cap_finish(struct libzio_cap_writer *w);
+
+/* The bytes that libzio_cap_block will write, to plan file sizes */
+extern size_t libzio_cap_block_size(size_t datalen);
+
+/*
+ * Reading. Blocks are numbered per stream, in file order, from 0; the
+ * find functions return the first one at or after the sequence number or
+ * time, or -1 with ENOENT.
+ */
+struct libzio_cap;
+
+struct libzio_cap_block {
+	const struct zio_control *ctrl;
+	const void *data;
+	size_t datalen;
+};
+
+/* Some blocks mapped from the file; valid until libzio_cap_unmap */
+struct libzio_cap_range {
+	void *map;
+	size_t maplen;
+	uint64_t start;		/* file offset of map */
+};
+
+extern struct libzio_cap *libzio_cap_open(const char *path);
+extern void libzio_cap_close(struct libzio_cap *cap);
+extern int libzio_cap_indexed(struct libzio_cap *cap); /* had a footer */
+
+extern int libzio_cap_nstreams(struct libzio_cap *cap);
+extern const char *libzio_cap_name(struct libzio_cap *cap, uint32_t stream);
+extern long libzio_cap_nblocks(struct libzio_cap *cap, uint32_t stream);
+extern const struct zio_cap_entry *libzio_cap_entry(struct libzio_cap *cap,
+						    uint32_t stream, long i);
+
+extern long libzio_cap_find_seq(struct libzio_cap *cap, uint32_t stream,
+				uint32_t seq_num);
+extern long libzio_cap_find_time(struct libzio_cap *cap, uint32_t stream,
+				 uint64_t secs, uint64_t ticks);
+
+/* Map blocks i to i + n - 1 of a stream; then get each of them */
+extern int libzio_cap_map(struct libzio_cap *cap, uint32_t stream, long i,
+			  long n, struct libzio_cap_range *r);
+extern int libzio_cap_get(struct libzio_cap *cap, struct libzio_cap_range *r,
+			  uint32_t stream, long i, struct libzio_cap_block *b);
+extern void libzio_cap_unmap(struct libzio_cap_range *r);
+
+/* Or copy one block: ctrl and up to "len" bytes of data; returns datalen */
+extern long libzio_cap_read(struct libzio_cap *cap, uint32_t stream, long i,
+			    struct zio_control *ctrl, void *data, size_t len);
+
+#endif /* __LIBZIO_CAP_H__ */
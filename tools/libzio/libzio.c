@@ -0,0 +1,521 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * libzio: see libzio.h. Nothing here is magic: it is what zio-dump and
+ * zio-cat-file do, with the fast path chosen by default.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <fnmatch.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+
+#include "libzio.h"
+
+struct libzio_chan {
+	struct libzio_desc desc;
+	int cfd, dfd;
+	int flags;
+	void *map;			/* the whole buffer, if it can be mapped */
+	size_t maplen;
+	void *copy;			/* for read(2), grown as needed */
+	size_t copylen;
+	int held;			/* the block is with the user */
+	struct libzio_block block;
+	struct libzio_set *set;		/* epoll re-arm on release */
+};
+
+struct libzio_set {
+	int epfd;
+	int n;
+};
+
+/* Read a short sysfs file, trailing newline removed */
+static int libzio_sysfs_read(const char *dir, const char *name,
+			     char *buf, size_t len)
+{
+	char path[PATH_MAX];
+	int fd, i;
+
+	if (snprintf(path, sizeof(path), "%s/%s", dir, name) >= sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	i = read(fd, buf, len - 1);
+	close(fd);
+	if (i < 0)
+		return -1;
+	while (i && (buf[i - 1] == '\n' || buf[i - 1] == ' '))
+		i--;
+	buf[i] = '\0';
+	return i;
+}
+
+int libzio_discover(const char *pattern, struct libzio_desc **list)
+{
+	struct libzio_desc *d, *res = NULL;
+	char buf[64];
+	glob_t g;
+	int i, n = 0;
+
+	*list = NULL;
+	switch (glob(LIBZIO_SYSFS "/*/cset*/chan*", GLOB_ONLYDIR, NULL, &g)) {
+	case 0:
+		break;
+	case GLOB_NOMATCH:
+		return 0;
+	default:
+		errno = ENOMEM;
+		return -1;
+	}
+	res = calloc(g.gl_pathc, sizeof(*res));
+	if (!res) {
+		globfree(&g);
+		return -1;
+	}
+	for (i = 0; i < g.gl_pathc; i++) {
+		d = res + n;
+		if (libzio_sysfs_read(g.gl_pathv[i], "devname", d->devname,
+				      sizeof(d->devname)) <= 0)
+			continue;
+		if (pattern && fnmatch(pattern, d->devname, 0))
+			continue;
+		strncpy(d->sysfs, g.gl_pathv[i], sizeof(d->sysfs) - 1);
+		if (libzio_sysfs_read(d->sysfs, "../direction", buf,
+				      sizeof(buf)) > 0)
+			d->output = !strcmp(buf, "output");
+		libzio_sysfs_read(d->sysfs, "../current_buffer", d->buffer,
+				  sizeof(d->buffer));
+		libzio_sysfs_read(d->sysfs, "../current_trigger", d->trigger,
+				  sizeof(d->trigger));
+		n++;
+	}
+	globfree(&g);
+	if (!n) {
+		free(res);
+		res = NULL;
+	}
+	*list = res;
+	return n;
+}
+
+/* The buffer can be mapped if it tells its size in kB (e.g. vmalloc) */
+static void libzio_map(struct libzio_chan *ch)
+{
+	uint32_t kb;
+
+	if (ch->desc.output || (ch->flags & LIBZIO_NOMAP))
+		return;
+	if (libzio_attr_get(ch, "buffer/max-buffer-kb", &kb) < 0 || !kb)
+		return;
+	ch->maplen = (size_t)kb * 1024;
+	ch->map = mmap(NULL, ch->maplen, PROT_READ, MAP_SHARED, ch->dfd, 0);
+	if (ch->map == MAP_FAILED) {
+		ch->map = NULL;
+		ch->maplen = 0;
+	}
+}
+
+struct libzio_chan *libzio_open(const char *devname, int flags)
+{
+	struct libzio_desc *list;
+	struct libzio_chan *ch;
+	char path[PATH_MAX];
+	int n, mode;
+
+	n = libzio_discover(devname, &list);
+	if (n < 0)
+		return NULL;
+	if (n != 1) {
+		free(list);
+		errno = n ? EINVAL : ENODEV;
+		return NULL;
+	}
+	ch = calloc(1, sizeof(*ch));
+	if (!ch) {
+		free(list);
+		return NULL;
+	}
+	ch->desc = list[0];
+	free(list);
+	ch->flags = flags;
+	ch->cfd = ch->dfd = -1;
+
+	mode = ch->desc.output ? O_WRONLY : O_RDONLY;
+	if (flags & LIBZIO_NONBLOCK)
+		mode |= O_NONBLOCK;
+	snprintf(path, sizeof(path), "%s/%s-ctrl", LIBZIO_DEVDIR,
+		 ch->desc.devname);
+	ch->cfd = open(path, mode);
+	snprintf(path, sizeof(path), "%s/%s-data", LIBZIO_DEVDIR,
+		 ch->desc.devname);
+	ch->dfd = open(path, mode);
+	if (ch->cfd < 0 || ch->dfd < 0) {
+		libzio_close(ch);
+		return NULL;
+	}
+	libzio_map(ch);
+	ch->block.chan = ch;
+	return ch;
+}
+
+void libzio_close(struct libzio_chan *ch)
+{
+	int err = errno;
+
+	if (ch->map)
+		munmap(ch->map, ch->maplen);
+	if (ch->cfd >= 0)
+		close(ch->cfd);
+	if (ch->dfd >= 0)
+		close(ch->dfd);
+	free(ch->copy);
+	free(ch);
+	errno = err; /* so it can be used on error paths */
+}
+
+int libzio_fd(struct libzio_chan *ch)
+{
+	return ch->cfd;
+}
+
+int libzio_is_mapped(struct libzio_chan *ch)
+{
+	return ch->map != NULL;
+}
+
+const char *libzio_name(struct libzio_chan *ch)
+{
+	return ch->desc.devname;
+}
+
+const char *libzio_trigger(struct libzio_chan *ch)
+{
+	return ch->desc.trigger;
+}
+
+/* Read exactly len bytes, or fail: zio never returns less in one block */
+static int libzio_read_full(int fd, void *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t i;
+
+	while (done < len) {
+		i = read(fd, buf + done, len - done);
+		if (i < 0 && errno == EINTR)
+			continue;
+		if (i < 0)
+			return -1;
+		if (i == 0) {
+			errno = EPIPE; /* end of run */
+			return -1;
+		}
+		done += i;
+	}
+	return 0;
+}
+
+static int libzio_copy(struct libzio_chan *ch, size_t len)
+{
+	void *p;
+
+	if (len > ch->copylen) {
+		p = realloc(ch->copy, len);
+		if (!p)
+			return -1;
+		ch->copy = p;
+		ch->copylen = len;
+	}
+	return libzio_read_full(ch->dfd, ch->copy, len);
+}
+
+int libzio_get(struct libzio_chan *ch, struct libzio_block **blk)
+{
+	struct libzio_block *b = &ch->block;
+	struct zio_control *ctrl = &b->ctrl;
+	ssize_t i;
+
+	if (ch->held || ch->desc.output) {
+		errno = ch->held ? EBUSY : EINVAL;
+		return -1;
+	}
+	i = read(ch->cfd, ctrl, sizeof(*ctrl));
+	if (i < 0)
+		return -1;
+	if (i != sizeof(*ctrl)) {
+		errno = i ? EIO : EPIPE;
+		return -1;
+	}
+	if (ctrl->major_version != __ZIO_MAJOR_VERSION) {
+		errno = EPROTO;
+		return -1;
+	}
+
+	b->datalen = (size_t)ctrl->ssize * ctrl->nsamples;
+	b->mapped = 0;
+	if (!b->datalen) {
+		b->data = NULL;
+	} else if (ch->map && ctrl->mem_offset + b->datalen <= ch->maplen) {
+		/* Zero copy; the block is freed at the next control read */
+		b->data = ch->map + ctrl->mem_offset;
+		b->mapped = 1;
+	} else {
+		if (libzio_copy(ch, b->datalen) < 0)
+			return -1;
+		b->data = ch->copy;
+	}
+	ch->held = 1;
+	*blk = b;
+	return 0;
+}
+
+void libzio_release(struct libzio_block *blk)
+{
+	struct libzio_chan *ch = blk->chan;
+	struct epoll_event ev = {EPOLLIN | EPOLLONESHOT, {.ptr = ch}};
+
+	ch->held = 0;
+	/* Polling the control would free a mapped block, so re-arm now */
+	if (ch->set)
+		epoll_ctl(ch->set->epfd, EPOLL_CTL_MOD, ch->cfd, &ev);
+}
+
+static int libzio_write_full(int fd, const void *buf, size_t len)
+{
+	size_t done = 0;
+	ssize_t i;
+
+	while (done < len) {
+		i = write(fd, buf + done, len - done);
+		if (i < 0 && errno == EINTR)
+			continue;
+		if (i < 0)
+			return -1;
+		done += i;
+	}
+	return 0;
+}
+
+int libzio_put(struct libzio_chan *ch, struct zio_control *ctrl,
+	       const void *data, size_t datalen)
+{
+	if (!ch->desc.output) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (ctrl && libzio_write_full(ch->cfd, ctrl, sizeof(*ctrl)) < 0)
+		return -1;
+	return libzio_write_full(ch->dfd, data, datalen);
+}
+
+int libzio_attr_get(struct libzio_chan *ch, const char *name, uint32_t *val)
+{
+	char buf[32], *rest;
+
+	if (libzio_sysfs_read(ch->desc.sysfs, name, buf, sizeof(buf)) < 0)
+		return -1;
+	*val = strtoul(buf, &rest, 0);
+	if (rest == buf) {
+		errno = EINVAL;
+		return -1;
+	}
+	return 0;
+}
+
+int libzio_attr_set(struct libzio_chan *ch, const char *name, uint32_t val)
+{
+	char path[PATH_MAX], buf[16];
+	int fd, i, len;
+
+	if (snprintf(path, sizeof(path), "%s/%s", ch->desc.sysfs, name) >=
+	    sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	len = sprintf(buf, "%u\n", val);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	i = write(fd, buf, len);
+	close(fd);
+	return i == len ? 0 : -1;
+}
+
+int libzio_config(struct libzio_chan *ch, const struct zio_config_item *items,
+		  int n)
+{
+	char path[PATH_MAX];
+	int fd, i;
+
+	/* Sysfs would silently cut the write to its size: refuse instead */
+	if (n > ZIO_CONFIG_MAX_ITEMS) {
+		errno = E2BIG;
+		return -1;
+	}
+	if (snprintf(path, sizeof(path), "%s/../../config", ch->desc.sysfs) >=
+	    sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -1;
+	/* One write: the kernel applies all items or none */
+	i = write(fd, items, n * sizeof(*items));
+	close(fd);
+	return i == n * sizeof(*items) ? 0 : -1;
+}
+
+struct zio_snapshot_header *libzio_snapshot(struct libzio_chan *ch)
+{
+	struct zio_snapshot_header hdr, *snap = NULL, *trailer;
+	char path[PATH_MAX];
+	int fd, retry;
+	void *p;
+	ssize_t i;
+	size_t done;
+
+	if (snprintf(path, sizeof(path), "%s/../../snapshot", ch->desc.sysfs)
+	    >= sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return NULL;
+	}
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return NULL;
+	/* The kernel returns a page at a time: retry if it changed meanwhile */
+	for (retry = 0; retry < 10; retry++) {
+		if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr))
+			goto err;
+		if (hdr.version != ZIO_SNAPSHOT_VERSION ||
+		    hdr.size < 2 * sizeof(hdr)) {
+			errno = EPROTO;
+			goto err;
+		}
+		p = realloc(snap, hdr.size);
+		if (!p)
+			goto err;
+		snap = p;
+		for (done = 0; done < hdr.size; done += i) {
+			i = pread(fd, (char *)snap + done, hdr.size - done,
+				  done);
+			if (i < 0)
+				goto err;
+			if (i == 0)
+				break;
+		}
+		if (done < hdr.size)
+			continue; /* the device changed shape? */
+		trailer = (void *)((char *)snap + hdr.size - sizeof(hdr));
+		if (snap->size == hdr.size && snap->seq == trailer->seq) {
+			close(fd);
+			return snap;
+		}
+	}
+	errno = EAGAIN;
+err:
+	free(snap);
+	close(fd);
+	return NULL;
+}
+
+int libzio_ctrl_get(struct libzio_chan *ch, struct zio_control *ctrl)
+{
+	char path[PATH_MAX];
+	int fd, i;
+
+	if (snprintf(path, sizeof(path), "%s/current-control",
+		     ch->desc.sysfs) >= sizeof(path)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -1;
+	i = read(fd, ctrl, sizeof(*ctrl));
+	close(fd);
+	if (i < 0)
+		return -1;
+	if (i != sizeof(*ctrl)) {
+		errno = EIO;
+		return -1;
+	}
+	return 0;
+}
+
+struct libzio_set *libzio_set_create(void)
+{
+	struct libzio_set *set = calloc(1, sizeof(*set));
+
+	if (!set)
+		return NULL;
+	set->epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (set->epfd < 0) {
+		free(set);
+		return NULL;
+	}
+	return set;
+}
+
+void libzio_set_destroy(struct libzio_set *set)
+{
+	close(set->epfd);
+	free(set);
+}
+
+/* One-shot: a channel is not polled while its block is held */
+int libzio_set_add(struct libzio_set *set, struct libzio_chan *ch)
+{
+	struct epoll_event ev = {EPOLLIN | EPOLLONESHOT, {.ptr = ch}};
+
+	if (ch->set || ch->desc.output) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (epoll_ctl(set->epfd, EPOLL_CTL_ADD, ch->cfd, &ev) < 0)
+		return -1;
+	ch->set = set;
+	set->n++;
+	return 0;
+}
+
+int libzio_wait(struct libzio_set *set, struct libzio_block **blks, int n,
+		int timeout)
+{
+	struct epoll_event ev[64];
+	struct epoll_event rearm = {EPOLLIN | EPOLLONESHOT};
+	struct libzio_chan *ch;
+	int i, nev, ret = 0;
+
+	if (n > 64)
+		n = 64;
+	do {
+		nev = epoll_wait(set->epfd, ev, n, timeout);
+	} while (nev < 0 && errno == EINTR);
+	if (nev < 0)
+		return -1;
+	for (i = 0; i < nev; i++) {
+		ch = ev[i].data.ptr;
+		if (libzio_get(ch, blks + ret) == 0) {
+			ret++;
+			continue;
+		}
+		/* Nothing after all (or end of run): listen again */
+		if (errno == EAGAIN) {
+			rearm.data.ptr = ch;
+			epoll_ctl(set->epfd, EPOLL_CTL_MOD, ch->cfd, &rearm);
+		}
+	}
+	return ret;
+}
@@ -0,0 +1,105 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * libzio: what every ZIO program does, done once. Channels are found
+ * through sysfs, the data device is memory-mapped when the buffer allows
+ * it (so a block is a view at ctrl.mem_offset, without a copy), and many
+ * channels are waited for with a single epoll set.
+ *
+ * Functions return 0 (or a count) on success, -1 with errno on error.
+ */
+#ifndef __LIBZIO_H__
+#define __LIBZIO_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+#include <linux/zio-user.h>
+
+#ifndef LIBZIO_SYSFS
+#define LIBZIO_SYSFS	"/sys/bus/zio/devices"
+#endif
+#ifndef LIBZIO_DEVDIR
+#define LIBZIO_DEVDIR	"/dev/zio"
+#endif
+
+/* A channel, as found in sysfs; devname is "<dev>-<cset>-<chan>" */
+struct libzio_desc {
+	char devname[ZIO_OBJ_NAME_FULL_LEN + 16];
+	char sysfs[PATH_MAX];		/* the channel directory */
+	int output;			/* direction of the cset */
+	char buffer[ZIO_OBJ_NAME_LEN + 1]; /* current buffer type */
+	char trigger[ZIO_OBJ_NAME_LEN + 1]; /* current trigger type */
+};
+
+/* Channels whose devname matches the glob (NULL is all); free() the list */
+extern int libzio_discover(const char *pattern, struct libzio_desc **list);
+
+struct libzio_chan;
+
+/*
+ * A block of an input channel. Data is in the map, or in a private
+ * buffer of the channel if the buffer type can't be mapped; in both cases
+ * it is valid until libzio_release(). One block per channel is held at a
+ * time, as the kernel frees it when the next control is read.
+ */
+struct libzio_block {
+	struct zio_control ctrl;
+	void *data;
+	size_t datalen;
+	int mapped;			/* data is a view of the buffer */
+	struct libzio_chan *chan;
+};
+
+/* Open flags: LIBZIO_NOMAP forces read(2); LIBZIO_NONBLOCK never waits */
+#define LIBZIO_NOMAP	0x1
+#define LIBZIO_NONBLOCK	0x2
+
+extern struct libzio_chan *libzio_open(const char *devname, int flags);
+extern void libzio_close(struct libzio_chan *ch);
+extern int libzio_fd(struct libzio_chan *ch);	/* the control device */
+extern int libzio_is_mapped(struct libzio_chan *ch);
+extern const char *libzio_name(struct libzio_chan *ch);
+extern const char *libzio_trigger(struct libzio_chan *ch);
+
+/* Input: get the next block (EAGAIN if non-blocking and none), release */
+extern int libzio_get(struct libzio_chan *ch, struct libzio_block **blk);
+extern void libzio_release(struct libzio_block *blk);
+
+/* Output: write a control (NULL to keep the current one), then data */
+extern int libzio_put(struct libzio_chan *ch, struct zio_control *ctrl,
+		      const void *data, size_t datalen);
+
+/* Attributes, relative to the channel directory (e.g. "../trigger/...") */
+extern int libzio_attr_get(struct libzio_chan *ch, const char *name,
+			   uint32_t *val);
+extern int libzio_attr_set(struct libzio_chan *ch, const char *name,
+			   uint32_t val);
+
+/* Many attributes of the device of the channel, as a whole (see zio-user.h) */
+extern int libzio_config(struct libzio_chan *ch,
+			 const struct zio_config_item *items, int n);
+
+/*
+ * All attribute values of the device of the channel, read consistently
+ * (see zio-user.h): header and records, in a buffer to be freed
+ */
+extern struct zio_snapshot_header *libzio_snapshot(struct libzio_chan *ch);
+
+/* The current control of the channel (for output: the last block played) */
+extern int libzio_ctrl_get(struct libzio_chan *ch, struct zio_control *ctrl);
+
+/*
+ * A set of input channels waited for with epoll. libzio_wait returns at
+ * most "n" blocks, one per ready channel, from a single epoll_wait; the
+ * caller releases each of them. The timeout is in ms, -1 is forever.
+ */
+struct libzio_set;
+
+extern struct libzio_set *libzio_set_create(void);
+extern void libzio_set_destroy(struct libzio_set *set);
+extern int libzio_set_add(struct libzio_set *set, struct libzio_chan *ch);
+extern int libzio_wait(struct libzio_set *set, struct libzio_block **blks,
+		       int n, int timeout);
+
+#endif /* __LIBZIO_H__ */
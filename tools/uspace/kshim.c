@@ -0,0 +1,402 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * What the shims can't make inline: globals, the bits of core.c and
+ * objects.c the data path needs, and a builder for the objects. Object
+ * creation mirrors __cset_register, __ti_create and __bi_create, minus
+ * sysfs, char devices and the device model.
+ */
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+
+#include "zio-uspace.h"
+
+int kshim_verbose;
+unsigned long kshim_fail_mask, kshim_alloc_count;
+unsigned long jiffies;
+
+const uint32_t zio_version = ZIO_VERSION(__ZIO_MAJOR_VERSION,
+					 __ZIO_MINOR_VERSION,
+					 __ZIO_PATCH_VERSION);
+
+/* The buffers point to it, but there is no file to operate on */
+const struct file_operations zio_generic_file_operations;
+
+/* Same as in sysfs.c: history.c and helpers.c only need them linked */
+const char zio_trig_attr_names[_ZIO_TRG_ATTR_STD_NUM][ZIO_NAME_LEN] = {
+	[ZIO_ATTR_TRIG_N_SHOTS]		= "nshots",
+	[ZIO_ATTR_TRIG_PRE_SAMP]	= "pre-samples",
+	[ZIO_ATTR_TRIG_POST_SAMP]	= "post-samples",
+	[ZIO_ATTR_TRIG_VERSION]		= "version",
+};
+const char zio_zbuf_attr_names[_ZIO_BUF_ATTR_STD_NUM][ZIO_NAME_LEN] = {
+	[ZIO_ATTR_ZBUF_MAXLEN]		= "max-buffer-len",
+	[ZIO_ATTR_ZBUF_MAXKB]		= "max-buffer-kb",
+	[ZIO_ATTR_ZBUF_ALLOC_LEN]	= "allocated-buffer-len",
+	[ZIO_ATTR_ZBUF_ALLOC_KB]	= "allocated-buffer-kb",
+	[ZIO_ATTR_ZBUF_VERSION]		= "version",
+};
+
+/* As in core.c, but from malloc, so the fuzzer can fail it as well */
+struct zio_control *zio_alloc_control(gfp_t gfp)
+{
+	struct zio_control *ctrl;
+
+	ctrl = kzalloc(sizeof(*ctrl), gfp);
+	if (!ctrl)
+		return NULL;
+
+	ctrl->major_version = zio_version_major(zio_version);
+	ctrl->minor_version = zio_version_minor(zio_version);
+	if (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+		ctrl->flags |= ZIO_CONTROL_BIG_ENDIAN;
+	else
+		ctrl->flags |= ZIO_CONTROL_LITTLE_ENDIAN;
+	return ctrl;
+}
+
+void zio_free_control(struct zio_control *ctrl)
+{
+	kfree(ctrl);
+}
+
+/*
+ * Registration: a small table instead of the lists in zio_status.
+ * The checks are the ones of objects.c, so a bad buffer fails here too.
+ */
+#define KSHIM_MAX_TYPES 8
+static struct zio_buffer_type *kshim_bufs[KSHIM_MAX_TYPES];
+static struct zio_trigger_type *kshim_trigs[KSHIM_MAX_TYPES];
+
+static int kshim_register(struct zio_obj_head **table, struct zio_obj_head *head,
+			  const char *name)
+{
+	int i, free = -1;
+
+	for (i = 0; i < KSHIM_MAX_TYPES; i++) {
+		if (!table[i]) {
+			if (free < 0)
+				free = i;
+			continue;
+		}
+		if (!strncmp(table[i]->name, name, ZIO_OBJ_NAME_LEN))
+			return -EBUSY;
+	}
+	if (free < 0)
+		return -ENOMEM;
+	strncpy(head->name, name, ZIO_OBJ_NAME_LEN);
+	table[free] = head;
+	return 0;
+}
+
+static void kshim_unregister(struct zio_obj_head **table,
+			     struct zio_obj_head *head)
+{
+	int i;
+
+	for (i = 0; i < KSHIM_MAX_TYPES; i++)
+		if (table[i] == head)
+			table[i] = NULL;
+}
+
+static struct zio_obj_head *kshim_find(struct zio_obj_head **table,
+				       const char *name)
+{
+	int i;
+
+	for (i = 0; i < KSHIM_MAX_TYPES; i++)
+		if (table[i] && !strncmp(table[i]->name, name, ZIO_OBJ_NAME_LEN))
+			return table[i];
+	return NULL;
+}
+
+int zio_register_buf(struct zio_buffer_type *zbuf, const char *name)
+{
+	int err;
+
+	if (!zbuf || !zbuf->f_op)
+		return -EINVAL;
+	err = kshim_register((struct zio_obj_head **)kshim_bufs, &zbuf->head,
+			     name);
+	if (err)
+		return err;
+	zbuf->head.zobj_type = ZIO_BUF;
+	if (zbuf->zattr_set.std_zattr)
+		zbuf->zattr_set.n_std_attr = _ZIO_BUF_ATTR_STD_NUM;
+	INIT_LIST_HEAD(&zbuf->list);
+	spin_lock_init(&zbuf->lock);
+	return 0;
+}
+
+void zio_unregister_buf(struct zio_buffer_type *zbuf)
+{
+	kshim_unregister((struct zio_obj_head **)kshim_bufs, &zbuf->head);
+}
+
+int zio_register_trig(struct zio_trigger_type *trig, const char *name)
+{
+	struct zio_attribute *zattr;
+	int err;
+
+	if (!trig)
+		return -EINVAL;
+	zattr = trig->zattr_set.std_zattr;
+	if (!zattr || !(zattr[ZIO_ATTR_TRIG_POST_SAMP].attr.attr.mode ||
+			zattr[ZIO_ATTR_TRIG_PRE_SAMP].attr.attr.mode))
+		return -EINVAL;
+	err = kshim_register((struct zio_obj_head **)kshim_trigs, &trig->head,
+			     name);
+	if (err)
+		return err;
+	trig->head.zobj_type = ZIO_TRG;
+	trig->zattr_set.n_std_attr = _ZIO_TRG_ATTR_STD_NUM;
+	INIT_LIST_HEAD(&trig->list);
+	spin_lock_init(&trig->lock);
+	return 0;
+}
+
+void zio_unregister_trig(struct zio_trigger_type *trig)
+{
+	kshim_unregister((struct zio_obj_head **)kshim_trigs, &trig->head);
+}
+
+/* The head is the first field, so the tables can be searched as heads */
+struct zio_buffer_type *kshim_find_buf(const char *name)
+{
+	return (void *)kshim_find((struct zio_obj_head **)kshim_bufs, name);
+}
+
+struct zio_trigger_type *kshim_find_trig(const char *name)
+{
+	return (void *)kshim_find((struct zio_obj_head **)kshim_trigs, name);
+}
+
+extern int zio_default_buffer_init(void);
+extern void zio_default_buffer_exit(void);
+extern int zio_default_trigger_init(void);
+extern void zio_default_trigger_exit(void);
+
+int kshim_init(void)
+{
+	int err;
+
+	err = zio_default_buffer_init();
+	if (err)
+		return err;
+	err = zio_default_trigger_init();
+	if (err)
+		zio_default_buffer_exit();
+	return err;
+}
+
+void kshim_exit(void)
+{
+	zio_default_trigger_exit();
+	zio_default_buffer_exit();
+}
+
+/*
+ * Objects. Instances get their own copy of the standard attributes, as
+ * zio_create_attributes does, because the values are per instance
+ */
+static struct zio_attribute *kshim_attr_clone(const struct zio_attribute *src,
+					      unsigned int n)
+{
+	struct zio_attribute *dst;
+
+	if (!src)
+		return NULL;
+	dst = kmalloc(n * sizeof(*dst), GFP_KERNEL);
+	if (dst)
+		memcpy(dst, src, n * sizeof(*dst));
+	return dst;
+}
+
+static struct zio_device kshim_zdev = {
+	.head = {.name = "uspace"},
+};
+
+static void kshim_chan_destroy(struct zio_channel *chan)
+{
+	struct zio_bi *bi = chan->bi;
+	struct zio_attribute *zattr;
+
+	if (bi) {
+		zio_buffer_free_block(bi, chan->active_block);
+		zio_set_active_block(chan, NULL);
+		zattr = bi->zattr_set.std_zattr;
+		bi->b_op->destroy(bi);
+		kfree(zattr);
+	}
+	if (chan->current_ctrl)
+		zio_free_control(chan->current_ctrl);
+}
+
+static int kshim_chan_create(struct zio_channel *chan,
+			     struct zio_buffer_type *zbuf)
+{
+	struct zio_cset *cset = chan->cset;
+	const char *devname = cset->zdev->head.name;
+	struct zio_control *ctrl;
+	struct zio_attribute *zattr;
+	struct zio_bi *bi;
+	char name[ZIO_NAME_LEN];
+
+	if (snprintf(name, sizeof(name), "%s-%s-%d-%d", zbuf->head.name,
+		     devname, cset->index, chan->index) >= sizeof(name))
+		return -ENAMETOOLONG;
+	ctrl = zio_alloc_control(GFP_KERNEL);
+	if (!ctrl)
+		return -ENOMEM;
+	ctrl->seq_num = 1;
+	ctrl->nsamples = cset->ti->nsamples;
+	ctrl->addr.cset = cset->index;
+	ctrl->addr.chan = chan->index;
+	/* Like strncpy: the control is zeroed, and the field may be full */
+	memcpy(ctrl->addr.devname, devname,
+	       strnlen(devname, sizeof(ctrl->addr.devname)));
+	ctrl->ssize = cset->ssize;
+	chan->current_ctrl = ctrl;
+	mutex_init(&chan->user_lock);
+
+	zattr = kshim_attr_clone(zbuf->zattr_set.std_zattr,
+				 _ZIO_BUF_ATTR_STD_NUM);
+	if (!zattr)
+		return -ENOMEM;
+	spin_lock(&zbuf->lock);
+	bi = zbuf->b_op->create(zbuf, chan);
+	spin_unlock(&zbuf->lock);
+	if (IS_ERR(bi)) {
+		kfree(zattr);
+		return PTR_ERR(bi);
+	}
+	spin_lock_init(&bi->lock);
+	atomic_set(&bi->use_count, 0);
+	bi->b_op = zbuf->b_op;
+	bi->f_op = zbuf->f_op;
+	bi->v_op = zbuf->v_op;
+	bi->flags |= (chan->flags & ZIO_DIR);
+	bi->chan = chan;
+	bi->cset = cset;
+	bi->zattr_set.std_zattr = zattr;
+	bi->zattr_set.n_std_attr = _ZIO_BUF_ATTR_STD_NUM;
+	bi->head.zobj_type = ZIO_BI;
+	strcpy(bi->head.name, name);
+	chan->bi = bi;
+	return 0;
+}
+
+static int kshim_ti_create(struct zio_cset *cset, unsigned int nsamples)
+{
+	struct zio_trigger_type *trig = cset->trig;
+	struct zio_attribute *zattr;
+	struct zio_ti *ti;
+	char name[ZIO_NAME_LEN];
+
+	if (snprintf(name, sizeof(name), "%s-%s-%d", trig->head.name,
+		     cset->zdev->head.name, cset->index) >= sizeof(name))
+		return -ENAMETOOLONG;
+	zattr = kshim_attr_clone(trig->zattr_set.std_zattr,
+				 _ZIO_TRG_ATTR_STD_NUM);
+	if (!zattr)
+		return -ENOMEM;
+	spin_lock(&trig->lock);
+	ti = trig->t_op->create(trig, cset, NULL, 0);
+	spin_unlock(&trig->lock);
+	if (IS_ERR(ti)) {
+		kfree(zattr);
+		return PTR_ERR(ti);
+	}
+	spin_lock_init(&ti->lock);
+	ti->t_op = trig->t_op;
+	ti->flags |= cset->flags & ZIO_DIR;
+	ti->flags &= ~ZIO_DISABLED; /* as zio_change_current_trigger does */
+	ti->head.zobj_type = ZIO_TI;
+	strcpy(ti->head.name, name);
+	zattr[ZIO_ATTR_TRIG_PRE_SAMP].value = 0;
+	zattr[ZIO_ATTR_TRIG_POST_SAMP].value = nsamples;
+	ti->zattr_set.std_zattr = zattr;
+	ti->zattr_set.n_std_attr = _ZIO_TRG_ATTR_STD_NUM;
+	ti->nsamples = nsamples; /* __ctrl_update_nsamples, no interleave */
+	cset->ti = ti;
+	return 0;
+}
+
+struct zio_cset *kshim_cset_create(const char *zbuf_name, unsigned int nchan,
+				   unsigned int ssize, unsigned int nsamples,
+				   int (*raw_io)(struct zio_cset *cset))
+{
+	struct zio_buffer_type *zbuf = kshim_find_buf(zbuf_name);
+	struct zio_trigger_type *trig = kshim_find_trig("user");
+	struct zio_cset *cset;
+	int i, err;
+
+	if (!zbuf || !trig || !nchan || !raw_io)
+		return ERR_PTR(-EINVAL);
+	cset = kzalloc(sizeof(*cset), GFP_KERNEL);
+	if (!cset)
+		return ERR_PTR(-ENOMEM);
+	cset->chan = kcalloc(nchan, sizeof(*cset->chan), GFP_KERNEL);
+	cset->chan_enabled = kcalloc(BITS_TO_LONGS(nchan), sizeof(long),
+				     GFP_KERNEL);
+	if (!cset->chan || !cset->chan_enabled) {
+		kfree(cset->chan_enabled);
+		kfree(cset->chan);
+		kfree(cset);
+		return ERR_PTR(-ENOMEM);
+	}
+	strncpy(cset->head.name, "uspace-cset", ZIO_NAME_LEN);
+	cset->head.zobj_type = ZIO_CSET;
+	cset->zdev = &kshim_zdev;
+	cset->zbuf = zbuf;
+	cset->trig = trig;
+	cset->raw_io = raw_io;
+	cset->ssize = ssize;
+	cset->n_chan = nchan;
+	cset->flags = ZIO_DIR_INPUT | ZIO_CSET_TYPE_ANALOG;
+	cset->active_blocks = 1;
+	atomic_set(&cset->n_chan_ready, 0);
+	spin_lock_init(&cset->lock);
+	INIT_LIST_HEAD(&cset->list_done);
+
+	err = kshim_ti_create(cset, nsamples);
+	if (err)
+		goto out;
+	for (i = 0; i < nchan; i++) {
+		struct zio_channel *chan = &cset->chan[i];
+
+		chan->cset = cset;
+		chan->ti = cset->ti;
+		chan->index = i;
+		chan->flags = cset->flags & ZIO_DIR;
+		err = kshim_chan_create(chan, zbuf);
+		if (err)
+			goto out;
+		/* All enabled, no block yet: what __zio_chan_sync_enabled does */
+		set_bit(i, cset->chan_enabled);
+		cset->n_chan_enabled++;
+	}
+	return cset;
+
+out:
+	kshim_cset_destroy(cset);
+	return ERR_PTR(err);
+}
+
+void kshim_cset_destroy(struct zio_cset *cset)
+{
+	struct zio_attribute *zattr;
+	int i;
+
+	for (i = 0; i < cset->n_chan; i++)
+		kshim_chan_destroy(&cset->chan[i]);
+	if (cset->ti) {
+		zattr = cset->ti->zattr_set.std_zattr;
+		cset->ti->t_op->destroy(cset->ti);
+		kfree(zattr);
+	}
+	kfree(cset->chan_enabled);
+	kfree(cset->chan);
+	kfree(cset);
+}
@@ -0,0 +1,567 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * Thin user-space shims for the kernel API used by misc.c, helpers.c,
+ * history.c and the buffers, so they compile unchanged in a process.
+ * Every <linux/...> and <asm/...> header in include/ here includes this
+ * file. Only what those files use is provided, and with the same
+ * semantics where it matters to them: spinlocks are real (so producer
+ * and consumer threads can be run), sleeping and waking are no-ops,
+ * work items run at once.
+ */
+#ifndef __ZIO_KSHIM_H__
+#define __ZIO_KSHIM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* Types */
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef unsigned int gfp_t;
+typedef unsigned int fmode_t;
+typedef int64_t ktime_t;
+typedef struct { int counter; } atomic_t;
+
+/* Compiler and generic macros */
+#define __init
+#define __exit
+#define __user
+#define __iomem
+#define __percpu
+#define __weak			__attribute__((weak))
+#define __must_check		__attribute__((warn_unused_result))
+#define likely(x)		__builtin_expect(!!(x), 1)
+#define unlikely(x)		__builtin_expect(!!(x), 0)
+#define ACCESS_ONCE(x)		(*(volatile typeof(x) *)&(x))
+#define barrier()		__asm__ __volatile__("" : : : "memory")
+#define smp_mb()		__sync_synchronize()
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof((a)[0]))
+#define BUILD_BUG_ON(c)		((void)sizeof(char[1 - 2 * !!(c)]))
+#define BUG_ON(c)		do { if (c) abort(); } while (0)
+#define WARN_ON(c)		({ int __c = !!(c); if (__c) \
+		fprintf(stderr, "WARN_ON at %s:%i\n", __FILE__, __LINE__); \
+		__c; })
+#define WARN(c, fmt...)		({ int __c = !!(c); \
+		(void)(__c && fprintf(stderr, fmt)); __c; })
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+#define min_t(t, a, b)		min((t)(a), (t)(b))
+#define max_t(t, a, b)		max((t)(a), (t)(b))
+#define swap(a, b) \
+	do { typeof(a) __tmp = (a); (a) = (b); (b) = __tmp; } while (0)
+#define ALIGN(x, a)		(((x) + (a) - 1) & ~((typeof(x))(a) - 1))
+#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
+#define PAGE_SHIFT		12
+#define PAGE_SIZE		(1UL << PAGE_SHIFT)
+#define NSEC_PER_USEC		1000L
+#define NSEC_PER_SEC		1000000000L
+
+/* Errors in pointers */
+#define MAX_ERRNO		4095
+#define IS_ERR_VALUE(x)		((unsigned long)(x) >= (unsigned long)-MAX_ERRNO)
+static inline void *ERR_PTR(long error) { return (void *)error; }
+static inline long PTR_ERR(const void *ptr) { return (long)ptr; }
+static inline int IS_ERR(const void *ptr) { return IS_ERR_VALUE(ptr); }
+static inline int IS_ERR_OR_NULL(const void *ptr)
+{
+	return !ptr || IS_ERR_VALUE(ptr);
+}
+
+/* Printing */
+extern int kshim_verbose;
+#define KERN_ERR		""
+#define KERN_INFO		""
+#define printk(fmt...)		(kshim_verbose ? printf(fmt) : 0)
+#define pr_err(fmt...)		fprintf(stderr, fmt)
+#define pr_warn(fmt...)		fprintf(stderr, fmt)
+#define pr_info(fmt...)		printk(fmt)
+#define pr_debug(fmt...)	do {} while (0)
+#define dev_err(dev, fmt...)	fprintf(stderr, fmt)
+#define dev_warn(dev, fmt...)	fprintf(stderr, fmt)
+#define dev_info(dev, fmt...)	printk(fmt)
+#define dev_dbg(dev, fmt...)	do {} while (0)
+
+/* Modules */
+struct module { int unused; };
+#define THIS_MODULE		((struct module *)0)
+#define EXPORT_SYMBOL(s)
+#define EXPORT_SYMBOL_GPL(s)
+#define MODULE_VERSION(v)
+#define MODULE_LICENSE(l)
+#define MODULE_AUTHOR(a)
+#define MODULE_DESCRIPTION(d)
+#define ADDITIONAL_VERSIONS
+#define module_param_named(name, var, type, perm)
+#define module_param(var, type, perm)
+#define MODULE_PARM_DESC(var, desc)
+#define try_module_get(m)	1
+#define module_put(m)		do {} while (0)
+/* Buffers register themselves at startup, like at insmod time */
+#define module_init(fn) \
+	static void __attribute__((constructor)) __kshim_init_##fn(void) \
+	{ fn(); }
+#define module_exit(fn) \
+	static void __attribute__((destructor)) __kshim_exit_##fn(void) \
+	{ fn(); }
+
+/* Atomics */
+#define atomic_read(a)		__atomic_load_n(&(a)->counter, __ATOMIC_SEQ_CST)
+#define atomic_set(a, v)	__atomic_store_n(&(a)->counter, v, __ATOMIC_SEQ_CST)
+#define atomic_inc(a)		__atomic_add_fetch(&(a)->counter, 1, __ATOMIC_SEQ_CST)
+#define atomic_dec(a)		__atomic_sub_fetch(&(a)->counter, 1, __ATOMIC_SEQ_CST)
+#define atomic_add(i, a)	__atomic_add_fetch(&(a)->counter, i, __ATOMIC_SEQ_CST)
+#define atomic_inc_return(a)	atomic_inc(a)
+#define atomic_dec_return(a)	atomic_dec(a)
+#define atomic_dec_and_test(a)	(atomic_dec(a) == 0)
+#define ATOMIC_INIT(v)		{ (v) }
+
+/* Bit operations */
+#define BITS_PER_LONG		(8 * sizeof(long))
+#define BIT_WORD(nr)		((nr) / BITS_PER_LONG)
+#define BIT_MASK(nr)		(1UL << ((nr) % BITS_PER_LONG))
+#define BITS_TO_LONGS(n)	DIV_ROUND_UP(n, BITS_PER_LONG)
+#define DECLARE_BITMAP(name, bits) unsigned long name[BITS_TO_LONGS(bits)]
+static inline void set_bit(int nr, volatile unsigned long *addr)
+{
+	__atomic_or_fetch(addr + BIT_WORD(nr), BIT_MASK(nr), __ATOMIC_SEQ_CST);
+}
+static inline void clear_bit(int nr, volatile unsigned long *addr)
+{
+	__atomic_and_fetch(addr + BIT_WORD(nr), ~BIT_MASK(nr),
+			   __ATOMIC_SEQ_CST);
+}
+static inline int test_bit(int nr, const volatile unsigned long *addr)
+{
+	return 1UL & (addr[BIT_WORD(nr)] >> (nr % BITS_PER_LONG));
+}
+static inline int test_and_clear_bit(int nr, volatile unsigned long *addr)
+{
+	return !!(__atomic_fetch_and(addr + BIT_WORD(nr), ~BIT_MASK(nr),
+				     __ATOMIC_SEQ_CST) & BIT_MASK(nr));
+}
+static inline int test_and_set_bit(int nr, volatile unsigned long *addr)
+{
+	return !!(__atomic_fetch_or(addr + BIT_WORD(nr), BIT_MASK(nr),
+				    __ATOMIC_SEQ_CST) & BIT_MASK(nr));
+}
+static inline int fls(unsigned int x)
+{
+	return x ? 32 - __builtin_clz(x) : 0;
+}
+static inline int fls64(uint64_t x)
+{
+	return x ? 64 - __builtin_clzll(x) : 0;
+}
+static inline unsigned long find_next_bit(const unsigned long *addr,
+					  unsigned long size,
+					  unsigned long offset)
+{
+	for (; offset < size; offset++)
+		if (test_bit(offset, addr))
+			return offset;
+	return size;
+}
+#define find_first_bit(addr, size) find_next_bit(addr, size, 0)
+#define for_each_set_bit(bit, addr, size) \
+	for ((bit) = find_first_bit((addr), (size)); (bit) < (size); \
+	     (bit) = find_next_bit((addr), (size), (bit) + 1))
+
+/* Math */
+static inline uint64_t div_u64(uint64_t a, uint32_t b) { return a / b; }
+static inline uint64_t div64_u64(uint64_t a, uint64_t b) { return a / b; }
+static inline int64_t div_s64(int64_t a, int32_t b) { return a / b; }
+#define do_div(n, base) ({ uint32_t __rem = (n) % (base); \
+		(n) /= (base); __rem; })
+
+/* Lists */
+struct list_head {
+	struct list_head *next, *prev;
+};
+#define LIST_HEAD_INIT(name)	{ &(name), &(name) }
+#define LIST_HEAD(name)		struct list_head name = LIST_HEAD_INIT(name)
+static inline void INIT_LIST_HEAD(struct list_head *list)
+{
+	list->next = list;
+	list->prev = list;
+}
+static inline void __list_add(struct list_head *new, struct list_head *prev,
+			      struct list_head *next)
+{
+	next->prev = new;
+	new->next = next;
+	new->prev = prev;
+	prev->next = new;
+}
+static inline void list_add(struct list_head *new, struct list_head *head)
+{
+	__list_add(new, head, head->next);
+}
+static inline void list_add_tail(struct list_head *new,
+				 struct list_head *head)
+{
+	__list_add(new, head->prev, head);
+}
+static inline void __list_del(struct list_head *prev, struct list_head *next)
+{
+	next->prev = prev;
+	prev->next = next;
+}
+static inline void list_del(struct list_head *entry)
+{
+	__list_del(entry->prev, entry->next);
+	entry->next = NULL;
+	entry->prev = NULL;
+}
+static inline void list_del_init(struct list_head *entry)
+{
+	__list_del(entry->prev, entry->next);
+	INIT_LIST_HEAD(entry);
+}
+static inline void list_move_tail(struct list_head *list,
+				  struct list_head *head)
+{
+	__list_del(list->prev, list->next);
+	list_add_tail(list, head);
+}
+static inline int list_empty(const struct list_head *head)
+{
+	return head->next == head;
+}
+static inline void list_splice_init(struct list_head *list,
+				    struct list_head *head)
+{
+	if (list_empty(list))
+		return;
+	list->next->prev = head;
+	list->prev->next = head->next;
+	head->next->prev = list->prev;
+	head->next = list->next;
+	INIT_LIST_HEAD(list);
+}
+#define list_entry(ptr, type, member) container_of(ptr, type, member)
+#define list_first_entry(ptr, type, member) \
+	list_entry((ptr)->next, type, member)
+#define list_for_each(pos, head) \
+	for (pos = (head)->next; pos != (head); pos = pos->next)
+#define list_for_each_safe(pos, n, head) \
+	for (pos = (head)->next, n = pos->next; pos != (head); \
+	     pos = n, n = pos->next)
+#define list_for_each_entry(pos, head, member) \
+	for (pos = list_entry((head)->next, typeof(*pos), member); \
+	     &pos->member != (head); \
+	     pos = list_entry(pos->member.next, typeof(*pos), member))
+#define list_for_each_entry_safe(pos, n, head, member) \
+	for (pos = list_entry((head)->next, typeof(*pos), member), \
+	     n = list_entry(pos->member.next, typeof(*pos), member); \
+	     &pos->member != (head); \
+	     pos = n, n = list_entry(n->member.next, typeof(*n), member))
+
+/* Spinlocks and mutexes: real, so that threads can be used */
+typedef struct { int v; } spinlock_t;
+#define __SPIN_LOCK_UNLOCKED(name)	{ 0 }
+#define DEFINE_SPINLOCK(name)		spinlock_t name = { 0 }
+#define spin_lock_init(l)		((l)->v = 0)
+static inline void spin_lock(spinlock_t *l)
+{
+	while (__atomic_exchange_n(&l->v, 1, __ATOMIC_ACQUIRE))
+		while (__atomic_load_n(&l->v, __ATOMIC_RELAXED))
+			;
+}
+static inline void spin_unlock(spinlock_t *l)
+{
+	__atomic_store_n(&l->v, 0, __ATOMIC_RELEASE);
+}
+#define spin_lock_nested(l, sub)	spin_lock(l)
+#define spin_lock_irqsave(l, f)		do { (f) = 0; spin_lock(l); } while (0)
+#define spin_unlock_irqrestore(l, f)	do { (void)(f); spin_unlock(l); } while (0)
+#define spin_lock_irq(l)		spin_lock(l)
+#define spin_unlock_irq(l)		spin_unlock(l)
+#define spin_lock_bh(l)			spin_lock(l)
+#define spin_unlock_bh(l)		spin_unlock(l)
+#define local_irq_save(f)		((f) = 0)
+#define local_irq_restore(f)		((void)(f))
+#define in_atomic()			0
+#define in_interrupt()			0
+
+struct mutex { spinlock_t l; };
+#define DEFINE_MUTEX(name)		struct mutex name = { { 0 } }
+#define mutex_init(m)			spin_lock_init(&(m)->l)
+#define mutex_lock(m)			spin_lock(&(m)->l)
+#define mutex_unlock(m)			spin_unlock(&(m)->l)
+
+/* Memory */
+#define GFP_KERNEL		0
+#define GFP_ATOMIC		1
+#define __GFP_ZERO		0x100
+extern unsigned long kshim_fail_mask, kshim_alloc_count;
+/* A fuzzer may fail allocations on purpose: bit n fails allocation n */
+static inline int kshim_alloc_fails(void)
+{
+	unsigned long n;
+
+	if (likely(!kshim_fail_mask)) /* threads may allocate concurrently */
+		return 0;
+	n = kshim_alloc_count++;
+	return n < BITS_PER_LONG && (kshim_fail_mask & (1UL << n));
+}
+static inline void *kmalloc(size_t size, gfp_t gfp)
+{
+	if (kshim_alloc_fails())
+		return NULL;
+	return (gfp & __GFP_ZERO) ? calloc(1, size) : malloc(size);
+}
+#define kzalloc(size, gfp)	kmalloc(size, (gfp) | __GFP_ZERO)
+#define kcalloc(n, size, gfp)	kzalloc((n) * (size), gfp)
+#define kfree(p)		free((void *)(p))
+#define vmalloc(size)		kmalloc(size, GFP_KERNEL)
+#define vzalloc(size)		kzalloc(size, GFP_KERNEL)
+#define vmalloc_user(size)	kzalloc(size, GFP_KERNEL)
+#define vfree(p)		free(p)
+
+struct kmem_cache { size_t size; };
+static inline struct kmem_cache *kmem_cache_create(const char *name,
+		size_t size, size_t align, unsigned long flags, void *ctor)
+{
+	struct kmem_cache *c = malloc(sizeof(*c));
+
+	if (c)
+		c->size = size;
+	return c;
+}
+#define kmem_cache_destroy(c)		free(c)
+#define kmem_cache_alloc(c, gfp)	kmalloc((c)->size, gfp)
+#define kmem_cache_zalloc(c, gfp)	kzalloc((c)->size, gfp)
+#define kmem_cache_free(c, p)		free(p)
+#define KMEM_CACHE(s, flags) \
+	kmem_cache_create(#s, sizeof(struct s), __alignof__(struct s), 0, NULL)
+
+/* Time */
+struct timespec_shim { long tv_sec, tv_nsec; };
+static inline ktime_t ktime_get(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+static inline ktime_t ktime_get_real(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return (int64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+#define ktime_to_ns(t)		((int64_t)(t))
+#define ns_to_ktime(ns)		((ktime_t)(ns))
+#define ktime_sub(a, b)		((a) - (b))
+#define ktime_add(a, b)		((a) + (b))
+#define ktime_add_ns(a, ns)	((a) + (ns))
+#define ktime_compare(a, b)	((a) < (b) ? -1 : (a) > (b))
+static inline void getnstimeofday(struct timespec *ts)
+{
+	clock_gettime(CLOCK_REALTIME, ts);
+}
+static inline struct timespec ktime_to_timespec(ktime_t t)
+{
+	struct timespec ts = { t / NSEC_PER_SEC, t % NSEC_PER_SEC };
+
+	return ts;
+}
+#define timespec_to_ktime(ts) \
+	((ktime_t)(ts).tv_sec * NSEC_PER_SEC + (ts).tv_nsec)
+extern unsigned long jiffies;
+#define HZ			100
+#define msecs_to_jiffies(ms)	((ms) / 10)
+#define msleep(ms)		do {} while (0)
+#define udelay(us)		do {} while (0)
+#define ndelay(ns)		do {} while (0)
+
+/* Scheduling: there is no sleeping, so waking is a no-op too */
+struct task_struct { int unused; };
+struct wait_queue_head_shim { int unused; };
+typedef struct wait_queue_head_shim wait_queue_head_t;
+/* Functions, not empty macros, so the argument is still evaluated */
+static inline void init_waitqueue_head(wait_queue_head_t *q) {}
+static inline void wake_up(wait_queue_head_t *q) {}
+static inline void wake_up_all(wait_queue_head_t *q) {}
+static inline void wake_up_interruptible(wait_queue_head_t *q) {}
+static inline void wake_up_interruptible_all(wait_queue_head_t *q) {}
+static inline int wake_up_process(struct task_struct *t) { return 0; }
+#define schedule()			sched_yield()
+#define cond_resched()			do {} while (0)
+#define need_resched()			0
+#define set_current_state(s)		do {} while (0)
+#define __set_current_state(s)		do {} while (0)
+#define signal_pending(t)		0
+#define TASK_RUNNING			0
+#define TASK_INTERRUPTIBLE		1
+#define TASK_UNINTERRUPTIBLE		2
+#define MAX_RT_PRIO			100
+#define MAX_USER_RT_PRIO		100
+#define SCHED_NORMAL			SCHED_OTHER
+static inline int kshim_setscheduler(struct task_struct *t, int policy,
+				     const struct sched_param *param)
+{
+	return 0;
+}
+#define sched_setscheduler(t, p, s)	kshim_setscheduler(t, p, s)
+#define current				((struct task_struct *)0)
+
+/* Kernel threads are not run: the acquisition thread is not simulated */
+#define kthread_should_stop()		1
+#define kthread_create(fn, data, fmt...) \
+	((void)(fn), (struct task_struct *)ERR_PTR(-ENOSYS))
+#define kthread_create_on_node(fn, data, node, fmt...) \
+	kthread_create(fn, data, fmt)
+#define kthread_run(fn, data, fmt...)	kthread_create(fn, data, fmt)
+#define kthread_bind(t, cpu)		do {} while (0)
+static inline int kthread_stop(struct task_struct *t) { return 0; }
+
+/* CPUs */
+#define NR_CPUS				1
+#define nr_cpu_ids			1
+#define num_online_cpus()		1
+#define cpu_online(cpu)			((cpu) == 0)
+#define cpu_possible(cpu)		((cpu) == 0)
+#define cpu_possible_mask		((void *)0)
+#define cpumask_of(cpu)			((void *)0)
+static inline int set_cpus_allowed_ptr(struct task_struct *t,
+				       const void *mask)
+{
+	return 0;
+}
+#define smp_processor_id()		0
+#define raw_smp_processor_id()		0
+#define get_cpu()			0
+#define put_cpu()			do {} while (0)
+#define for_each_possible_cpu(cpu)	for ((cpu) = 0; (cpu) < 1; (cpu)++)
+#define for_each_online_cpu(cpu)	for_each_possible_cpu(cpu)
+#define DEFINE_PER_CPU(type, name)	type name
+#define per_cpu(var, cpu)		(*((void)(cpu), &(var)))
+#define per_cpu_ptr(ptr, cpu)		(ptr)
+#define this_cpu_ptr(ptr)		(ptr)
+#define __get_cpu_var(var)		(var)
+#define get_cpu_var(var)		(var)
+#define put_cpu_var(var)		do {} while (0)
+#define preempt_disable()		do {} while (0)
+#define preempt_enable()		do {} while (0)
+
+/* Work queues: work runs at once, in the caller's context */
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+struct work_struct { work_func_t func; };
+struct workqueue_struct { int unused; };
+#define INIT_WORK(w, f)			((w)->func = (f))
+#define alloc_workqueue(fmt, flags, max, args...) \
+	((struct workqueue_struct *)malloc(sizeof(struct workqueue_struct)))
+#define create_workqueue(name)		alloc_workqueue(name, 0, 0)
+#define destroy_workqueue(wq)		free(wq)
+#define flush_workqueue(wq)		do {} while (0)
+#define WQ_HIGHPRI			0
+#define WQ_MEM_RECLAIM			0
+#define WQ_CPU_INTENSIVE		0
+static inline int queue_work_on(int cpu, struct workqueue_struct *wq,
+				struct work_struct *work)
+{
+	work->func(work);
+	return 1;
+}
+#define queue_work(wq, work)		queue_work_on(0, wq, work)
+#define schedule_work(work)		queue_work_on(0, NULL, work)
+#define cancel_work_sync(work)		0
+#define flush_work(work)		do {} while (0)
+
+/* Devices and sysfs: only the types are needed */
+#define S_IRUGO				(S_IRUSR | S_IRGRP | S_IROTH)
+#define S_IWUGO				(S_IWUSR | S_IWGRP | S_IWOTH)
+struct kobject { const char *name; };
+struct attribute { const char *name; unsigned short mode; };
+struct device_attribute {
+	struct attribute attr;
+	void *show, *store;
+};
+struct attribute_group {
+	const char *name;
+	struct attribute **attrs;
+	struct bin_attribute **bin_attrs;
+};
+struct bin_attribute { struct attribute attr; size_t size; void *private; };
+struct device_type { const char *name; };
+struct device {
+	struct kobject kobj;
+	struct device *parent;
+	struct device_type *type;
+	const struct attribute_group **groups;
+	void (*release)(struct device *dev);
+	void *driver_data;
+	struct bus_type *bus;
+	dev_t devt;
+};
+struct device_driver {
+	const char *name;
+	struct module *owner;
+	void *bus;
+};
+struct bus_type { const char *name; };
+struct cdev { int unused; };
+#define dev_name(dev)			"uspace"
+#define dev_set_name(dev, fmt...)	0
+#define get_device(dev)			(dev)
+#define put_device(dev)			do {} while (0)
+
+/* Files and memory maps */
+struct inode { int unused; };
+struct file {
+	void *private_data;
+	unsigned int f_flags;
+	struct inode *f_inode;
+};
+struct poll_table_struct;
+struct file_operations {
+	struct module *owner;
+	void *open, *release, *read, *write, *poll, *mmap, *llseek;
+};
+struct page { int unused; };
+struct vm_area_struct {
+	unsigned long vm_start, vm_end, vm_pgoff, vm_flags;
+	struct file *vm_file;
+	void *vm_private_data;
+	const struct vm_operations_struct *vm_ops;
+};
+struct vm_fault {
+	unsigned long pgoff;
+	void *virtual_address;
+	struct page *page;
+};
+struct vm_operations_struct {
+	void (*open)(struct vm_area_struct *vma);
+	void (*close)(struct vm_area_struct *vma);
+	int (*fault)(struct vm_area_struct *vma, struct vm_fault *vmf);
+};
+#define VM_FAULT_SIGBUS			0x0002
+#define VM_FAULT_NOPAGE			0x0100
+#define vmalloc_to_page(addr)		((struct page *)(addr))
+#define get_page(page)			do {} while (0)
+
+/* Versions */
+#define KERNEL_VERSION(a, b, c)		(((a) << 16) + ((b) << 8) + (c))
+#define LINUX_VERSION_CODE		KERNEL_VERSION(3, 2, 0)
+
+#endif /* __ZIO_KSHIM_H__ */
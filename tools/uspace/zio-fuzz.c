@@ -0,0 +1,172 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * Fuzz target for the zio-core data path, built from the kernel sources
+ * through the shims. The input is a configuration and a sequence of
+ * operations (arm, read, abort, resize the buffer, allocate and free in
+ * the ffa); allocation failures are injected as selected by the input.
+ * Built with clang -fsanitize=fuzzer it is a libFuzzer target; otherwise
+ * main() runs it on the files named on the command line (or stdin), to
+ * reproduce a crash under gdb or valgrind.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "zio-uspace.h"
+
+#define FUZZ_NFFA 16
+
+struct fuzz_input {
+	const uint8_t *data;
+	size_t size;
+};
+
+static uint8_t fuzz_byte(struct fuzz_input *in)
+{
+	if (!in->size)
+		return 0;
+	in->size--;
+	return *in->data++;
+}
+
+/* Half of the calls complete the fake I/O later, as a real device does */
+static int fuzz_async;
+
+static int fuzz_raw_io(struct zio_cset *cset)
+{
+	fuzz_async = !fuzz_async;
+	return fuzz_async ? -EAGAIN : 0;
+}
+
+static void fuzz_read(struct zio_cset *cset, unsigned int i)
+{
+	struct zio_bi *bi = cset->chan[i % cset->n_chan].bi;
+	struct zio_block *block;
+
+	block = zio_buffer_retr_block(bi);
+	if (block)
+		zio_buffer_free_block(bi, block);
+}
+
+static void fuzz_ops(struct zio_cset *cset, struct fuzz_input *in)
+{
+	unsigned long addr[FUZZ_NFFA] = {0,};
+	size_t size[FUZZ_NFFA] = {0,}; /* 0 is unused, as addr 0 is valid */
+	struct zio_ffa *ffa;
+	unsigned long flags;
+	uint8_t op, arg;
+	int i;
+
+	ffa = zio_ffa_create(0, 4096);
+	while (in->size) {
+		op = fuzz_byte(in);
+		arg = fuzz_byte(in);
+		switch (op % 8) {
+		case 0: /* a software trigger event */
+			zio_arm_trigger(cset->ti);
+			break;
+		case 1: /* the hardware completes, if it was started */
+			if (cset->ti->flags & ZIO_TI_ARMED)
+				zio_trigger_data_done(cset);
+			break;
+		case 2:
+			fuzz_read(cset, arg);
+			break;
+		case 3: /* disable and enable, as from sysfs */
+			zio_trigger_abort_disable(cset, arg & 1);
+			if (arg & 1)
+				cset->ti->flags &= ~ZIO_DISABLED;
+			break;
+		case 4: /* the buffer length, including 0 */
+			for (i = 0; i < cset->n_chan; i++)
+				cset->chan[i].bi->zattr_set.std_zattr
+					[ZIO_ATTR_ZBUF_MAXLEN].value = arg % 8;
+			break;
+		case 5: /* a channel goes on or off */
+			i = arg % cset->n_chan;
+			spin_lock_irqsave(&cset->lock, flags);
+			if (!(cset->ti->flags & ZIO_TI_ARMED))
+				cset->chan[i].flags ^= ZIO_DISABLED;
+			spin_unlock_irqrestore(&cset->lock, flags);
+			break;
+		case 6:
+			if (!ffa)
+				break;
+			i = arg % FUZZ_NFFA;
+			if (size[i] && addr[i] != ZIO_FFA_NOSPACE)
+				zio_ffa_free_s(ffa, addr[i], size[i]);
+			size[i] = (arg >> 4) * 64 + 1;
+			addr[i] = zio_ffa_alloc(ffa, size[i], GFP_ATOMIC);
+			break;
+		case 7:
+			kshim_alloc_count = 0; /* fail again the next ones */
+			break;
+		}
+	}
+	/* Leave nothing behind: the blocks held in the buffers are freed */
+	zio_trigger_abort_disable(cset, 0);
+	for (i = 0; i < cset->n_chan; i++)
+		cset->chan[i].flags &= ~ZIO_DISABLED;
+	if (ffa) {
+		for (i = 0; i < FUZZ_NFFA; i++)
+			if (size[i] && addr[i] != ZIO_FFA_NOSPACE)
+				zio_ffa_free_s(ffa, addr[i], size[i]);
+		zio_ffa_destroy(ffa);
+	}
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static int initialized;
+	struct fuzz_input in = {data, size};
+	struct zio_cset *cset;
+	unsigned int cfg, nchan, nsamples;
+
+	if (!initialized) {
+		if (kshim_init())
+			abort();
+		initialized = 1;
+	}
+	cfg = fuzz_byte(&in);
+	nchan = 1 + (cfg & 3);
+	nsamples = 1 + fuzz_byte(&in);
+	fuzz_async = 0;
+
+	kshim_fail_mask = fuzz_byte(&in);
+	kshim_fail_mask |= fuzz_byte(&in) << 8;
+	kshim_alloc_count = 0;
+	cset = kshim_cset_create(cfg & 4 ? "vmalloc" : "kmalloc", nchan,
+				 1 << ((cfg >> 3) & 3), nsamples, fuzz_raw_io);
+	if (!IS_ERR(cset)) {
+		fuzz_ops(cset, &in);
+		kshim_cset_destroy(cset);
+	}
+	kshim_fail_mask = 0;
+	return 0;
+}
+
+#ifndef ZIO_LIBFUZZER
+int main(int argc, char **argv)
+{
+	static uint8_t buf[64 * 1024];
+	size_t size;
+	FILE *f;
+	int i;
+
+	for (i = 1; i < argc || i == 1; i++) {
+		f = argc > 1 ? fopen(argv[i], "r") : stdin;
+		if (!f) {
+			fprintf(stderr, "%s: %s: %s\n", argv[0], argv[i],
+				strerror(errno));
+			exit(1);
+		}
+		size = fread(buf, 1, sizeof(buf), f);
+		if (f != stdin)
+			fclose(f);
+		LLVMFuzzerTestOneInput(buf, size);
+	}
+	return 0;
+}
+#endif
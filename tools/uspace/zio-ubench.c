@@ -0,0 +1,267 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * Micro-benchmark of the zio-core data path, run in user space: the
+ * allocator in misc.c, the buffers and the arm/data_done cycle of
+ * helpers.c, as compiled from the kernel sources through the shims.
+ * Numbers are not those of the kernel, but changes to the code show up
+ * here without loading modules, and a profiler can be used as usual.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "zio-uspace.h"
+
+static char git_version[] = "version: " GIT_VERSION;
+
+static char *bench_buf = "kmalloc";
+static unsigned int bench_nchan = 1, bench_nsamples = 16, bench_ssize = 2;
+static unsigned long bench_count = 100000;
+static int bench_verbose;
+
+static void help(char *name)
+{
+	fprintf(stderr, "%s: Wrong number of arguments\n"
+		"Use:    \"%s [<opts>] ffa|buffer|trigger|threads\"\n",
+		name, name);
+	fprintf(stderr,
+		"       -b <buffer>  default: \"kmalloc\" (or \"vmalloc\")\n"
+		"       -c <nchan>   default: 1\n"
+		"       -s <samples> default: 16 (per block)\n"
+		"       -z <ssize>   default: 2 (bytes per sample)\n"
+		"       -n <number>  default: 100000 (iterations)\n"
+		"       -v           increase verbosity\n"
+		"       -V           print version information\n");
+	exit(1);
+}
+
+static void print_version(char *pname)
+{
+	printf("%s %s\n", pname, git_version);
+}
+
+static void bench_report(char *name, unsigned long n, ktime_t t)
+{
+	printf("%-8s %-8s chan %3u block %7u bytes: %9lu in %6lli us, "
+	       "%6lli ns each\n", name, bench_buf, bench_nchan,
+	       bench_nsamples * bench_ssize, n,
+	       (long long)ktime_to_ns(t) / 1000,
+	       n ? (long long)ktime_to_ns(t) / n : 0LL);
+}
+
+/* The fake hardware completes at once; raw_io counts the events */
+static atomic_t bench_events;
+
+static int bench_raw_io(struct zio_cset *cset)
+{
+	struct zio_channel *chan;
+
+	chan_for_each(chan, cset)
+		if (chan->active_block)
+			*(uint8_t *)chan->active_block->data = 0xaa;
+	atomic_inc(&bench_events);
+	return 0;
+}
+
+/* The allocator of the vmalloc buffer: a window of live allocations */
+static int bench_ffa(void)
+{
+	unsigned long addr[64], size = bench_nsamples * bench_ssize;
+	struct zio_ffa *ffa;
+	ktime_t t;
+	int i, j;
+
+	ffa = zio_ffa_create(0, 64 * 2 * size);
+	if (!ffa)
+		return -ENOMEM;
+	for (j = 0; j < ARRAY_SIZE(addr); j++)
+		addr[j] = zio_ffa_alloc(ffa, size, GFP_ATOMIC);
+	t = ktime_get();
+	for (i = 0; i < bench_count; i++) {
+		j = (i * 37) % ARRAY_SIZE(addr); /* free out of order */
+		zio_ffa_free_s(ffa, addr[j], size);
+		addr[j] = zio_ffa_alloc(ffa, size, GFP_ATOMIC);
+	}
+	t = ktime_sub(ktime_get(), t);
+	bench_report("ffa", bench_count, t);
+	zio_ffa_destroy(ffa);
+	return 0;
+}
+
+/* One block through the buffer operations, without the trigger */
+static int bench_buffer(struct zio_cset *cset)
+{
+	struct zio_bi *bi = cset->chan[0].bi;
+	size_t datalen = bench_nsamples * bench_ssize;
+	struct zio_block *block;
+	ktime_t t;
+	int i;
+
+	t = ktime_get();
+	for (i = 0; i < bench_count; i++) {
+		block = bi->b_op->alloc_block(bi, datalen, GFP_ATOMIC);
+		if (!block)
+			return -ENOMEM;
+		bi->b_op->store_block(bi, block);
+		block = bi->b_op->retr_block(bi);
+		if (!block)
+			return -ENODATA;
+		bi->b_op->free_block(bi, block);
+	}
+	t = ktime_sub(ktime_get(), t);
+	bench_report("buffer", bench_count, t);
+	return 0;
+}
+
+static unsigned long bench_drain(struct zio_cset *cset)
+{
+	struct zio_block *block;
+	unsigned long n = 0;
+	int i;
+
+	for (i = 0; i < cset->n_chan; i++) {
+		/* Like read(2): retr from an empty buffer pulls, i.e. arms */
+		block = cset->chan[i].bi->b_op->retr_block(cset->chan[i].bi);
+		if (!block)
+			continue;
+		zio_buffer_free_block(cset->chan[i].bi, block);
+		n++;
+	}
+	return n;
+}
+
+/* The whole input cycle: arm, raw_io, data_done, store, then read */
+static int bench_trigger(struct zio_cset *cset)
+{
+	unsigned long n = 0;
+	ktime_t t;
+	int i;
+
+	t = ktime_get();
+	for (i = 0; i < bench_count; i++) {
+		zio_arm_trigger(cset->ti);
+		n += bench_drain(cset);
+	}
+	t = ktime_sub(ktime_get(), t);
+	bench_report("trigger", bench_count, t);
+	if (n != bench_count * cset->n_chan)
+		fprintf(stderr, "trigger: %lu blocks lost\n",
+			bench_count * cset->n_chan - n);
+	return 0;
+}
+
+/* The same, with reader and writer in different threads (lock traffic) */
+static volatile int bench_done;
+
+static void *bench_producer(void *arg)
+{
+	struct zio_cset *cset = arg;
+	int i;
+
+	for (i = 0; i < bench_count; i++)
+		zio_arm_trigger(cset->ti);
+	bench_done = 1;
+	return NULL;
+}
+
+static int bench_threads(struct zio_cset *cset)
+{
+	unsigned long n = 0, arms;
+	pthread_t thread;
+	ktime_t t;
+
+	atomic_set(&bench_events, 0);
+	bench_done = 0;
+	t = ktime_get();
+	if (pthread_create(&thread, NULL, bench_producer, cset))
+		return -EAGAIN;
+	while (!bench_done)
+		n += bench_drain(cset);
+	pthread_join(thread, NULL);
+	n += bench_drain(cset);
+	t = ktime_sub(ktime_get(), t);
+	arms = atomic_read(&bench_events);
+	bench_report("threads", arms, t);
+	printf("threads: %lu blocks read, %lu lost (buffer full)\n",
+	       n, arms * cset->n_chan - n);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct zio_cset *cset;
+	char *what;
+	int i, err;
+
+	while ((i = getopt(argc, argv, "b:c:s:z:n:vV")) != -1) {
+		switch (i) {
+		case 'b':
+			bench_buf = optarg;
+			break;
+		case 'c':
+			bench_nchan = atoi(optarg);
+			break;
+		case 's':
+			bench_nsamples = atoi(optarg);
+			break;
+		case 'z':
+			bench_ssize = atoi(optarg);
+			break;
+		case 'n':
+			bench_count = atol(optarg);
+			break;
+		case 'v':
+			bench_verbose++;
+			break;
+		case 'V':
+			print_version(argv[0]);
+			exit(0);
+		default:
+			help(argv[0]);
+		}
+	}
+	if (optind != argc - 1 || !bench_nchan || !bench_nsamples ||
+	    !bench_ssize)
+		help(argv[0]);
+	what = argv[optind];
+	kshim_verbose = bench_verbose;
+
+	err = kshim_init();
+	if (err) {
+		fprintf(stderr, "%s: init: %s\n", argv[0], strerror(-err));
+		exit(1);
+	}
+	if (!strcmp(what, "ffa")) {
+		err = bench_ffa();
+		goto out;
+	}
+
+	cset = kshim_cset_create(bench_buf, bench_nchan, bench_ssize,
+				 bench_nsamples, bench_raw_io);
+	if (IS_ERR(cset)) {
+		fprintf(stderr, "%s: buffer \"%s\": %s\n", argv[0], bench_buf,
+			strerror(-PTR_ERR(cset)));
+		exit(1);
+	}
+	if (!strcmp(what, "buffer"))
+		err = bench_buffer(cset);
+	else if (!strcmp(what, "trigger"))
+		err = bench_trigger(cset);
+	else if (!strcmp(what, "threads"))
+		err = bench_threads(cset);
+	else
+		help(argv[0]);
+	kshim_cset_destroy(cset);
+out:
+	kshim_exit();
+	if (err) {
+		fprintf(stderr, "%s: %s: %s\n", argv[0], what, strerror(-err));
+		exit(1);
+	}
+	return 0;
+}
@@ -0,0 +1,34 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * The user-space harness: zio-core objects built without sysfs and
+ * devices, the way objects.c builds them, so that the core code on the
+ * data path (triggers, buffers, helpers) runs unchanged in a process.
+ */
+#ifndef __ZIO_USPACE_H__
+#define __ZIO_USPACE_H__
+
+#include <linux/kernel.h>
+#include <linux/zio.h>
+#include <linux/zio-buffer.h>
+#include <linux/zio-trigger.h>
+
+/* Register the default buffer and trigger, as zio_init does */
+extern int kshim_init(void);
+extern void kshim_exit(void);
+
+extern struct zio_buffer_type *kshim_find_buf(const char *name);
+extern struct zio_trigger_type *kshim_find_trig(const char *name);
+
+/*
+ * An enabled input cset of "nchan" channels with the "user" trigger and
+ * the named buffer; raw_io is the fake hardware. Returns ERR_PTR on error.
+ */
+extern struct zio_cset *kshim_cset_create(const char *zbuf_name,
+					  unsigned int nchan,
+					  unsigned int ssize,
+					  unsigned int nsamples,
+					  int (*raw_io)(struct zio_cset *cset));
+extern void kshim_cset_destroy(struct zio_cset *cset);
+
+#endif /* __ZIO_USPACE_H__ */
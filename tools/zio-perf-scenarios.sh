@@ -0,0 +1,77 @@
+#!/bin/sh
+# Copyright 2026 CERN, GNU GPLv2 or later
+
+# Run zio-perf over zio-zero and zio-loop, for all the combinations of
+# buffer type, block size, number of channels, data access and waiting
+# method, printing one CSV line each. The modules must be loaded; the
+# environment can restrict the lists below, e.g. SIZES="1024" BUFFERS=kmalloc
+
+SYS=/sys/bus/zio/devices
+PERF=${PERF:-$(dirname $0)/zio-perf}
+BLOCKS=${BLOCKS:-10000}
+SIZES=${SIZES:-"16 256 4096 65536"}
+BUFFERS=${BUFFERS:-"kmalloc vmalloc"}
+ACCESS=${ACCESS:-"read mmap"}
+WAITS=${WAITS:-"block poll epoll"}
+
+set_attr () {
+    echo $2 > $1 || echo "$0: can't write $2 to $1" >&2
+}
+
+# Enable the first $2 channels of cset directory $1, disable the others
+set_chans () {
+    for c in $1/chan[0-9]*; do
+	i=${c##*/chan}
+	if [ $i -lt $2 ]; then set_attr $c/enable 1; else set_attr $c/enable 0; fi
+    done
+}
+
+# $1: label, $2: input channels, then zio-perf options
+run () {
+    label=$1; chans=$2; shift 2
+    for a in $ACCESS; do
+	for w in $WAITS; do
+	    $PERF -n $BLOCKS -m $a -w $w -l $label "$@" "$chans"
+	done
+    done
+}
+
+$PERF -H
+
+dev=$SYS/zzero-0000
+if [ -d $dev ]; then
+    for b in $BUFFERS; do
+	set_attr $dev/cset0/current_buffer $b
+	for n in 1 3; do
+	    set_chans $dev/cset0 $n
+	    for s in $SIZES; do
+		set_attr $dev/cset0/trigger/post-samples $s
+		run zero-$s "zzero-0000-0-[0-$((n - 1))]"
+	    done
+	done
+	set_chans $dev/cset0 3
+    done
+else
+    echo "$0: no zio-zero device, skipping it" >&2
+fi
+
+# The loop-back: cset 0 is written by zio-perf, cset 1 is read
+dev=$SYS/zloop-0000
+if [ -d $dev ]; then
+    for b in $BUFFERS; do
+	set_attr $dev/cset1/current_buffer $b
+	for n in 1 2; do
+	    set_chans $dev/cset0 $n
+	    set_chans $dev/cset1 $n
+	    for s in $SIZES; do
+		set_attr $dev/cset1/trigger/post-samples $s
+		run loop-$s "zloop-0000-1-[0-$((n - 1))]" \
+		    -o "zloop-0000-0-[0-$((n - 1))]" -s $s
+	    done
+	done
+	set_chans $dev/cset0 2
+	set_chans $dev/cset1 2
+    done
+else
+    echo "$0: no zio-loop device, skipping it" >&2
+fi
@@ -0,0 +1,374 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * Throughput and latency of ZIO input channels, as seen by a program.
+ * Blocks are received from the channels named on the command line, with
+ * read(2) or mmap, waiting in a blocking read, poll(2) or epoll; the data
+ * is touched, so the two access methods do the same work. For loop-back
+ * devices (zio-loop) a thread feeds the output channels of the loop.
+ *
+ * The result is a CSV line: MB/s, blocks/s, and the latency from the time
+ * stamp in the control (the trigger) to when the block reached the
+ * program, as 50th, 99th and 99.9th percentile.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+
+#include "libzio.h"
+
+static char git_version[] = "version: " GIT_VERSION;
+
+#define PERF_MAXCHAN	64
+
+enum perf_wait {PERF_BLOCK, PERF_POLL, PERF_EPOLL};
+static const char *perf_wait_names[] = {"block", "poll", "epoll"};
+
+struct perf_chan {
+	struct libzio_chan *ch;
+	char buffer[ZIO_OBJ_NAME_LEN + 1];
+	uint32_t seq;
+	unsigned long blocks, lost;
+};
+
+static struct perf {
+	char *prgname;
+	struct perf_chan in[PERF_MAXCHAN], out[PERF_MAXCHAN];
+	int nin, nout;
+	unsigned int out_nsamples;
+	volatile int stop;
+
+	unsigned long blocks, bytes, sum;
+	int64_t *lat;		/* ns, one per block with a time stamp */
+	unsigned long nlat, lat_size;
+} perf = {
+	.out_nsamples = 1024,
+};
+
+static void help(char *name)
+{
+	fprintf(stderr, "%s: Wrong number of arguments\n"
+		"Use: \"%s [options] <in-chan-pattern> [...]\"\n"
+		"   -m read|mmap          access to data (default mmap)\n"
+		"   -w block|poll|epoll   how to wait (default epoll)\n"
+		"   -n <blocks>           blocks to receive (default 10000)\n"
+		"   -t <secs>             stop anyway after this time "
+		"(default 10)\n"
+		"   -o <out-chan-pattern> feed these output channels "
+		"(zio-loop)\n"
+		"   -s <nsamples>         samples per output block "
+		"(default 1024)\n"
+		"   -l <label>            first field of the line\n"
+		"   -H                    print the CSV header and exit\n"
+		"   -V                    print version and exit\n",
+		name, name);
+	exit(1);
+}
+
+static void print_version(char *pname)
+{
+	printf("%s %s\n", pname, git_version);
+}
+
+static void print_header(void)
+{
+	printf("label,buffer,trigger,access,wait,channels,blocks,bytes,"
+	       "secs,MB/s,blocks/s,p50_us,p99_us,p999_us,lost\n");
+}
+
+static int64_t perf_now(int clock)
+{
+	struct timespec ts;
+
+	clock_gettime(clock, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int perf_open(char *pattern, struct perf_chan *c, int *n, int output,
+		     int flags)
+{
+	struct libzio_desc *list;
+	int i, found;
+
+	found = libzio_discover(pattern, &list);
+	if (found < 0) {
+		fprintf(stderr, "%s: %s: %s\n", perf.prgname, LIBZIO_SYSFS,
+			strerror(errno));
+		return -1;
+	}
+	for (i = 0; i < found; i++) {
+		if (list[i].output != output)
+			continue;
+		if (*n == PERF_MAXCHAN) {
+			fprintf(stderr, "%s: too many channels\n",
+				perf.prgname);
+			break;
+		}
+		c[*n].ch = libzio_open(list[i].devname, flags);
+		if (!c[*n].ch) {
+			fprintf(stderr, "%s: %s: %s\n", perf.prgname,
+				list[i].devname, strerror(errno));
+			break;
+		}
+		strcpy(c[*n].buffer, list[i].buffer);
+		(*n)++;
+	}
+	free(list);
+	return i == found ? 0 : -1;
+}
+
+/* For loop-backs: all output channels get a block, again and again */
+static void *perf_feed(void *unused)
+{
+	struct zio_control ctrl;
+	size_t len = 0;
+	void *data = NULL;
+	int i;
+
+	while (!perf.stop) {
+		for (i = 0; i < perf.nout; i++) {
+			if (libzio_ctrl_get(perf.out[i].ch, &ctrl) < 0)
+				goto err;
+			ctrl.nsamples = perf.out_nsamples;
+			if (ctrl.nsamples * ctrl.ssize > len) {
+				len = ctrl.nsamples * ctrl.ssize;
+				free(data);
+				data = calloc(1, len);
+				if (!data)
+					goto err;
+			}
+			if (libzio_put(perf.out[i].ch, &ctrl, data,
+				       ctrl.nsamples * ctrl.ssize) < 0)
+				goto err;
+		}
+	}
+	free(data);
+	return NULL;
+err:
+	if (!perf.stop)
+		fprintf(stderr, "%s: %s: %s\n", perf.prgname,
+			libzio_name(perf.out[i].ch), strerror(errno));
+	free(data);
+	return NULL;
+}
+
+/* Take note of a block, and touch its data once per cache line */
+static int perf_account(struct libzio_block *b)
+{
+	struct perf_chan *c;
+	const uint8_t *p = b->data;
+	int64_t lat, *new;
+	size_t i;
+
+	for (c = perf.in; c->ch != b->chan; c++)
+		;
+	if (c->blocks && b->ctrl.seq_num != c->seq + 1)
+		c->lost += b->ctrl.seq_num - c->seq - 1;
+	c->seq = b->ctrl.seq_num;
+	c->blocks++;
+
+	for (i = 0; i < b->datalen; i += 64)
+		perf.sum += p[i];
+	perf.blocks++;
+	perf.bytes += b->datalen;
+
+	if (!b->ctrl.tstamp.secs)
+		return 0;
+	lat = perf_now(CLOCK_REALTIME) - b->ctrl.tstamp.secs * 1000000000LL
+		- b->ctrl.tstamp.ticks;
+	if (perf.nlat == perf.lat_size) {
+		perf.lat_size = perf.lat_size * 2 + 4096;
+		new = realloc(perf.lat, perf.lat_size * sizeof(*new));
+		if (!new)
+			return -1;
+		perf.lat = new;
+	}
+	perf.lat[perf.nlat++] = lat;
+	return 0;
+}
+
+static int perf_cmp(const void *a, const void *b)
+{
+	int64_t x = *(int64_t *)a, y = *(int64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static double perf_pct(double pct)
+{
+	unsigned long i;
+
+	if (!perf.nlat)
+		return 0;
+	i = pct / 100 * perf.nlat;
+	if (i >= perf.nlat)
+		i = perf.nlat - 1;
+	return perf.lat[i] / 1e3;
+}
+
+int main(int argc, char **argv)
+{
+	struct libzio_block *blks[PERF_MAXCHAN];
+	struct libzio_set *set = NULL;
+	struct pollfd pfd[PERF_MAXCHAN];
+	enum perf_wait wait = PERF_EPOLL;
+	char *label = "", *outpattern = NULL;
+	int64_t t0, t1;
+	unsigned long nblocks = 10000, lost = 0;
+	double secs, duration = 10;
+	int c, i, n, flags = 0, nomap = 0, rr = 0;
+	pthread_t feeder;
+
+	perf.prgname = argv[0];
+	while ((c = getopt(argc, argv, "m:w:n:t:o:s:l:HV")) != -1) {
+		switch (c) {
+		case 'm':
+			if (!strcmp(optarg, "read"))
+				nomap = 1;
+			else if (strcmp(optarg, "mmap"))
+				help(argv[0]);
+			break;
+		case 'w':
+			for (i = 0; i < 3; i++)
+				if (!strcmp(optarg, perf_wait_names[i]))
+					break;
+			if (i == 3)
+				help(argv[0]);
+			wait = i;
+			break;
+		case 'n':
+			nblocks = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			duration = atof(optarg);
+			break;
+		case 'o':
+			outpattern = optarg;
+			break;
+		case 's':
+			perf.out_nsamples = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			label = optarg;
+			break;
+		case 'H':
+			print_header();
+			exit(0);
+		case 'V':
+			print_version(argv[0]);
+			exit(0);
+		default:
+			help(argv[0]);
+		}
+	}
+	if (optind == argc)
+		help(argv[0]);
+
+	if (nomap)
+		flags |= LIBZIO_NOMAP;
+	if (wait != PERF_BLOCK)
+		flags |= LIBZIO_NONBLOCK;
+	for (i = optind; i < argc; i++)
+		if (perf_open(argv[i], perf.in, &perf.nin, 0, flags) < 0)
+			exit(1);
+	if (outpattern && perf_open(outpattern, perf.out, &perf.nout, 1, 0))
+		exit(1);
+	if (!perf.nin || (outpattern && !perf.nout)) {
+		fprintf(stderr, "%s: no such channel\n", argv[0]);
+		exit(1);
+	}
+	if (!nomap && !libzio_is_mapped(perf.in[0].ch))
+		fprintf(stderr, "%s: %s: can't mmap, using read(2)\n",
+			argv[0], libzio_name(perf.in[0].ch));
+
+	if (wait == PERF_EPOLL) {
+		set = libzio_set_create();
+		for (i = 0; set && i < perf.nin; i++)
+			if (libzio_set_add(set, perf.in[i].ch) < 0)
+				break;
+		if (!set || i < perf.nin) {
+			fprintf(stderr, "%s: epoll: %s\n", argv[0],
+				strerror(errno));
+			exit(1);
+		}
+	}
+	for (i = 0; i < perf.nin; i++) {
+		pfd[i].fd = libzio_fd(perf.in[i].ch);
+		pfd[i].events = POLLIN;
+	}
+	if (perf.nout) {
+		errno = pthread_create(&feeder, NULL, perf_feed, NULL);
+		if (errno) {
+			fprintf(stderr, "%s: thread: %s\n", argv[0],
+				strerror(errno));
+			exit(1);
+		}
+	}
+
+	t0 = perf_now(CLOCK_MONOTONIC);
+	while (perf.blocks < nblocks) {
+		n = 0;
+		switch (wait) {
+		case PERF_BLOCK: /* the channels in turn */
+			if (libzio_get(perf.in[rr].ch, blks) == 0)
+				n = 1;
+			else if (errno != EINTR)
+				n = -1;
+			rr = (rr + 1) % perf.nin;
+			break;
+		case PERF_POLL:
+			i = poll(pfd, perf.nin, 100);
+			if (i < 0 && errno != EINTR)
+				n = -1;
+			for (i = 0; n >= 0 && i < perf.nin; i++) {
+				if (!(pfd[i].revents & POLLIN))
+					continue;
+				if (libzio_get(perf.in[i].ch, blks + n) == 0)
+					n++;
+				else if (errno != EAGAIN)
+					n = -1;
+			}
+			break;
+		case PERF_EPOLL:
+			n = libzio_wait(set, blks, perf.nin, 100);
+			break;
+		}
+		if (n < 0) {
+			fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
+			exit(1);
+		}
+		for (i = 0; i < n; i++) {
+			if (perf_account(blks[i]) < 0) {
+				fprintf(stderr, "%s: %s\n", argv[0],
+					strerror(errno));
+				exit(1);
+			}
+			libzio_release(blks[i]);
+		}
+		if (duration && (perf_now(CLOCK_MONOTONIC) - t0) / 1e9 >
+		    duration)
+			break;
+	}
+	t1 = perf_now(CLOCK_MONOTONIC);
+
+	perf.stop = 1;
+	for (i = 0; i < perf.nin; i++)
+		lost += perf.in[i].lost;
+	qsort(perf.lat, perf.nlat, sizeof(*perf.lat), perf_cmp);
+	secs = (t1 - t0) / 1e9;
+	printf("%s,%s,%s,%s,%s,%i,%lu,%lu,%.3f,%.1f,%.0f,%.1f,%.1f,%.1f,%lu\n",
+	       label, perf.in[0].buffer, libzio_trigger(perf.in[0].ch),
+	       libzio_is_mapped(perf.in[0].ch) ? "mmap" : "read",
+	       perf_wait_names[wait], perf.nin, perf.blocks, perf.bytes, secs,
+	       perf.bytes / secs / 1e6, perf.blocks / secs,
+	       perf_pct(50), perf_pct(99), perf_pct(99.9), lost);
+	/* The feeder may be blocked in write: exit rather than join */
+	exit(0);
+}
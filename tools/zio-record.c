@@ -0,0 +1,504 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * Record many ZIO input channels to disk at full speed. Blocks are taken
+ * through libzio (mapped, when the buffer allows it) and copied, in the
+ * capture format of libzio-cap.h, into large aligned batches; a writer
+ * thread writes them with O_DIRECT, so the page cache is not in the way,
+ * while more blocks are collected. Files are rotated at a given size;
+ * throughput and the losses seen in the controls (alarms and sequence
+ * gaps) are reported.
+ */
+#define _GNU_SOURCE /* for O_DIRECT */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "libzio.h"
+#include "libzio-cap.h"
+
+static char git_version[] = "version: " GIT_VERSION;
+
+#define REC_ALIGN	4096	/* O_DIRECT: buffer, length and offset */
+#define REC_NBATCH	4	/* one being filled, the others written */
+#define REC_MAXCHAN	256
+
+/* A batch is written whole; the last one of a file is padded and cut */
+struct rec_batch {
+	void *buf;
+	size_t len;		/* what is written, aligned */
+	size_t real;		/* if "last", the useful part of it */
+	int last;
+	int full;		/* owned by the writer */
+};
+
+static struct rec {
+	char *prgname;
+	char *dir, *prefix;
+	size_t maxfile;		/* 0: don't rotate */
+	size_t batchsize;
+	int direct;
+	unsigned int period;	/* blocks per index */
+
+	struct libzio_cap_writer cap;
+	struct rec_batch *cur;	/* being filled */
+
+	struct rec_batch batch[REC_NBATCH];
+	unsigned int filling, writing; /* free-running indexes */
+	int done, error;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+
+	unsigned int nfile;
+	unsigned long long written; /* by the writer, under lock */
+	unsigned int stalls;	/* the writer was behind */
+} rec = {
+	.dir = ".",
+	.prefix = "zio",
+	.maxfile = 1024 << 20,
+	.batchsize = 4 << 20,
+	.direct = 1,
+	.period = 1024,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/* What is known of each channel, to report what was lost */
+struct rec_chan {
+	struct libzio_chan *ch;
+	uint32_t seq;
+	uint8_t alarms;
+	unsigned long blocks, gaps, alarmed;
+};
+
+static volatile sig_atomic_t rec_stop;
+
+static void rec_signal(int sig)
+{
+	rec_stop = 1;
+}
+
+static void help(char *name)
+{
+	fprintf(stderr, "%s: Wrong number of arguments\n"
+		"Use: \"%s [options] <chan-pattern> [...]\"\n"
+		"   -d <dir>       directory of the files (default \".\")\n"
+		"   -p <prefix>    file names are <prefix>-<n>.zio "
+		"(default \"zio\")\n"
+		"   -s <MiB>       rotate files at this size, 0 never "
+		"(default 1024)\n"
+		"   -b <KiB>       size of a write batch (default 4096)\n"
+		"   -x <blocks>    blocks per index chunk (default 1024)\n"
+		"   -t <secs>      stop after this time (default: at ^C)\n"
+		"   -i <secs>      report interval, 0 never (default 1)\n"
+		"   -n             no O_DIRECT, write through the page cache\n"
+		"   -m             no mmap, read(2) the data\n"
+		"   -V             print version and exit\n"
+		"A pattern is matched against the channel names, "
+		"e.g. \"zzero-0000-0-*\"\n", name, name);
+	exit(1);
+}
+
+static void print_version(char *pname)
+{
+	printf("%s %s\n", pname, git_version);
+}
+
+static double rec_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int rec_open(void)
+{
+	char name[PATH_MAX];
+	int fd, flags = O_WRONLY | O_CREAT | O_TRUNC;
+
+	snprintf(name, sizeof(name), "%s/%s-%04u.zio", rec.dir, rec.prefix,
+		 rec.nfile++);
+	fd = open(name, flags | (rec.direct ? O_DIRECT : 0), 0644);
+	if (fd < 0 && rec.direct && errno == EINVAL) {
+		/* e.g. tmpfs: go on without it, but tell */
+		fprintf(stderr, "%s: %s: no O_DIRECT, using the page cache\n",
+			rec.prgname, name);
+		rec.direct = 0;
+		fd = open(name, flags, 0644);
+	}
+	if (fd < 0)
+		fprintf(stderr, "%s: %s: %s\n", rec.prgname, name,
+			strerror(errno));
+	return fd;
+}
+
+static int rec_write(int fd, struct rec_batch *b)
+{
+	size_t done = 0;
+	ssize_t i;
+
+	while (done < b->len) {
+		i = write(fd, b->buf + done, b->len - done);
+		if (i < 0 && errno == EINTR)
+			continue;
+		if (i < 0)
+			return -1;
+		done += i;
+	}
+	return 0;
+}
+
+static void *rec_writer(void *unused)
+{
+	struct rec_batch *b;
+	off_t pos = 0;
+	int fd = -1;
+
+	pthread_mutex_lock(&rec.lock);
+	for (;;) {
+		b = rec.batch + rec.writing % REC_NBATCH;
+		while (!b->full && !rec.done)
+			pthread_cond_wait(&rec.cond, &rec.lock);
+		if (!b->full)
+			break; /* done, and all written */
+		pthread_mutex_unlock(&rec.lock);
+
+		if (fd < 0)
+			fd = rec_open();
+		if (fd < 0 || rec_write(fd, b) < 0)
+			goto err;
+		if (b->last) {
+			if (ftruncate(fd, pos + b->real) < 0)
+				goto err;
+			close(fd);
+			fd = -1;
+			pos = 0;
+		} else {
+			pos += b->len;
+		}
+
+		pthread_mutex_lock(&rec.lock);
+		rec.written += b->last ? b->real : b->len;
+		b->full = 0;
+		rec.writing++;
+		pthread_cond_broadcast(&rec.cond);
+	}
+	pthread_mutex_unlock(&rec.lock);
+	return NULL;
+
+err:
+	fprintf(stderr, "%s: write: %s\n", rec.prgname, strerror(errno));
+	pthread_mutex_lock(&rec.lock);
+	rec.error = 1;
+	pthread_cond_broadcast(&rec.cond);
+	pthread_mutex_unlock(&rec.lock);
+	return NULL;
+}
+
+/* Hand the current batch to the writer and wait for the next one */
+static struct rec_batch *rec_flush(struct rec_batch *b, int last)
+{
+	if (last) {
+		b->real = b->len;
+		b->len = (b->len + REC_ALIGN - 1) & ~(REC_ALIGN - 1);
+		memset(b->buf + b->real, 0, b->len - b->real);
+	}
+	b->last = last;
+
+	pthread_mutex_lock(&rec.lock);
+	b->full = 1;
+	rec.filling++;
+	pthread_cond_broadcast(&rec.cond);
+	b = rec.batch + rec.filling % REC_NBATCH;
+	if (b->full)
+		rec.stalls++;
+	while (b->full && !rec.error)
+		pthread_cond_wait(&rec.cond, &rec.lock);
+	pthread_mutex_unlock(&rec.lock);
+	if (rec.error)
+		return NULL;
+	b->len = 0;
+	return b;
+}
+
+/* Copy into batches, splitting where they fill: they are one stream */
+static struct rec_batch *rec_append(struct rec_batch *b, const void *data,
+				    size_t len)
+{
+	size_t n;
+
+	while (b && len) {
+		n = rec.batchsize - b->len;
+		if (n > len)
+			n = len;
+		memcpy(b->buf + b->len, data, n);
+		b->len += n;
+		data += n;
+		len -= n;
+		if (b->len == rec.batchsize)
+			b = rec_flush(b, 0);
+	}
+	return b;
+}
+
+static int rec_out(void *priv, const void *buf, size_t len)
+{
+	rec.cur = rec_append(rec.cur, buf, len);
+	return rec.cur ? 0 : -1;
+}
+
+/* Every file names all channels: channel i is stream i */
+static int rec_file_start(struct rec_chan *chans, int nchan)
+{
+	int i;
+
+	if (libzio_cap_init(&rec.cap, rec.period, rec_out, NULL) < 0)
+		return -1;
+	for (i = 0; i < nchan; i++)
+		if (libzio_cap_stream(&rec.cap, i,
+				      libzio_name(chans[i].ch)) < 0)
+			return -1;
+	return 0;
+}
+
+static int rec_file_end(void)
+{
+	int ret = libzio_cap_finish(&rec.cap);
+
+	if (rec.cur)
+		rec.cur = rec_flush(rec.cur, 1);
+	return ret < 0 || !rec.cur ? -1 : 0;
+}
+
+static void rec_account(struct rec_chan *c, struct zio_control *ctrl)
+{
+	uint8_t new = ctrl->zio_alarms & ~c->alarms;
+
+	if (c->blocks && ctrl->seq_num != c->seq + 1)
+		c->gaps += ctrl->seq_num - c->seq - 1;
+	/* Alarms stay until cleared: only count them when they appear */
+	if (new & (ZIO_ALARM_LOST_BLOCK | ZIO_ALARM_LOST_TRIGGER)) {
+		c->alarmed++;
+		fprintf(stderr, "%s: %s: alarm 0x%02x at block %u\n",
+			rec.prgname, libzio_name(c->ch), new, ctrl->seq_num);
+	}
+	c->alarms = ctrl->zio_alarms;
+	c->seq = ctrl->seq_num;
+	c->blocks++;
+}
+
+static void rec_report(struct rec_chan *chans, int nchan, double elapsed,
+		       double *last_t, unsigned long long *last_b, int final)
+{
+	unsigned long blocks = 0, gaps = 0, alarmed = 0;
+	unsigned long long written;
+	unsigned int stalls;
+	double now;
+	int i;
+
+	for (i = 0; i < nchan; i++) {
+		blocks += chans[i].blocks;
+		gaps += chans[i].gaps;
+		alarmed += chans[i].alarmed;
+	}
+	pthread_mutex_lock(&rec.lock);
+	written = rec.written;
+	stalls = rec.stalls;
+	pthread_mutex_unlock(&rec.lock);
+
+	now = elapsed - *last_t;
+	fprintf(stderr, "%s: %.1f s: %lu blocks, %llu MB, %.1f MB/s "
+		"(%.1f now), lost %lu (%lu alarms), %u files, %u stalls\n",
+		rec.prgname, elapsed, blocks, written >> 20,
+		elapsed > 0 ? written / elapsed / 1e6 : 0,
+		now > 0 ? (written - *last_b) / now / 1e6 : 0,
+		gaps, alarmed, rec.nfile, stalls);
+	*last_t = elapsed;
+	*last_b = written;
+	if (!final)
+		return;
+	for (i = 0; i < nchan; i++)
+		fprintf(stderr, "%s: %s: %lu blocks, lost %lu (%lu alarms)\n",
+			rec.prgname, libzio_name(chans[i].ch),
+			chans[i].blocks, chans[i].gaps, chans[i].alarmed);
+}
+
+int main(int argc, char **argv)
+{
+	static struct rec_chan chans[REC_MAXCHAN];
+	struct libzio_block *blks[64];
+	struct libzio_desc *list;
+	struct libzio_set *set;
+	unsigned long long last_b = 0;
+	size_t size;
+	double t0, t, last_t = 0, next_report, duration = 0, interval = 1;
+	int c, i, j, n, nchan = 0, flags = 0;
+	pthread_t writer;
+
+	rec.prgname = argv[0];
+	while ((c = getopt(argc, argv, "d:p:s:b:x:t:i:nmV")) != -1) {
+		switch (c) {
+		case 'd':
+			rec.dir = optarg;
+			break;
+		case 'p':
+			rec.prefix = optarg;
+			break;
+		case 's':
+			rec.maxfile = strtoul(optarg, NULL, 0) << 20;
+			break;
+		case 'b':
+			rec.batchsize = strtoul(optarg, NULL, 0) << 10;
+			break;
+		case 'x':
+			rec.period = atoi(optarg);
+			break;
+		case 't':
+			duration = atof(optarg);
+			break;
+		case 'i':
+			interval = atof(optarg);
+			break;
+		case 'n':
+			rec.direct = 0;
+			break;
+		case 'm':
+			flags |= LIBZIO_NOMAP;
+			break;
+		case 'V':
+			print_version(argv[0]);
+			exit(0);
+		default:
+			help(argv[0]);
+		}
+	}
+	if (optind == argc)
+		help(argv[0]);
+	rec.batchsize &= ~(REC_ALIGN - 1);
+	if (!rec.batchsize) {
+		fprintf(stderr, "%s: batch must be at least %i bytes\n",
+			argv[0], REC_ALIGN);
+		exit(1);
+	}
+
+	set = libzio_set_create();
+	if (!set) {
+		fprintf(stderr, "%s: epoll: %s\n", argv[0], strerror(errno));
+		exit(1);
+	}
+	for (i = optind; i < argc; i++) {
+		n = libzio_discover(argv[i], &list);
+		if (n < 0) {
+			fprintf(stderr, "%s: %s: %s\n", argv[0], LIBZIO_SYSFS,
+				strerror(errno));
+			exit(1);
+		}
+		if (!n)
+			fprintf(stderr, "%s: %s: no such channel\n", argv[0],
+				argv[i]);
+		for (j = 0; j < n; j++) {
+			if (list[j].output)
+				continue;
+			if (nchan == REC_MAXCHAN) {
+				fprintf(stderr, "%s: too many channels\n",
+					argv[0]);
+				exit(1);
+			}
+			chans[nchan].ch = libzio_open(list[j].devname,
+						      flags | LIBZIO_NONBLOCK);
+			if (!chans[nchan].ch ||
+			    libzio_set_add(set, chans[nchan].ch) < 0) {
+				fprintf(stderr, "%s: %s: %s\n", argv[0],
+					list[j].devname, strerror(errno));
+				exit(1);
+			}
+			nchan++;
+		}
+		free(list);
+	}
+	if (!nchan) {
+		fprintf(stderr, "%s: no input channel to record\n", argv[0]);
+		exit(1);
+	}
+
+	for (i = 0; i < REC_NBATCH; i++) {
+		if (posix_memalign(&rec.batch[i].buf, REC_ALIGN,
+				   rec.batchsize)) {
+			fprintf(stderr, "%s: %s\n", argv[0], strerror(ENOMEM));
+			exit(1);
+		}
+	}
+	rec.cur = rec.batch;
+	errno = pthread_create(&writer, NULL, rec_writer, NULL);
+	if (errno) {
+		fprintf(stderr, "%s: thread: %s\n", argv[0], strerror(errno));
+		exit(1);
+	}
+	signal(SIGINT, rec_signal);
+	signal(SIGTERM, rec_signal);
+
+	t0 = rec_now();
+	next_report = interval;
+	if (rec_file_start(chans, nchan) < 0)
+		rec_stop = 1;
+	while (!rec_stop && rec.cur) {
+		/* A short timeout, to report and to stop on time */
+		n = libzio_wait(set, blks, sizeof(blks) / sizeof(blks[0]),
+				100);
+		if (n < 0 && errno != EINTR) {
+			fprintf(stderr, "%s: wait: %s\n", argv[0],
+				strerror(errno));
+			break;
+		}
+		for (i = 0; i < n; i++) {
+			for (j = 0; chans[j].ch != blks[i]->chan; j++)
+				;
+			rec_account(chans + j, &blks[i]->ctrl);
+
+			size = libzio_cap_block_size(blks[i]->datalen);
+			if (rec.maxfile && rec.cap.nblocks &&
+			    rec.cap.offset + size > rec.maxfile) {
+				if (rec_file_end() < 0 ||
+				    rec_file_start(chans, nchan) < 0)
+					rec_stop = 1;
+			}
+			if (!rec_stop)
+				libzio_cap_block(&rec.cap, j, &blks[i]->ctrl,
+						 blks[i]->data,
+						 blks[i]->datalen);
+			libzio_release(blks[i]);
+		}
+		t = rec_now() - t0;
+		if (interval && t >= next_report) {
+			rec_report(chans, nchan, t, &last_t, &last_b, 0);
+			next_report += interval;
+		}
+		if (duration && t >= duration)
+			break;
+	}
+	if (rec.cur)
+		rec_file_end();
+
+	pthread_mutex_lock(&rec.lock);
+	rec.done = 1;
+	pthread_cond_broadcast(&rec.cond);
+	pthread_mutex_unlock(&rec.lock);
+	pthread_join(writer, NULL);
+
+	rec_report(chans, nchan, rec_now() - t0, &last_t, &last_b, 1);
+	for (i = 0; i < nchan; i++)
+		libzio_close(chans[i].ch);
+	libzio_set_destroy(set);
+	exit(rec.error ? 1 : 0);
+}
@@ -0,0 +1,302 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * Replay a capture (see libzio/libzio-cap.h) on output channels, with
+ * the original timing. Streams of the file go to the channels named on
+ * the command line, in order; blocks are written ahead of time, up to a
+ * window, so the kernel has them queued when they are due. With the
+ * "hrt" trigger each control carries the time the block must be played
+ * (the recorded time, moved to now); with other triggers (e.g. "pace")
+ * the trigger decides, and the times are only used for the report.
+ *
+ * The current control of the first channel tells when each block was
+ * played: the error against the schedule is reported, with the blocks
+ * written late, the ones played late and the underruns of the trigger.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#include <time.h>
+
+#include "libzio.h"
+#include "libzio-cap.h"
+
+static char git_version[] = "version: " GIT_VERSION;
+
+#define RP_MAXCHAN	64
+#define NSEC_PER_SEC	1000000000LL
+
+struct rp_stream {
+	struct libzio_chan *ch;
+	uint32_t id;
+	long i, n;		/* next block, number of blocks */
+};
+
+static void help(char *name)
+{
+	fprintf(stderr, "%s: Wrong number of arguments\n"
+		"Use: \"%s [options] <capture> <out-chan> [...]\"\n"
+		"   -f <stream>    first stream to play (default 0)\n"
+		"   -l <ms>        delay of the first block (default 200)\n"
+		"   -w <ms>        how long in advance blocks are written "
+		"(default 1000)\n"
+		"   -r <factor>    speed, 2 is twice as fast (default 1)\n"
+		"   -v             report each block played\n"
+		"   -V             print version and exit\n"
+		"Stream f + i of the capture is played on channel i\n",
+		name, name);
+	exit(1);
+}
+
+static void print_version(char *pname)
+{
+	printf("%s %s\n", pname, git_version);
+}
+
+static int64_t rp_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static int64_t rp_ns(uint64_t secs, uint64_t ticks)
+{
+	return secs * NSEC_PER_SEC + ticks;
+}
+
+/* The stream whose next block was recorded first, or NULL at the end */
+static struct rp_stream *rp_next(struct libzio_cap *cap,
+				 struct rp_stream *s, int n,
+				 const struct zio_cap_entry **entry)
+{
+	const struct zio_cap_entry *e, *best = NULL;
+	struct rp_stream *ret = NULL;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (s[i].i == s[i].n)
+			continue;
+		e = libzio_cap_entry(cap, s[i].id, s[i].i);
+		if (!best || rp_ns(e->secs, e->ticks) <
+		    rp_ns(best->secs, best->ticks)) {
+			best = e;
+			ret = s + i;
+		}
+	}
+	*entry = best;
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	static struct rp_stream streams[RP_MAXCHAN];
+	const struct zio_cap_entry *e;
+	struct libzio_cap *cap;
+	struct rp_stream *s;
+	struct zio_control ctrl, cur;
+	struct libzio_chan *first;
+	int64_t *sched, t0 = -1, start, now, when, err, last = 0;
+	int64_t err_min = INT64_MAX, err_max = INT64_MIN, err_sum = 0;
+	double speed = 1;
+	long lead = 200, window = 1000, written = 0, late = 0;
+	long played = 0, observed = 0, over = 0;
+	uint32_t seq0, seq, slack = 0, und0 = 0, und = 0, val;
+	uint8_t alarms = 0;
+	int c, i, nchan, hrt, pace, verbose = 0;
+	unsigned int firststream = 0;
+	void *data = NULL;
+	size_t datasize = 0;
+	long len;
+
+	while ((c = getopt(argc, argv, "f:l:w:r:vV")) != -1) {
+		switch (c) {
+		case 'f':
+			firststream = atoi(optarg);
+			break;
+		case 'l':
+			lead = atol(optarg);
+			break;
+		case 'w':
+			window = atol(optarg);
+			break;
+		case 'r':
+			speed = atof(optarg);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		case 'V':
+			print_version(argv[0]);
+			exit(0);
+		default:
+			help(argv[0]);
+		}
+	}
+	nchan = argc - optind - 1;
+	if (nchan < 1 || nchan > RP_MAXCHAN || speed <= 0)
+		help(argv[0]);
+
+	cap = libzio_cap_open(argv[optind]);
+	if (!cap) {
+		fprintf(stderr, "%s: %s: %s\n", argv[0], argv[optind],
+			strerror(errno));
+		exit(1);
+	}
+	for (i = 0; i < nchan; i++) {
+		s = streams + i;
+		s->id = firststream + i;
+		s->n = libzio_cap_nblocks(cap, s->id);
+		if (s->n < 0) {
+			fprintf(stderr, "%s: %s: no stream %u\n", argv[0],
+				argv[optind], s->id);
+			exit(1);
+		}
+		s->ch = libzio_open(argv[optind + 1 + i], 0);
+		if (!s->ch) {
+			fprintf(stderr, "%s: %s: %s\n", argv[0],
+				argv[optind + 1 + i], strerror(errno));
+			exit(1);
+		}
+		if (s->n) {
+			e = libzio_cap_entry(cap, s->id, 0);
+			when = rp_ns(e->secs, e->ticks);
+			if (t0 < 0 || when < t0)
+				t0 = when;
+		}
+	}
+	first = streams[0].ch;
+	if (!streams[0].n) {
+		fprintf(stderr, "%s: stream %u is empty\n", argv[0],
+			streams[0].id);
+		exit(1);
+	}
+	sched = calloc(streams[0].n, sizeof(*sched));
+	if (!sched || libzio_ctrl_get(first, &cur) < 0) {
+		fprintf(stderr, "%s: %s: %s\n", argv[0], libzio_name(first),
+			strerror(errno));
+		exit(1);
+	}
+	seq0 = seq = cur.seq_num;
+
+	/* What the trigger can do for us, and what it tells */
+	hrt = !strcmp(libzio_trigger(first), "hrt");
+	if (hrt)
+		libzio_attr_get(first, "../trigger/slack-ns", &slack);
+	pace = libzio_attr_get(first, "../trigger/underruns", &und0) == 0;
+	if (!hrt)
+		fprintf(stderr, "%s: trigger \"%s\" ignores the time stamps: "
+			"the timing is the trigger's\n", argv[0],
+			libzio_trigger(first));
+
+	start = rp_now() + lead * 1000 * 1000;
+	s = rp_next(cap, streams, nchan, &e);
+	while (s || played < written) {
+		now = rp_now();
+
+		/* Write ahead, up to the window */
+		while (s) {
+			when = start + (rp_ns(e->secs, e->ticks) - t0) / speed;
+			if (when > now + window * 1000 * 1000)
+				break;
+			len = libzio_cap_read(cap, s->id, s->i, &ctrl, data,
+					      datasize);
+			if (len > 0 && len > datasize) {
+				datasize = len;
+				data = realloc(data, datasize);
+				if (!data) {
+					fprintf(stderr, "%s: %s\n", argv[0],
+						strerror(errno));
+					exit(1);
+				}
+				len = libzio_cap_read(cap, s->id, s->i, &ctrl,
+						      data, datasize);
+			}
+			if (len < 0) {
+				fprintf(stderr, "%s: %s: %s\n", argv[0],
+					argv[optind], strerror(errno));
+				exit(1);
+			}
+			if (hrt) {
+				ctrl.tstamp.secs = when / NSEC_PER_SEC;
+				ctrl.tstamp.ticks = when % NSEC_PER_SEC;
+			} else {
+				ctrl.tstamp.secs = ctrl.tstamp.ticks = 0;
+			}
+			ctrl.tstamp.bins = 0;
+			if (when < now)
+				late++;
+			if (libzio_put(s->ch, &ctrl, data, len) < 0) {
+				fprintf(stderr, "%s: %s: %s\n", argv[0],
+					libzio_name(s->ch), strerror(errno));
+				exit(1);
+			}
+			if (s == streams)
+				sched[written++] = when;
+			last = when;
+			s->i++;
+			s = rp_next(cap, streams, nchan, &e);
+		}
+
+		/* See what was played: the control tells the last one */
+		if (libzio_ctrl_get(first, &cur) < 0) {
+			fprintf(stderr, "%s: %s: %s\n", argv[0],
+				libzio_name(first), strerror(errno));
+			exit(1);
+		}
+		if (cur.zio_alarms & ~alarms & ZIO_ALARM_UNDERRUN)
+			und++;
+		alarms = cur.zio_alarms;
+		if (cur.seq_num != seq) {
+			seq = cur.seq_num;
+			played = seq - seq0;
+			if (played > 0 && played <= written) {
+				i = played - 1;
+				err = rp_ns(cur.tstamp.secs, cur.tstamp.ticks)
+					- sched[i];
+				observed++;
+				err_sum += err;
+				if (err < err_min)
+					err_min = err;
+				if (err > err_max)
+					err_max = err;
+				if (hrt && err > (int64_t)slack)
+					over++;
+				if (verbose)
+					printf("block %i: error %+lli ns\n", i,
+					       (long long)err);
+			}
+		}
+		/* Whatever is not played two seconds after its time, is lost */
+		if (!s && now > last + 2 * NSEC_PER_SEC)
+			break;
+		usleep(100);
+	}
+
+	if (pace && libzio_attr_get(first, "../trigger/underruns", &val) == 0)
+		und = val - und0;
+	fprintf(stderr, "%s: %li blocks written, %li after their time; "
+		"%li played (of %li)\n", argv[0], written, late,
+		played, written);
+	if (observed)
+		fprintf(stderr, "%s: error on %li blocks seen: min %+.1f "
+			"avg %+.1f max %+.1f us%s", argv[0], observed,
+			err_min / 1e3, err_sum / observed / 1e3,
+			err_max / 1e3, hrt ? "" : "\n");
+	if (observed && hrt)
+		fprintf(stderr, "; %li over the slack of %u ns\n", over,
+			slack);
+	fprintf(stderr, "%s: %u underruns\n", argv[0], und);
+
+	for (i = 0; i < nchan; i++)
+		libzio_close(streams[i].ch);
+	libzio_cap_close(cap);
+	free(sched);
+	free(data);
+	exit(played < written ? 1 : 0);
+}
@@ -0,0 +1,336 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * This is a group trigger: several csets, possibly in different devices,
+ * are bound to the same timing source. Each group is one periodic
+ * high-resolution timer; at each expiration all the trigger instances
+ * in the group are armed, and their blocks get the same time stamp (the
+ * nominal expiration time) and the same sequence number.
+ *
+ * Instances select their group with the "group" attribute; the period
+ * belongs to the group, so writing it in one instance affects them all.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+
+#include <linux/zio.h>
+#include <linux/zio-sysfs.h>
+#include <linux/zio-buffer.h>
+#include <linux/zio-trigger.h>
+
+#define ZTG_NGROUPS 8
+
+struct ztg_group {
+	spinlock_t		lock; /* protects all the fields */
+	struct list_head	list;
+	struct hrtimer		timer;
+	uint64_t		period; /* ns */
+	uint32_t		seq;
+	struct ztg_instance	*firing; /* being armed, out of the lock */
+};
+
+static struct ztg_group ztg_groups[ZTG_NGROUPS];
+
+struct ztg_instance {
+	struct zio_ti		ti;
+	struct list_head	list;
+	struct ztg_group	*group;
+	uint32_t		fired; /* last group seq, with the group lock */
+	/* The event being acquired: protected by the cset lock */
+	struct timespec		tstamp;
+	uint32_t		seq;
+};
+#define to_ztg_instance(ti) container_of(ti, struct ztg_instance, ti)
+
+enum ztg_attrs { /* names for the "addr" value of sw parameters */
+	ZTG_ATTR_NSAMPLES = 0,
+	ZTG_ATTR_NSHOTS,
+	ZTG_ATTR_GROUP,
+	ZTG_ATTR_PERIOD,
+};
+
+static ZIO_ATTR_DEFINE_STD(ZIO_TRG, ztg_std_attr) = {
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_N_SHOTS, ZIO_RW_PERM,
+		 ZTG_ATTR_NSHOTS, 0),
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_PRE_SAMP, ZIO_RW_PERM,
+		 ZTG_ATTR_NSAMPLES, 0),
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_POST_SAMP, ZIO_RW_PERM,
+		 ZTG_ATTR_NSAMPLES, 16),
+};
+
+static struct zio_attribute ztg_ext_attr[] = {
+	ZIO_ATTR_EXT_RNG("group", ZIO_RW_PERM, ZTG_ATTR_GROUP, 0,
+			 0, ZTG_NGROUPS - 1),
+	ZIO_PARAM_RNG("us-period", ZIO_RW_PERM, ZTG_ATTR_PERIOD,
+		      1000 * 1000, 1, 0xffffffff),
+};
+
+/* Start the timer at the next multiple of the period; group lock held */
+static void ztg_resync(struct ztg_group *g)
+{
+	uint64_t now = ktime_to_ns(ktime_get_real());
+	uint64_t next_run;
+
+	next_run = div64_u64(now, g->period) * g->period + g->period;
+	hrtimer_start(&g->timer, ns_to_ktime(next_run), HRTIMER_MODE_ABS);
+}
+
+static void ztg_join(struct ztg_instance *ztg, struct ztg_group *g)
+{
+	unsigned long flags;
+	int first;
+
+	spin_lock_irqsave(&g->lock, flags);
+	first = list_empty(&g->list);
+	list_add_tail(&ztg->list, &g->list);
+	ztg->group = g;
+	ztg->fired = g->seq; /* start with the next event */
+	if (first)
+		ztg_resync(g);
+	spin_unlock_irqrestore(&g->lock, flags);
+}
+
+static void ztg_leave(struct ztg_instance *ztg)
+{
+	struct ztg_group *g = ztg->group;
+	unsigned long flags;
+
+	spin_lock_irqsave(&g->lock, flags);
+	list_del(&ztg->list);
+	/* If running, ztg_fn sees the empty list and doesn't restart */
+	if (list_empty(&g->list))
+		hrtimer_try_to_cancel(&g->timer);
+	/* The timer may be arming this one out of the lock: wait for it */
+	while (g->firing == ztg) {
+		spin_unlock_irqrestore(&g->lock, flags);
+		cpu_relax();
+		spin_lock_irqsave(&g->lock, flags);
+	}
+	spin_unlock_irqrestore(&g->lock, flags);
+}
+
+static int ztg_conf_set(struct device *dev, struct zio_attribute *zattr,
+			uint32_t usr_val)
+{
+	struct ztg_instance *ztg = to_ztg_instance(to_zio_ti(dev));
+	struct ztg_group *g = ztg->group;
+	unsigned long flags;
+
+	switch (zattr->id) {
+	case ZTG_ATTR_GROUP:
+		if (ztg->group == &ztg_groups[usr_val])
+			break;
+		ztg_leave(ztg);
+		ztg_join(ztg, &ztg_groups[usr_val]);
+		break;
+	case ZTG_ATTR_PERIOD:
+		spin_lock_irqsave(&g->lock, flags);
+		g->period = (uint64_t)usr_val * NSEC_PER_USEC;
+		ztg_resync(g);
+		spin_unlock_irqrestore(&g->lock, flags);
+		break;
+	case ZTG_ATTR_NSAMPLES:
+	case ZTG_ATTR_NSHOTS:
+		/* Nothing to do */
+		break;
+	default:
+		pr_err("%s: unknown \"addr\" 0x%lx for configuration\n",
+				__func__, zattr->id);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int ztg_info_get(struct device *dev, struct zio_attribute *zattr,
+			uint32_t *usr_val)
+{
+	struct ztg_instance *ztg = to_ztg_instance(to_zio_ti(dev));
+
+	if (zattr->id == ZTG_ATTR_PERIOD)
+		*usr_val = div_u64(ztg->group->period, NSEC_PER_USEC);
+	return 0;
+}
+
+static struct zio_sysfs_operations ztg_s_ops = {
+	.conf_set = ztg_conf_set,
+	.info_get = ztg_info_get,
+};
+
+/* Arm one instance of the group, recording the event if not busy */
+static void ztg_fire(struct ztg_instance *ztg, struct timespec *ts,
+		     uint32_t seq)
+{
+	struct zio_cset *cset = ztg->ti.cset;
+	struct zio_channel *chan;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cset->lock, flags);
+	if (ztg->ti.flags & ZIO_TI_ARMED) {
+		/* previous event still running: this one is lost */
+		if ((ztg->ti.flags & ZIO_STATUS) == ZIO_ENABLED)
+			chan_for_each(chan, cset)
+				chan->current_ctrl->zio_alarms |=
+						ZIO_ALARM_LOST_TRIGGER;
+		spin_unlock_irqrestore(&cset->lock, flags);
+		return;
+	}
+	ztg->tstamp = *ts;
+	ztg->seq = seq;
+	spin_unlock_irqrestore(&cset->lock, flags);
+	zio_arm_trigger(&ztg->ti);
+}
+
+/* The next member not armed for this event yet; group lock held */
+static struct ztg_instance *ztg_next(struct ztg_group *g, uint32_t seq)
+{
+	struct ztg_instance *ztg;
+
+	list_for_each_entry(ztg, &g->list, list)
+		if (ztg->fired != seq)
+			return ztg;
+	return NULL;
+}
+
+/*
+ * This runs when the timer of a group expires. Members are armed out of
+ * the group lock, as arming may run a whole acquisition of synchronous
+ * devices: one at a time, so ztg_leave only waits for its own.
+ */
+static enum hrtimer_restart ztg_fn(struct hrtimer *timer)
+{
+	struct ztg_group *g = container_of(timer, struct ztg_group, timer);
+	struct ztg_instance *ztg;
+	struct timespec ts;
+	uint32_t seq;
+
+	/* The nominal time, so all members and all groups agree */
+	ts = ktime_to_timespec(hrtimer_get_expires(timer));
+
+	spin_lock(&g->lock);
+	seq = ++g->seq;
+	while ((ztg = ztg_next(g, seq))) {
+		ztg->fired = seq;
+		g->firing = ztg;
+		spin_unlock(&g->lock);
+		ztg_fire(ztg, &ts, seq);
+		spin_lock(&g->lock);
+		g->firing = NULL;
+	}
+	if (list_empty(&g->list)) {
+		spin_unlock(&g->lock);
+		return HRTIMER_NORESTART;
+	}
+	/* If the period changed meanwhile, the timer is already restarted */
+	if (!hrtimer_is_queued(timer))
+		hrtimer_forward_now(timer, ns_to_ktime(g->period));
+	spin_unlock(&g->lock);
+	return HRTIMER_RESTART;
+}
+
+/*
+ * The generic data_done, but with the time stamp and sequence number
+ * of the group event (the generic code increments seq_num).
+ */
+static int ztg_data_done(struct zio_cset *cset)
+{
+	struct ztg_instance *ztg = to_ztg_instance(cset->ti);
+	struct zio_channel *chan;
+
+	cset->ti->tstamp = ztg->tstamp;
+	cset->ti->tstamp_extra = 0;
+	chan_for_each(chan, cset)
+		chan->current_ctrl->seq_num = ztg->seq - 1;
+	return zio_generic_data_done(cset);
+}
+
+static struct zio_ti *ztg_create(struct zio_trigger_type *trig,
+				 struct zio_cset *cset,
+				 struct zio_control *ctrl, fmode_t flags)
+{
+	struct ztg_instance *ztg;
+	struct zio_ti *ti;
+
+	pr_debug("%s:%d\n", __func__, __LINE__);
+
+	ztg = kzalloc(sizeof(struct ztg_instance), GFP_ATOMIC);
+	if (!ztg)
+		return ERR_PTR(-ENOMEM);
+	ti = &ztg->ti;
+	ti->flags = ZIO_DISABLED;
+	ti->cset = cset;
+
+	ztg_join(ztg, &ztg_groups[ztg_ext_attr[0].value]);
+	return ti;
+}
+
+static void ztg_destroy(struct zio_ti *ti)
+{
+	struct ztg_instance *ztg = to_ztg_instance(ti);
+
+	pr_debug("%s:%d\n", __func__, __LINE__);
+	ztg_leave(ztg);
+	kfree(ztg);
+}
+
+static const struct zio_trigger_operations ztg_trigger_ops = {
+	.push_block = zio_generic_push_block,
+	.create = ztg_create,
+	.destroy = ztg_destroy,
+	.data_done = ztg_data_done,
+};
+
+static struct zio_trigger_type ztg_trigger = {
+	.owner = THIS_MODULE,
+	.zattr_set = {
+		.std_zattr = ztg_std_attr,
+		.ext_zattr = ztg_ext_attr,
+		.n_ext_attr = ARRAY_SIZE(ztg_ext_attr),
+	},
+	.s_op = &ztg_s_ops,
+	.t_op = &ztg_trigger_ops,
+};
+
+/*
+ * init and exit
+ */
+static int __init ztg_init(void)
+{
+	struct ztg_group *g;
+	int i;
+
+	for (i = 0; i < ZTG_NGROUPS; i++) {
+		g = &ztg_groups[i];
+		spin_lock_init(&g->lock);
+		INIT_LIST_HEAD(&g->list);
+		hrtimer_init(&g->timer, CLOCK_REALTIME, HRTIMER_MODE_ABS);
+		g->timer.function = ztg_fn;
+		g->period = (uint64_t)ztg_ext_attr[1].value * NSEC_PER_USEC;
+	}
+	return zio_register_trig(&ztg_trigger, "group");
+}
+
+static void __exit ztg_exit(void)
+{
+	int i;
+
+	zio_unregister_trig(&ztg_trigger);
+	for (i = 0; i < ZTG_NGROUPS; i++)
+		hrtimer_cancel(&ztg_groups[i].timer);
+}
+
+module_init(ztg_init);
+module_exit(ztg_exit);
+
+MODULE_VERSION(GIT_VERSION); /* Defined in local Makefile */
+MODULE_AUTHOR("Alessandro Rubini");
+MODULE_LICENSE("GPL");
+
+ADDITIONAL_VERSIONS;
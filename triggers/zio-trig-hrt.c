@@ -6,7 +6,10 @@
  * multi-instance. The code is based on zio-trig-timer even if the
  * behaviour is different: the timer trigger is only periodic while this one
  * is basically one-shot, with periodic operation as an option for input.
- * For output, the time stamp can received in the control block.
+ * For output, the time stamp can received in the control block: such
+ * blocks are kept in a time-ordered queue, and the timer is programmed
+ * for the earliest one, so user space can write a whole schedule in
+ * advance. Blocks with no time stamp are played at the next expiration.
  */
 
 #include <linux/kernel.h>
@@ -16,6 +19,8 @@
 #include <linux/slab.h>
 #include <linux/ktime.h>
 #include <linux/hrtimer.h>
+#include <linux/list.h>
+#include <linux/spinlock.h>
 
 #include <linux/zio.h>
 #include <linux/zio-sysfs.h>
@@ -33,11 +38,22 @@ struct ztt_instance {
 	uint32_t		slack;
 	uint32_t		period;
 	unsigned long		flags;
+	spinlock_t		qlock; /* nests within cset and bi locks */
+	struct list_head	queue; /* of ztt_event, in time order */
 };
 #define to_ztt_instance(ti) container_of(ti, struct ztt_instance, ti)
 
+/* A scheduled output block */
+struct ztt_event {
+	struct list_head	list;
+	ktime_t			time;
+	struct zio_channel	*chan;
+	struct zio_block	*block;
+};
+
 enum ztt_attrs { /* names for the "addr" value of sw parameters */
 	ZTT_ATTR_NSAMPLES = 0,
+	ZTT_ATTR_NSHOTS,
 	ZTT_ATTR_SLACK_NS,
 	ZTT_ATTR_PERIOD,	/* 0 to disable periodic mode */
 	/* Further attributes are "expire time" */
@@ -48,6 +64,10 @@ enum ztt_attrs { /* names for the "addr" value of sw parameters */
 };
 
 static ZIO_ATTR_DEFINE_STD(ZIO_TRG, ztt_std_attr) = {
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_N_SHOTS, ZIO_RW_PERM,
+		  ZTT_ATTR_NSHOTS, 0),
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_PRE_SAMP, ZIO_RW_PERM,
+		  ZTT_ATTR_NSAMPLES, 0),
 	ZIO_ATTR(trig, ZIO_ATTR_TRIG_POST_SAMP, ZIO_RW_PERM,
 		  ZTT_ATTR_NSAMPLES, 16),
 };
@@ -80,6 +100,7 @@ static int ztt_conf_set(struct device *dev, struct zio_attribute *zattr,
 	pr_debug("%s:%d\n", __func__, __LINE__);
 	switch (zattr->id) {
 	case ZTT_ATTR_NSAMPLES:
+	case ZTT_ATTR_NSHOTS:
 		/* Nothing to do */
 		break;
 	case ZTT_ATTR_SLACK_NS:
@@ -140,18 +161,110 @@ static struct zio_sysfs_operations ztt_s_ops = {
 	.conf_set = ztt_conf_set,
 };
 
+/* Return the time stamp of an output block, if any */
+static int ztt_block_time(struct zio_block *block, ktime_t *ktime)
+{
+	struct zio_control *ctrl = zio_get_ctrl(block);
+
+	if (!ctrl->tstamp.secs && !ctrl->tstamp.ticks)
+		return 0;
+	if (ctrl->tstamp.secs) {
+		struct timespec ts = {ctrl->tstamp.secs, ctrl->tstamp.ticks};
+		*ktime = timespec_to_ktime(ts);
+	} else {
+		*ktime = ns_to_ktime(ctrl->tstamp.ticks);
+	}
+	return 1;
+}
+
+/* Program the timer for the first queued block, with qlock held */
+static void ztt_program(struct ztt_instance *ztt)
+{
+	struct ztt_event *ev;
+
+	if (list_empty(&ztt->queue))
+		return;
+	ev = list_first_entry(&ztt->queue, struct ztt_event, list);
+	if (hrtimer_is_queued(&ztt->timer) &&
+	    ktime_to_ns(hrtimer_get_expires(&ztt->timer)) <=
+	    ktime_to_ns(ev->time))
+		return;
+	hrtimer_start_range_ns(&ztt->timer, ev->time, ztt->slack,
+			       HRTIMER_MODE_ABS);
+}
+
+/*
+ * Insert a block in the queue. User space usually writes blocks in
+ * time order, so we look for the place starting from the tail.
+ */
+static int ztt_enqueue(struct ztt_instance *ztt, struct zio_channel *chan,
+		       struct zio_block *block, ktime_t ktime)
+{
+	struct ztt_event *ev, *e;
+	unsigned long flags;
+
+	ev = kmalloc(sizeof(*ev), GFP_ATOMIC);
+	if (!ev)
+		return -ENOMEM;
+	ev->time = ktime;
+	ev->chan = chan;
+	ev->block = block;
+
+	spin_lock_irqsave(&ztt->qlock, flags);
+	list_for_each_entry_reverse(e, &ztt->queue, list)
+		if (ktime_to_ns(e->time) <= ktime_to_ns(ktime))
+			break;
+	list_add(&ev->list, &e->list);
+	if ((ztt->ti.flags & ZIO_STATUS) == ZIO_ENABLED)
+		ztt_program(ztt);
+	spin_unlock_irqrestore(&ztt->qlock, flags);
+	return 0;
+}
+
+/*
+ * Make the blocks that are due the active ones. If a channel still
+ * has an active block, its later blocks wait for the next expiration,
+ * but the due blocks of the other channels don't wait for it.
+ * Called with the cset lock and qlock held, when not armed.
+ */
+static void ztt_dequeue(struct ztt_instance *ztt)
+{
+	s64 now = ktime_to_ns(ktime_get_real());
+	struct ztt_event *ev, *tmp;
+
+	list_for_each_entry_safe(ev, tmp, &ztt->queue, list) {
+		if (ktime_to_ns(ev->time) > now)
+			break;
+		if (ev->chan->active_block)
+			continue; /* the queue stays in order for this channel */
+		zio_set_active_block(ev->chan, ev->block);
+		list_del(&ev->list);
+		kfree(ev);
+	}
+}
+
 /* This runs when the timer expires */
 static enum hrtimer_restart ztt_fn(struct hrtimer *timer)
 {
 	struct ztt_instance *ztt;
 	struct zio_ti *ti;
+	unsigned long flags;
+	int busy;
 
 	ztt = container_of(timer, struct ztt_instance, timer);
 	ti = &ztt->ti;
 
 	/* FIXME: fill the trigger attributes too */
 
-	ztt = to_ztt_instance(ti);
+	/* If the previous block is still playing, data_done reprograms */
+	spin_lock_irqsave(&ti->cset->lock, flags);
+	busy = ti->flags & ZIO_TI_ARMED;
+	spin_lock(&ztt->qlock);
+	if (!busy)
+		ztt_dequeue(ztt);
+	spin_unlock(&ztt->qlock);
+	spin_unlock_irqrestore(&ti->cset->lock, flags);
+
 	zio_arm_trigger(ti);
 
 	if (ztt->period) {
@@ -160,6 +273,13 @@ static enum hrtimer_restart ztt_fn(struct hrtimer *timer)
 	}
 
 	ztt->flags &= ~ZTT_FLAGS_PENDING;
+
+	/* Restarting from here is allowed, and races with push_block */
+	if (!busy) {
+		spin_lock_irqsave(&ztt->qlock, flags);
+		ztt_program(ztt);
+		spin_unlock_irqrestore(&ztt->qlock, flags);
+	}
 	return HRTIMER_NORESTART;
 }
 
@@ -170,37 +290,49 @@ static int ztt_push_block(struct zio_ti *ti, struct zio_channel *chan,
 			  struct zio_block *block)
 {
 	struct ztt_instance *ztt = to_ztt_instance(ti);
-	struct zio_control *ctrl;
 	ktime_t ktime;
-	int err;
 
 	pr_debug("%s:%d\n", __func__, __LINE__);
-	err = zio_generic_push_block(ti, chan, block);
-	if (err)
-		return err;
 
-	/* If it is already pending, we are done */
-	if (hrtimer_is_queued(&ztt->timer))
-		return 0;
-
-	/* If no timestamp provided in this control: we are done */
-	ctrl = zio_get_ctrl(block);
-	if (!ctrl->tstamp.secs && !ctrl->tstamp.ticks)
-		return 0;
+	/* If no timestamp provided in this control: next expiration */
+	if (!ztt_block_time(block, &ktime))
+		return zio_generic_push_block(ti, chan, block);
 
 	/*
-	 * Fire a new HR timer based on the stamp in this control block. For
+	 * Queue the block based on the stamp in its control. For
 	 * multi-channel cset, software is responsible for stamp consistency.
 	 */
-	if (ctrl->tstamp.secs) {
-		struct timespec ts = {ctrl->tstamp.secs, ctrl->tstamp.ticks};
-		ktime = timespec_to_ktime(ts);
-	} else {
-		ktime = ns_to_ktime(ctrl->tstamp.ticks);
+	return ztt_enqueue(ztt, chan, block, ktime);
+}
+
+/*
+ * Generic data_done, but for output the next blocks the generic code
+ * retrieved from the buffer (if push_block could not take them)
+ * are moved to the queue when they have a time stamp.
+ */
+static int ztt_data_done(struct zio_cset *cset)
+{
+	struct ztt_instance *ztt = to_ztt_instance(cset->ti);
+	struct zio_channel *chan;
+	struct zio_block *block;
+	ktime_t ktime;
+	int ret;
+
+	ret = zio_generic_data_done(cset);
+	if ((cset->flags & ZIO_DIR) == ZIO_DIR_INPUT)
+		return ret;
+
+	chan_for_each(chan, cset) {
+		while ((block = chan->active_block) &&
+		       ztt_block_time(block, &ktime) &&
+		       !ztt_enqueue(ztt, chan, block, ktime))
+			zio_set_active_block(chan,
+					zio_buffer_retr_block(chan->bi));
 	}
-	hrtimer_start_range_ns(&ztt->timer, ktime, ztt->slack,
-			       HRTIMER_MODE_ABS);
-	return 0;
+	spin_lock(&ztt->qlock);
+	ztt_program(ztt);
+	spin_unlock(&ztt->qlock);
+	return ret;
 }
 
 static int ztt_config(struct zio_ti *ti, struct zio_control *ctrl)
@@ -230,10 +362,33 @@ static struct zio_ti *ztt_create(struct zio_trigger_type *trig,
 	/* Fill own fields */
 	hrtimer_init(&ztt->timer, CLOCK_REALTIME, HRTIMER_MODE_ABS);
 	ztt->timer.function = ztt_fn;
+	spin_lock_init(&ztt->qlock);
+	INIT_LIST_HEAD(&ztt->queue);
 
 	return ti;
 }
 
+/*
+ * Return queued blocks to their buffer, which may be replaced after an
+ * abort. Free them out of qlock, as it nests within the bi lock.
+ */
+static void ztt_flush(struct zio_ti *ti)
+{
+	struct ztt_instance *ztt = to_ztt_instance(ti);
+	struct ztt_event *ev, *tmp;
+	unsigned long flags;
+	LIST_HEAD(queue);
+
+	spin_lock_irqsave(&ztt->qlock, flags);
+	list_splice_init(&ztt->queue, &queue);
+	spin_unlock_irqrestore(&ztt->qlock, flags);
+
+	list_for_each_entry_safe(ev, tmp, &queue, list) {
+		zio_buffer_free_block(ev->chan->bi, ev->block);
+		kfree(ev);
+	}
+}
+
 static void ztt_destroy(struct zio_ti *ti)
 {
 	struct ztt_instance *ztt;
@@ -241,6 +396,7 @@ static void ztt_destroy(struct zio_ti *ti)
 	pr_debug("%s:%d\n", __func__, __LINE__);
 	ztt = to_ztt_instance(ti);
 	hrtimer_cancel(&ztt->timer);
+	ztt_flush(ti);
 	kfree(ztt);
 }
 
@@ -255,8 +411,11 @@ static void ztt_change_status(struct zio_ti *ti, unsigned int status)
 		/* enable: it may be already configured and pending. */
 		if (ztt->flags & ZTT_FLAGS_PENDING)
 			hrtimer_restart(&ztt->timer);
-	} else {	/* disable */
-		hrtimer_cancel(&ztt->timer);
+		spin_lock(&ztt->qlock);
+		ztt_program(ztt);
+		spin_unlock(&ztt->qlock);
+	} else {	/* disable: we hold the cset lock, so don't wait */
+		hrtimer_try_to_cancel(&ztt->timer);
 	}
 }
 static const struct zio_trigger_operations ztt_trigger_ops = {
@@ -266,6 +425,8 @@ static const struct zio_trigger_operations ztt_trigger_ops = {
 	.create = ztt_create,
 	.destroy = ztt_destroy,
 	.change_status = ztt_change_status,
+	.data_done = ztt_data_done,
+	.flush = ztt_flush,
 };
 
 static struct zio_trigger_type ztt_trigger = {
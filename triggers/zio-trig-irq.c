@@ -3,6 +3,18 @@
 /*
  * This is a trigger based on an external IRQ. You can specify the IRQ
  * number or the GPIO number -- then the associated IRQ is used
+ *
+ * If the interrupt rate exceeds "coalesce-rate" events per second, the
+ * trigger switches to polling mode, like NAPI does for network devices:
+ * after each event the IRQ is masked, and a poll timer unmasks it every
+ * "poll-us" microseconds. Events happening while masked are coalesced
+ * into a single acquisition, replayed when we unmask. If the interrupt
+ * controller reports the line as pending at unmask time (kernel 4.5 and
+ * later), the replayed acquisition is counted in "coalesced" and reports
+ * LOST_TRIGGER; otherwise we can't tell and it is not counted.
+ * After "idle-polls" poll periods without events, we go back to normal
+ * interrupt operation. Please note that masking affects all instances
+ * of the trigger, because they share the same interrupt line.
  */
 
 #include <linux/kernel.h>
@@ -10,7 +22,11 @@
 #include <linux/init.h>
 #include <linux/slab.h>
 #include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/version.h>
 #include <linux/gpio.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
 
 #include <linux/zio.h>
 #include <linux/zio-sysfs.h>
@@ -22,13 +38,44 @@ static int zti_gpio = -1;
 module_param_named(irq, zti_irq, int, 0444);
 module_param_named(gpio, zti_gpio, int, 0444);
 
+/* The event rate is evaluated over windows of this length */
+#define ZTI_RATE_WINDOW_NS	(10 * NSEC_PER_MSEC)
+
+#define ZTI_FLAG_POLLING	0 /* bit numbers, for atomic bitops */
+#define ZTI_FLAG_MASKED		1
+#define ZTI_FLAG_REPLAY		2 /* next event was latched while masked */
+
+struct zti_instance {
+	struct zio_ti		ti;
+	struct hrtimer		poll_timer;
+	spinlock_t		lock; /* mask/unmask must match the flag */
+	ktime_t			window;
+	uint32_t		count; /* events in current window */
+	uint32_t		idle; /* poll periods without events */
+	uint32_t		coalesce_rate; /* events per second, 0 = never */
+	uint32_t		poll_us;
+	uint32_t		idle_polls;
+	uint32_t		coalesced; /* acquisitions for masked events */
+	unsigned long		flags;
+};
+#define to_zti_instance(ti) container_of(ti, struct zti_instance, ti)
+
 enum zti_attrs {
 	ZTI_ATTR_NSAMPLES = 0,
+	ZTI_ATTR_NSHOTS,
 	ZTI_ATTR_IRQ,
 	ZTI_ATTR_GPIO,
+	ZTI_ATTR_COALESCE_RATE,
+	ZTI_ATTR_POLL_US,
+	ZTI_ATTR_IDLE_POLLS,
+	ZTI_ATTR_COALESCED,
 };
 
 static ZIO_ATTR_DEFINE_STD(ZIO_TRG, zti_std_attr) = {
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_N_SHOTS, ZIO_RW_PERM,
+		 ZTI_ATTR_NSHOTS, 0),
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_PRE_SAMP, ZIO_RW_PERM,
+		 ZTI_ATTR_NSAMPLES, 0),
 	ZIO_ATTR(trig, ZIO_ATTR_TRIG_POST_SAMP, ZIO_RW_PERM,
 		 ZTI_ATTR_NSAMPLES, 16),
 };
@@ -36,25 +83,155 @@ static ZIO_ATTR_DEFINE_STD(ZIO_TRG, zti_std_attr) = {
 static struct zio_attribute zti_ext_attr[] = {
 	ZIO_ATTR_EXT("irq", ZIO_RO_PERM, ZTI_ATTR_IRQ, -1),
 	ZIO_ATTR_EXT("gpio", ZIO_RO_PERM, ZTI_ATTR_GPIO, -1),
+	ZIO_PARAM_EXT("coalesce-rate", ZIO_RW_PERM,
+		      ZTI_ATTR_COALESCE_RATE, 0 /* never poll */),
+	ZIO_PARAM_RNG("poll-us", ZIO_RW_PERM, ZTI_ATTR_POLL_US,
+		      100, 1, 1000 * 1000),
+	ZIO_PARAM_EXT("idle-polls", ZIO_RW_PERM, ZTI_ATTR_IDLE_POLLS, 2),
+	ZIO_PARAM_EXT("coalesced", ZIO_RO_PERM, ZTI_ATTR_COALESCED, 0),
 };
 static int zti_conf_set(struct device *dev, struct zio_attribute *zattr,
 		uint32_t  usr_val)
 {
+	struct zti_instance *zti = to_zti_instance(to_zio_ti(dev));
+
 	pr_debug("%s:%d\n", __func__, __LINE__);
+	switch (zattr->id) {
+	case ZTI_ATTR_COALESCE_RATE:
+		zti->coalesce_rate = usr_val;
+		break;
+	case ZTI_ATTR_POLL_US:
+		zti->poll_us = usr_val;
+		break;
+	case ZTI_ATTR_IDLE_POLLS:
+		zti->idle_polls = usr_val;
+		break;
+	default:
+		break;
+	}
 	zattr->value = usr_val;
 
 	return 0;
 }
 
+static int zti_info_get(struct device *dev, struct zio_attribute *zattr,
+			uint32_t *usr_val)
+{
+	struct zti_instance *zti = to_zti_instance(to_zio_ti(dev));
+
+	if (zattr->id == ZTI_ATTR_COALESCED)
+		*usr_val = zti->coalesced;
+	return 0;
+}
+
 static struct zio_sysfs_operations zti_s_ops = {
 	.conf_set = zti_conf_set,
+	.info_get = zti_info_get,
 };
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,5,0)
+/* Mask in hardware at disable time, so edges are latched as pending */
+static void zti_unlazy(int on)
+{
+	if (on)
+		irq_set_status_flags(zti_irq, IRQ_DISABLE_UNLAZY);
+	else
+		irq_clear_status_flags(zti_irq, IRQ_DISABLE_UNLAZY);
+}
+
+/* Whether the masked line saw an edge; if the chip can't tell, it didn't */
+static int zti_pending(void)
+{
+	bool pending;
+
+	if (irq_get_irqchip_state(zti_irq, IRQCHIP_STATE_PENDING, &pending))
+		return 0;
+	return pending;
+}
+#else
+static void zti_unlazy(int on) {}
+static int zti_pending(void) { return 0; }
+#endif
+
+/* The poll timer: unmask if we had an event, or go back to irq mode */
+static enum hrtimer_restart zti_poll(struct hrtimer *timer)
+{
+	struct zti_instance *zti;
+	unsigned long flags;
+
+	zti = container_of(timer, struct zti_instance, poll_timer);
+	spin_lock_irqsave(&zti->lock, flags);
+	/* The replay expected at the previous unmask did not happen */
+	clear_bit(ZTI_FLAG_REPLAY, &zti->flags);
+	if (test_and_clear_bit(ZTI_FLAG_MASKED, &zti->flags)) {
+		zti->idle = 0;
+		if (zti_pending())
+			set_bit(ZTI_FLAG_REPLAY, &zti->flags);
+		enable_irq(zti_irq); /* a pending event is replayed now */
+	} else if (++zti->idle >= zti->idle_polls) {
+		clear_bit(ZTI_FLAG_POLLING, &zti->flags);
+		spin_unlock_irqrestore(&zti->lock, flags);
+		return HRTIMER_NORESTART;
+	}
+	spin_unlock_irqrestore(&zti->lock, flags);
+	hrtimer_forward_now(timer, ns_to_ktime(zti->poll_us * NSEC_PER_USEC));
+	return HRTIMER_RESTART;
+}
+
+/* Account for an event: switch to polling mode if the rate is too high */
+static void zti_coalesce(struct zti_instance *zti)
+{
+	unsigned long flags;
+	ktime_t now;
+
+	spin_lock_irqsave(&zti->lock, flags);
+	if (!test_bit(ZTI_FLAG_POLLING, &zti->flags)) {
+		now = ktime_get();
+		if (ktime_to_ns(ktime_sub(now, zti->window)) >
+		    ZTI_RATE_WINDOW_NS) {
+			zti->window = now;
+			zti->count = 0;
+		}
+		if (++zti->count * (NSEC_PER_SEC / ZTI_RATE_WINDOW_NS) <=
+		    zti->coalesce_rate) {
+			spin_unlock_irqrestore(&zti->lock, flags);
+			return;
+		}
+		zti->idle = 0;
+		set_bit(ZTI_FLAG_POLLING, &zti->flags);
+		hrtimer_start(&zti->poll_timer,
+			      ns_to_ktime(zti->poll_us * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	}
+	/* Polling mode: keep the irq masked until next poll */
+	if (!test_and_set_bit(ZTI_FLAG_MASKED, &zti->flags))
+		disable_irq_nosync(zti_irq);
+	spin_unlock_irqrestore(&zti->lock, flags);
+}
+
+/* Events that arrived while masked have no acquisition of their own */
+static void zti_coalesced(struct zti_instance *zti)
+{
+	struct zio_cset *cset = zti->ti.cset;
+	struct zio_channel *chan;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cset->lock, flags);
+	zti->coalesced++;
+	chan_for_each(chan, cset)
+		chan->current_ctrl->zio_alarms |= ZIO_ALARM_LOST_TRIGGER;
+	spin_unlock_irqrestore(&cset->lock, flags);
+}
+
 static irqreturn_t zti_handler(int irq, void *dev_id)
 {
-	struct zio_ti *ti = dev_id;
+	struct zti_instance *zti = dev_id;
 
-	zio_arm_trigger(ti);
+	if (test_and_clear_bit(ZTI_FLAG_REPLAY, &zti->flags))
+		zti_coalesced(zti);
+	zio_arm_trigger(&zti->ti);
+	if (zti->coalesce_rate)
+		zti_coalesce(zti);
 	return IRQ_HANDLED;
 }
 
@@ -74,6 +251,7 @@ static struct zio_ti *zti_create(struct zio_trigger_type *trig,
 				 struct zio_cset *cset,
 				 struct zio_control *ctrl, fmode_t flags)
 {
+	struct zti_instance *zti;
 	struct zio_ti *ti;
 	int edges[] = {
 		IRQF_TRIGGER_FALLING | IRQF_TRIGGER_RISING,
@@ -85,22 +263,31 @@ static struct zio_ti *zti_create(struct zio_trigger_type *trig,
 
 	pr_debug("%s:%d\n", __func__, __LINE__);
 
-	ti = kzalloc(sizeof(*ti), GFP_ATOMIC);
-	if (!ti)
+	zti = kzalloc(sizeof(*zti), GFP_ATOMIC);
+	if (!zti)
 		return ERR_PTR(-ENOMEM);
+	ti = &zti->ti;
 	ti->flags = ZIO_DISABLED;
 	ti->cset = cset;
 
+	/* Fill own fields */
+	spin_lock_init(&zti->lock);
+	hrtimer_init(&zti->poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	zti->poll_timer.function = zti_poll;
+	zti->coalesce_rate = zti_ext_attr[2].value;
+	zti->poll_us = zti_ext_attr[3].value;
+	zti->idle_polls = zti_ext_attr[4].value;
+
 	/* Try all edge settings (gpio stuff prefers edges, but pci wants 0) */
 	for (i = 0; i < ARRAY_SIZE(edges); i++) {
 		ret = request_irq(zti_irq, zti_handler, IRQF_SHARED | edges[i],
-			  KBUILD_MODNAME, ti);
+			  KBUILD_MODNAME, zti);
 		if (ret == -EBUSY)
 			continue;
 		break; /* success or other error */
 	}
 	if (ret < 0) {
-		kfree(ti);
+		kfree(zti);
 		return ERR_PTR(ret);
 	}
 	return ti;
@@ -108,9 +295,17 @@ static struct zio_ti *zti_create(struct zio_trigger_type *trig,
 
 static void zti_destroy(struct zio_ti *ti)
 {
+	struct zti_instance *zti = to_zti_instance(ti);
+
 	pr_debug("%s:%d\n", __func__, __LINE__);
-	free_irq(zti_irq, ti);
-	kfree(ti);
+	/* Stop polling, and leave the irq unmasked for other instances */
+	zti->coalesce_rate = 0;
+	synchronize_irq(zti_irq);
+	hrtimer_cancel(&zti->poll_timer);
+	if (test_and_clear_bit(ZTI_FLAG_MASKED, &zti->flags))
+		enable_irq(zti_irq);
+	free_irq(zti_irq, zti);
+	kfree(zti);
 }
 
 static const struct zio_trigger_operations zti_trigger_ops = {
@@ -171,12 +366,17 @@ static int __init zti_init(void)
 	int ret = zti_validate(zti_irq, zti_gpio);
 	if (ret)
 		return ret;
-	return zio_register_trig(&zti_trigger, "irq");
+	zti_unlazy(1);
+	ret = zio_register_trig(&zti_trigger, "irq");
+	if (ret)
+		zti_unlazy(0);
+	return ret;
 }
 
 static void __exit zti_exit(void)
 {
 	zio_unregister_trig(&zti_trigger);
+	zti_unlazy(0);
 	if (zti_gpio != -1)
 		gpio_free(zti_gpio);
 }
@@ -0,0 +1,366 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * This is a data-driven trigger: it looks at the samples of one channel
+ * of a free-running cset, and fires when they cross a level, or their
+ * slope does, or they leave a window. It works in history mode only
+ * (see "history-chunk" in the cset, that must be set first), so the
+ * blocks it stores are made of pre-samples and post-samples around events.
+ *
+ * After firing, the trigger is re-armed only when the signal goes back
+ * beyond the hysteresis, so noise around the level is not a new event.
+ * Samples are 8, 16 or 32 bits, signed unless so configured; levels are
+ * then unsigned too, while slopes (differences) are always signed.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/log2.h>
+
+#include <linux/zio.h>
+#include <linux/zio-sysfs.h>
+#include <linux/zio-buffer.h>
+#include <linux/zio-trigger.h>
+
+enum ztl_mode {
+	ZTL_MODE_RISING = 0,	/* sample goes above level */
+	ZTL_MODE_FALLING,	/* sample goes below level */
+	ZTL_MODE_WINDOW,	/* sample leaves [level, level-high] */
+	ZTL_MODE_SLOPE_RISING,	/* difference goes above level */
+	ZTL_MODE_SLOPE_FALLING,	/* difference goes below level */
+	ZTL_MODE_LAST = ZTL_MODE_SLOPE_FALLING,
+};
+
+/* Wider than any sample or difference of samples */
+#define ZTL_MIN (-(1LL << 40))
+#define ZTL_MAX (1LL << 40)
+
+struct ztl_instance {
+	struct zio_ti ti;
+	uint32_t channel;
+	uint32_t mode;
+	uint32_t level, level_high; /* see ztl_level */
+	int32_t hysteresis;
+	uint32_t is_unsigned;
+	/* The ranges to arm and fire, derived from the above */
+	int64_t arm_min, arm_max, fire_min, fire_max;
+	int armed;
+	int has_prev;
+	int warned; /* about a disabled channel */
+	int64_t prev; /* last sample of previous chunk, for slope */
+};
+#define to_ztl_instance(ti) container_of(ti, struct ztl_instance, ti)
+
+enum ztl_attrs { /* names for the "addr" value of sw parameters */
+	ZTL_ATTR_NSAMPLES = 0,
+	ZTL_ATTR_NSHOTS,
+	ZTL_ATTR_CHANNEL,
+	ZTL_ATTR_MODE,
+	ZTL_ATTR_LEVEL,
+	ZTL_ATTR_LEVEL_HIGH,
+	ZTL_ATTR_HYSTERESIS,
+	ZTL_ATTR_UNSIGNED,
+};
+
+static ZIO_ATTR_DEFINE_STD(ZIO_TRG, ztl_std_attr) = {
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_N_SHOTS, ZIO_RW_PERM,
+		 ZTL_ATTR_NSHOTS, 0),
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_PRE_SAMP, ZIO_RW_PERM,
+		 ZTL_ATTR_NSAMPLES, 16),
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_POST_SAMP, ZIO_RW_PERM,
+		 ZTL_ATTR_NSAMPLES, 16),
+};
+
+static struct zio_attribute ztl_ext_attr[] = {
+	ZIO_ATTR_EXT("channel", ZIO_RW_PERM, ZTL_ATTR_CHANNEL, 0),
+	ZIO_ATTR_EXT_RNG("mode", ZIO_RW_PERM, ZTL_ATTR_MODE,
+			 ZTL_MODE_RISING, 0, ZTL_MODE_LAST),
+	ZIO_ATTR_EXT("level", ZIO_RW_PERM, ZTL_ATTR_LEVEL, 0),
+	ZIO_ATTR_EXT("level-high", ZIO_RW_PERM, ZTL_ATTR_LEVEL_HIGH, 0),
+	ZIO_ATTR_EXT("hysteresis", ZIO_RW_PERM, ZTL_ATTR_HYSTERESIS, 0),
+	ZIO_ATTR_EXT_RNG("unsigned", ZIO_RW_PERM, ZTL_ATTR_UNSIGNED,
+			 0, 0, 1),
+};
+
+/*
+ * The scanning loops, one per sample type. Each looks for the first
+ * sample (or difference) inside the range [a, a + w], or outside of it,
+ * with a single unsigned comparison per sample. The caller selects
+ * the loop once per chunk, not once per sample.
+ */
+#define ZTL_FIND(_type)							\
+static unsigned int ztl_find_##_type(void *data, unsigned int i,	\
+				     unsigned int n, int64_t prev,	\
+				     int64_t a, uint64_t w, int in,	\
+				     int diff)				\
+{									\
+	_type *x = data;						\
+									\
+	if (diff) {							\
+		if (i)							\
+			prev = x[i - 1];				\
+		for (; i < n; prev = x[i++])				\
+			if (((uint64_t)(x[i] - prev - a) <= w) == in)	\
+				break;					\
+		return i;						\
+	}								\
+	for (; i < n; i++)						\
+		if (((uint64_t)(x[i] - a) <= w) == in)			\
+			break;						\
+	return i;							\
+}
+
+ZTL_FIND(s8)
+ZTL_FIND(u8)
+ZTL_FIND(s16)
+ZTL_FIND(u16)
+ZTL_FIND(s32)
+ZTL_FIND(u32)
+
+typedef unsigned int (*ztl_find_t)(void *data, unsigned int i,
+				   unsigned int n, int64_t prev,
+				   int64_t a, uint64_t w, int in, int diff);
+
+static const ztl_find_t ztl_find[2][3] = { /* [unsigned][ssize order] */
+	{ztl_find_s8, ztl_find_s16, ztl_find_s32},
+	{ztl_find_u8, ztl_find_u16, ztl_find_u32},
+};
+
+static int64_t ztl_sample(struct ztl_instance *ztl, void *data,
+			  unsigned int ssize)
+{
+	switch (ssize) {
+	case 1:
+		return ztl->is_unsigned ? *(u8 *)data : *(s8 *)data;
+	case 2:
+		return ztl->is_unsigned ? *(u16 *)data : *(s16 *)data;
+	default:
+		return ztl->is_unsigned ? *(u32 *)data : *(s32 *)data;
+	}
+}
+
+/* Levels are sample values, unsigned if samples are; slopes are signed */
+static int64_t ztl_level(struct ztl_instance *ztl, uint32_t val)
+{
+	if (ztl->is_unsigned && ztl->mode < ZTL_MODE_SLOPE_RISING)
+		return val;
+	return (int32_t)val;
+}
+
+/* Recalculate ranges after configuration: the trigger is disabled now */
+static void ztl_update(struct ztl_instance *ztl)
+{
+	int64_t level = ztl_level(ztl, ztl->level);
+	int64_t level_high = ztl_level(ztl, ztl->level_high);
+	int64_t hyst = abs(ztl->hysteresis);
+
+	switch (ztl->mode) {
+	case ZTL_MODE_RISING:
+	case ZTL_MODE_SLOPE_RISING:
+		ztl->arm_min = ZTL_MIN;
+		ztl->arm_max = level - hyst;
+		ztl->fire_min = ZTL_MIN;
+		ztl->fire_max = level;
+		break;
+	case ZTL_MODE_FALLING:
+	case ZTL_MODE_SLOPE_FALLING:
+		ztl->arm_min = level + hyst;
+		ztl->arm_max = ZTL_MAX;
+		ztl->fire_min = level;
+		ztl->fire_max = ZTL_MAX;
+		break;
+	case ZTL_MODE_WINDOW:
+		ztl->arm_min = level + hyst;
+		ztl->arm_max = level_high - hyst;
+		ztl->fire_min = level;
+		ztl->fire_max = level_high;
+		break;
+	}
+	ztl->armed = 0;
+	ztl->has_prev = 0;
+	ztl->warned = 0;
+}
+
+static int ztl_conf_set(struct device *dev, struct zio_attribute *zattr,
+			uint32_t usr_val)
+{
+	struct ztl_instance *ztl = to_ztl_instance(to_zio_ti(dev));
+
+	switch (zattr->id) {
+	case ZTL_ATTR_NSAMPLES:
+	case ZTL_ATTR_NSHOTS:
+		/* Nothing to do */
+		return 0;
+	case ZTL_ATTR_CHANNEL:
+		if (usr_val >= ztl->ti.cset->n_chan)
+			return -EINVAL;
+		ztl->channel = usr_val;
+		break;
+	case ZTL_ATTR_MODE:
+		ztl->mode = usr_val;
+		break;
+	case ZTL_ATTR_LEVEL:
+		ztl->level = usr_val;
+		break;
+	case ZTL_ATTR_LEVEL_HIGH:
+		ztl->level_high = usr_val;
+		break;
+	case ZTL_ATTR_HYSTERESIS:
+		ztl->hysteresis = usr_val;
+		break;
+	case ZTL_ATTR_UNSIGNED:
+		ztl->is_unsigned = usr_val;
+		break;
+	default:
+		pr_err("%s: unknown \"addr\" 0x%lx for configuration\n",
+				__func__, zattr->id);
+		return -EINVAL;
+	}
+	ztl_update(ztl);
+	return 0;
+}
+
+static struct zio_sysfs_operations ztl_s_ops = {
+	.conf_set = ztl_conf_set,
+};
+
+/*
+ * Called by the core with the cset lock held, for every chunk. We go
+ * on scanning after the first event, to keep the hysteresis state
+ * right for the next chunk; later events in the chunk are dead time.
+ */
+static int ztl_scan(struct zio_ti *ti, unsigned int n)
+{
+	struct ztl_instance *ztl = to_ztl_instance(ti);
+	struct zio_channel *chan = &ti->cset->chan[ztl->channel];
+	struct zio_block *block = chan->active_block;
+	int diff = ztl->mode >= ZTL_MODE_SLOPE_RISING;
+	unsigned int i = 0, ssize = chan->current_ctrl->ssize;
+	ztl_find_t find;
+	int event = -1;
+	int64_t prev;
+
+	if (!test_bit(chan->index, ti->cset->chan_enabled)) {
+		if (!ztl->warned)
+			dev_warn(&ti->head.dev, "channel %i is disabled\n",
+				 chan->index);
+		ztl->warned = 1;
+		return -1;
+	}
+	if (!block || !n || (ssize != 1 && ssize != 2 && ssize != 4))
+		return -1;
+	find = ztl_find[!!ztl->is_unsigned][ilog2(ssize)];
+	if (diff && !ztl->has_prev) { /* first sample ever: no slope */
+		ztl->prev = ztl_sample(ztl, block->data, ssize);
+		ztl->has_prev = 1;
+	}
+	prev = ztl->prev;
+
+	while (i < n) {
+		if (!ztl->armed) {
+			if (ztl->arm_max < ztl->arm_min)
+				break; /* hysteresis larger than window */
+			i = find(block->data, i, n, prev, ztl->arm_min,
+				 ztl->arm_max - ztl->arm_min, 1, diff);
+			if (i == n)
+				break;
+			ztl->armed = 1;
+		}
+		i = find(block->data, i, n, prev, ztl->fire_min,
+			 ztl->fire_max - ztl->fire_min, 0, diff);
+		if (i == n)
+			break;
+		ztl->armed = 0;
+		if (event < 0)
+			event = i;
+	}
+
+	/* keep the last sample, for the slope at next chunk */
+	if (diff)
+		ztl->prev = ztl_sample(ztl, block->data + (n - 1) * ssize,
+				       ssize);
+	return event;
+}
+
+static struct zio_ti *ztl_create(struct zio_trigger_type *trig,
+				 struct zio_cset *cset,
+				 struct zio_control *ctrl, fmode_t flags)
+{
+	struct ztl_instance *ztl;
+	struct zio_ti *ti;
+
+	pr_debug("%s:%d\n", __func__, __LINE__);
+
+	if ((cset->flags & ZIO_DIR) == ZIO_DIR_OUTPUT)
+		return ERR_PTR(-EINVAL);
+	if (!cset->history) {
+		dev_err(&cset->head.dev,
+			"trigger \"level\" needs history-chunk to be set\n");
+		return ERR_PTR(-EINVAL);
+	}
+	ztl = kzalloc(sizeof(struct ztl_instance), GFP_ATOMIC);
+	if (!ztl)
+		return ERR_PTR(-ENOMEM);
+	ti = &ztl->ti;
+	ti->flags = ZIO_DISABLED;
+	ti->cset = cset;
+
+	/* Fill own fields */
+	ztl->channel = ztl_ext_attr[0].value;
+	ztl->mode = ztl_ext_attr[1].value;
+	ztl->level = ztl_ext_attr[2].value;
+	ztl->level_high = ztl_ext_attr[3].value;
+	ztl->hysteresis = ztl_ext_attr[4].value;
+	ztl->is_unsigned = ztl_ext_attr[5].value;
+	ztl_update(ztl);
+
+	return ti;
+}
+
+static void ztl_destroy(struct zio_ti *ti)
+{
+	pr_debug("%s:%d\n", __func__, __LINE__);
+	kfree(to_ztl_instance(ti));
+}
+
+static const struct zio_trigger_operations ztl_trigger_ops = {
+	.push_block = zio_generic_push_block,
+	.create = ztl_create,
+	.destroy = ztl_destroy,
+	.scan = ztl_scan,
+};
+
+static struct zio_trigger_type ztl_trigger = {
+	.owner = THIS_MODULE,
+	.zattr_set = {
+		.std_zattr = ztl_std_attr,
+		.ext_zattr = ztl_ext_attr,
+		.n_ext_attr = ARRAY_SIZE(ztl_ext_attr),
+	},
+	.s_op = &ztl_s_ops,
+	.t_op = &ztl_trigger_ops,
+};
+
+/*
+ * init and exit
+ */
+static int __init ztl_init(void)
+{
+	return zio_register_trig(&ztl_trigger, "level");
+}
+
+static void __exit ztl_exit(void)
+{
+	zio_unregister_trig(&ztl_trigger);
+}
+
+module_init(ztl_init);
+module_exit(ztl_exit);
+
+MODULE_VERSION(GIT_VERSION); /* Defined in local Makefile */
+MODULE_AUTHOR("Alessandro Rubini");
+MODULE_LICENSE("GPL");
+
+ADDITIONAL_VERSIONS;
@@ -0,0 +1,310 @@
+/* Copyright 2026 CERN, GNU GPLv2 or later */
+
+/*
+ * This is a pacing trigger for output csets. Like the user trigger, it
+ * fires when all enabled channels have a block, but it releases blocks
+ * at a configured rate: a token bucket is refilled at "rate" blocks
+ * (or samples, if "rate-samples" is set) per second, up to "burst",
+ * and each block costs one token (or one per sample). If user space
+ * is late and the buffer drains while streaming, an underrun is counted
+ * and reported as ZIO_ALARM_UNDERRUN.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+
+#include <linux/zio.h>
+#include <linux/zio-sysfs.h>
+#include <linux/zio-buffer.h>
+#include <linux/zio-trigger.h>
+
+struct ztp_instance {
+	struct zio_ti		ti;
+	struct hrtimer		timer;
+	spinlock_t		lock; /* for the bucket; nests in cset lock */
+	uint32_t		rate; /* units per second */
+	uint32_t		burst; /* units */
+	uint32_t		samples; /* the unit is a sample, not a block */
+	uint32_t		underruns;
+	uint64_t		tokens; /* units * NSEC_PER_SEC */
+	ktime_t			last; /* last refill */
+	int			streaming, starved;
+};
+#define to_ztp_instance(ti) container_of(ti, struct ztp_instance, ti)
+
+enum ztp_attrs { /* names for the "addr" value of sw parameters */
+	ZTP_ATTR_NSAMPLES = 0,
+	ZTP_ATTR_NSHOTS,
+	ZTP_ATTR_RATE,
+	ZTP_ATTR_BURST,
+	ZTP_ATTR_SAMPLES,
+	ZTP_ATTR_UNDERRUNS,
+};
+
+static ZIO_ATTR_DEFINE_STD(ZIO_TRG, ztp_std_attr) = {
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_N_SHOTS, ZIO_RW_PERM,
+		 ZTP_ATTR_NSHOTS, 0),
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_POST_SAMP, ZIO_RW_PERM,
+		 ZTP_ATTR_NSAMPLES, 16),
+};
+
+static struct zio_attribute ztp_ext_attr[] = {
+	ZIO_ATTR_EXT_RNG("rate", ZIO_RW_PERM, ZTP_ATTR_RATE, 100,
+			 1, 0xffffffff),
+	ZIO_ATTR_EXT_RNG("burst", ZIO_RW_PERM, ZTP_ATTR_BURST, 1,
+			 1, 0xffffffff),
+	ZIO_ATTR_EXT_RNG("rate-samples", ZIO_RW_PERM, ZTP_ATTR_SAMPLES, 0,
+			 0, 1),
+	ZIO_PARAM_EXT("underruns", ZIO_RO_PERM, ZTP_ATTR_UNDERRUNS, 0),
+};
+
+static int ztp_conf_set(struct device *dev, struct zio_attribute *zattr,
+			uint32_t usr_val)
+{
+	struct ztp_instance *ztp = to_ztp_instance(to_zio_ti(dev));
+	unsigned long flags;
+
+	spin_lock_irqsave(&ztp->lock, flags);
+	switch (zattr->id) {
+	case ZTP_ATTR_RATE:
+		ztp->rate = usr_val;
+		break;
+	case ZTP_ATTR_BURST:
+		ztp->burst = usr_val;
+		break;
+	case ZTP_ATTR_SAMPLES:
+		ztp->samples = usr_val;
+		break;
+	case ZTP_ATTR_NSAMPLES:
+	case ZTP_ATTR_NSHOTS:
+		/* Nothing to do */
+		break;
+	default:
+		spin_unlock_irqrestore(&ztp->lock, flags);
+		pr_err("%s: unknown \"addr\" 0x%lx for configuration\n",
+				__func__, zattr->id);
+		return -EINVAL;
+	}
+	spin_unlock_irqrestore(&ztp->lock, flags);
+	return 0;
+}
+
+static int ztp_info_get(struct device *dev, struct zio_attribute *zattr,
+			uint32_t *usr_val)
+{
+	struct ztp_instance *ztp = to_ztp_instance(to_zio_ti(dev));
+
+	if (zattr->id == ZTP_ATTR_UNDERRUNS)
+		*usr_val = ztp->underruns;
+	return 0;
+}
+
+static struct zio_sysfs_operations ztp_s_ops = {
+	.conf_set = ztp_conf_set,
+	.info_get = ztp_info_get,
+};
+
+/* The cost of the blocks that are ready, in units * NSEC_PER_SEC */
+static uint64_t ztp_cost(struct ztp_instance *ztp)
+{
+	struct zio_channel *chan;
+
+	if (ztp->samples) {
+		chan_for_each(chan, ztp->ti.cset)
+			return (uint64_t)zio_get_ctrl(chan->active_block)->
+				nsamples * NSEC_PER_SEC;
+	}
+	return NSEC_PER_SEC;
+}
+
+static void ztp_refill(struct ztp_instance *ztp, uint64_t max)
+{
+	ktime_t now = ktime_get();
+	uint64_t dt = ktime_to_ns(ktime_sub(now, ztp->last));
+
+	ztp->last = now;
+	if (ztp->tokens >= max)
+		return;
+	if (dt >= div64_u64(max - ztp->tokens, ztp->rate))
+		ztp->tokens = max;
+	else
+		ztp->tokens += dt * ztp->rate;
+}
+
+/*
+ * All channels have a block: take the tokens and return 1 to fire,
+ * or return 0 and program the timer for when tokens are enough.
+ */
+static int ztp_take(struct ztp_instance *ztp)
+{
+	uint64_t cost, wait;
+	unsigned long flags;
+	int ret = 1;
+
+	spin_lock_irqsave(&ztp->lock, flags);
+	cost = ztp_cost(ztp);
+	/* A block larger than the burst is allowed when the bucket is full */
+	ztp_refill(ztp, max((uint64_t)ztp->burst * NSEC_PER_SEC, cost));
+	if (ztp->tokens >= cost) {
+		ztp->tokens -= cost;
+		ztp->streaming = 1;
+		ztp->starved = 0;
+	} else {
+		wait = div64_u64(cost - ztp->tokens + ztp->rate - 1,
+				 ztp->rate);
+		hrtimer_start(&ztp->timer, ktime_add_ns(ztp->last, wait),
+			      HRTIMER_MODE_ABS);
+		ret = 0;
+	}
+	spin_unlock_irqrestore(&ztp->lock, flags);
+	return ret;
+}
+
+/* This runs when the tokens for the pending blocks are there */
+static enum hrtimer_restart ztp_fn(struct hrtimer *timer)
+{
+	struct ztp_instance *ztp;
+
+	ztp = container_of(timer, struct ztp_instance, timer);
+	if (zio_all_block_ready(ztp->ti.cset) && ztp_take(ztp))
+		zio_arm_trigger(&ztp->ti);
+	return HRTIMER_NORESTART;
+}
+
+/* Called with the cset lock held */
+static int ztp_data_done(struct zio_cset *cset)
+{
+	struct ztp_instance *ztp = to_ztp_instance(cset->ti);
+	struct zio_channel *chan;
+
+	zio_generic_data_done(cset); /* it retrieved the next blocks */
+	if (zio_all_block_ready(cset))
+		return ztp_take(ztp);
+
+	/* The buffer drained: count once, until we stream again */
+	if (ztp->streaming && !ztp->starved) {
+		ztp->starved = 1;
+		ztp->underruns++;
+		chan_for_each(chan, cset)
+			chan->current_ctrl->zio_alarms |= ZIO_ALARM_UNDERRUN;
+	}
+	return 0;
+}
+
+/* The buffer pushes a block if it has none queued and one is written */
+static int ztp_push_block(struct zio_ti *ti, struct zio_channel *chan,
+			  struct zio_block *block)
+{
+	int err;
+
+	pr_debug("%s:%d\n", __func__, __LINE__);
+	err = zio_generic_push_block(ti, chan, block);
+	if (err)
+		return err;
+
+	if (zio_all_block_ready(chan->cset) && ztp_take(to_ztp_instance(ti)))
+		zio_arm_trigger(ti);
+	return 0;
+}
+
+static struct zio_ti *ztp_create(struct zio_trigger_type *trig,
+				 struct zio_cset *cset,
+				 struct zio_control *ctrl, fmode_t flags)
+{
+	struct ztp_instance *ztp;
+	struct zio_ti *ti;
+
+	pr_debug("%s:%d\n", __func__, __LINE__);
+
+	if ((cset->flags & ZIO_DIR) == ZIO_DIR_INPUT)
+		return ERR_PTR(-EINVAL);
+	ztp = kzalloc(sizeof(struct ztp_instance), GFP_ATOMIC);
+	if (!ztp)
+		return ERR_PTR(-ENOMEM);
+	ti = &ztp->ti;
+	ti->flags = ZIO_DISABLED;
+	ti->cset = cset;
+
+	/* Fill own fields */
+	hrtimer_init(&ztp->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	ztp->timer.function = ztp_fn;
+	spin_lock_init(&ztp->lock);
+	ztp->rate = ztp_ext_attr[0].value;
+	ztp->burst = ztp_ext_attr[1].value;
+	ztp->samples = ztp_ext_attr[2].value;
+
+	return ti;
+}
+
+static void ztp_destroy(struct zio_ti *ti)
+{
+	struct ztp_instance *ztp = to_ztp_instance(ti);
+
+	pr_debug("%s:%d\n", __func__, __LINE__);
+	hrtimer_cancel(&ztp->timer);
+	kfree(ztp);
+}
+
+static void ztp_change_status(struct zio_ti *ti, unsigned int status)
+{
+	struct ztp_instance *ztp = to_ztp_instance(ti);
+
+	pr_debug("%s:%d status=%d\n", __func__, __LINE__, status);
+
+	spin_lock(&ztp->lock);
+	if (!status) { /* enable: start with a full bucket */
+		ztp->tokens = (uint64_t)ztp->burst * NSEC_PER_SEC;
+		ztp->last = ktime_get();
+	} else { /* disable: we hold the cset lock, so don't wait */
+		hrtimer_try_to_cancel(&ztp->timer);
+		ztp->streaming = 0;
+	}
+	spin_unlock(&ztp->lock);
+}
+
+static const struct zio_trigger_operations ztp_trigger_ops = {
+	.push_block = ztp_push_block,
+	.create = ztp_create,
+	.destroy = ztp_destroy,
+	.change_status = ztp_change_status,
+	.data_done = ztp_data_done,
+};
+
+static struct zio_trigger_type ztp_trigger = {
+	.owner = THIS_MODULE,
+	.zattr_set = {
+		.std_zattr = ztp_std_attr,
+		.ext_zattr = ztp_ext_attr,
+		.n_ext_attr = ARRAY_SIZE(ztp_ext_attr),
+	},
+	.s_op = &ztp_s_ops,
+	.t_op = &ztp_trigger_ops,
+};
+
+/*
+ * init and exit
+ */
+static int __init ztp_init(void)
+{
+	return zio_register_trig(&ztp_trigger, "pace");
+}
+
+static void __exit ztp_exit(void)
+{
+	zio_unregister_trig(&ztp_trigger);
+}
+
+module_init(ztp_init);
+module_exit(ztp_exit);
+
+MODULE_VERSION(GIT_VERSION); /* Defined in local Makefile */
+MODULE_AUTHOR("Alessandro Rubini");
+MODULE_LICENSE("GPL");
+
+ADDITIONAL_VERSIONS;
@@ -4,6 +4,14 @@
  * This is a timer-based trigger for the ZIO framework. It is not
  * specific to a low-level device (every device can use it) and clearly
  * multi-instance.
+ *
+ * The trigger is periodic, and it is built on a high-resolution timer
+ * programmed with absolute expiration times: the next expiration is
+ * always the previous one plus the period, so delays in serving the
+ * timer do not accumulate as phase error. If one or more periods are
+ * lost (because the system was busy), they are counted and reported as
+ * ZIO_ALARM_LOST_TRIGGER; if so requested, the lost acquisitions are
+ * replayed back-to-back instead.
  */
 
 #include <linux/kernel.h>
@@ -11,8 +19,9 @@
 #include <linux/moduleparam.h>
 #include <linux/init.h>
 #include <linux/slab.h>
-#include <linux/timer.h>
-#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
 
 #include <linux/zio.h>
 #include <linux/zio-sysfs.h>
@@ -21,20 +30,32 @@
 
 struct ztt_instance {
 	struct zio_ti ti;
-	struct timer_list timer;
-	unsigned long next_run;
-	unsigned long period; /* internal: jiffies */
-	unsigned long phase; /* internal: jiffies */
+	struct hrtimer timer;
+	uint64_t period; /* internal: ns */
+	uint64_t phase; /* internal: ns */
+	uint32_t catch_up; /* max number of lost periods to replay */
+	uint32_t missed; /* lost periods, since creation */
+	int stopped; /* disabled by change_status */
 };
 #define to_ztt_instance(ti) container_of(ti, struct ztt_instance, ti)
 
 enum ztt_attrs { /* names for the "addr" value of sw parameters */
 	ZTT_ATTR_NSAMPLES = 0,
+	ZTT_ATTR_NSHOTS,
 	ZTT_ATTR_PERIOD,
 	ZTT_ATTR_PHASE,
+	ZTT_ATTR_CATCH_UP,
+	ZTT_ATTR_MISSED,
 };
 
+/* Replaying runs in the timer callback: keep it short */
+#define ZTT_CATCH_UP_MAX	16
+
 static ZIO_ATTR_DEFINE_STD(ZIO_TRG, ztt_std_attr) = {
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_N_SHOTS, ZIO_RW_PERM,
+		 ZTT_ATTR_NSHOTS, 0),
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_PRE_SAMP, ZIO_RW_PERM,
+		 ZTT_ATTR_NSAMPLES, 0),
 	ZIO_ATTR(trig, ZIO_ATTR_TRIG_POST_SAMP, ZIO_RW_PERM,
 		 ZTT_ATTR_NSAMPLES, 16),
 };
@@ -42,25 +63,22 @@ static ZIO_ATTR_DEFINE_STD(ZIO_TRG, ztt_std_attr) = {
 static struct zio_attribute ztt_ext_attr[] = {
 	ZIO_ATTR_EXT("ms-period", ZIO_RW_PERM, ZTT_ATTR_PERIOD, 2000),
 	ZIO_ATTR_EXT("ms-phase", ZIO_RW_PERM, ZTT_ATTR_PHASE, 0),
+	ZIO_PARAM_RNG("catch-up", ZIO_RW_PERM, ZTT_ATTR_CATCH_UP, 0,
+		      0, ZTT_CATCH_UP_MAX),
+	ZIO_PARAM_EXT("missed", ZIO_RO_PERM, ZTT_ATTR_MISSED, 0),
 };
 
-/* This recalculates next_run according to period and phase */
+/* This recalculates the expiration time according to period and phase */
 static void ztt_resync(struct ztt_instance *ztt)
 {
-	unsigned long next_run = ztt->next_run;
-	unsigned long this_phase = next_run % ztt->period;
-
-	if (this_phase == ztt->phase)
-		return; /* current expire time ok, and in the future */
-	next_run -= this_phase;
-	next_run += ztt->phase;
+	uint64_t now = ktime_to_ns(ktime_get_real());
+	uint64_t next_run;
 
-	/* select the first expiration */
-	next_run -= ztt->period;
-	while (next_run <= jiffies)
+	/* select the first expiration in the future */
+	next_run = div64_u64(now, ztt->period) * ztt->period + ztt->phase;
+	while (next_run <= now)
 		next_run += ztt->period;
-	ztt->next_run = next_run;
-	mod_timer(&ztt->timer, ztt->next_run);
+	hrtimer_start(&ztt->timer, ns_to_ktime(next_run), HRTIMER_MODE_ABS);
 }
 
 static int ztt_conf_set(struct device *dev, struct zio_attribute *zattr,
@@ -68,7 +86,6 @@ static int ztt_conf_set(struct device *dev, struct zio_attribute *zattr,
 {
 	struct zio_ti *ti = to_zio_ti(dev);
 	struct ztt_instance *ztt;
-	unsigned long jval;
 
 	pr_debug("%s:%d\n", __func__, __LINE__);
 	ztt = to_ztt_instance(ti);
@@ -76,12 +93,12 @@ static int ztt_conf_set(struct device *dev, struct zio_attribute *zattr,
 	case ZTT_ATTR_PERIOD:
 		/*
 		 * Writing the period doesn't force a resync,
-		 * in order to allow for a slowly-changing rate
+		 * in order to allow for a slowly-changing rate:
+		 * the new period is used from the next expiration
 		 */
-		jval =  msecs_to_jiffies(usr_val);
-		if ((signed)jval < 1)
+		if (!usr_val)
 			return -EINVAL;
-		ztt->period = jval;
+		ztt->period = (uint64_t)usr_val * NSEC_PER_MSEC;
 		break;
 	case ZTT_ATTR_PHASE:
 		/*
@@ -89,13 +106,15 @@ static int ztt_conf_set(struct device *dev, struct zio_attribute *zattr,
 		 * in a glitch if you already changed the period.
 		 * For finer control please use the hrt trigger
 		 */
-		jval =  msecs_to_jiffies(usr_val);
-		if ((signed)jval < 0)
-			return -EINVAL;
-		ztt->phase = jval % ztt->period;
+		ztt->phase = (uint64_t)usr_val * NSEC_PER_MSEC;
+		ztt->phase -= div64_u64(ztt->phase, ztt->period) * ztt->period;
 		ztt_resync(ztt);
 		break;
+	case ZTT_ATTR_CATCH_UP:
+		ztt->catch_up = usr_val;
+		break;
 	case ZTT_ATTR_NSAMPLES:
+	case ZTT_ATTR_NSHOTS:
 		/* Nothing to do */
 		break;
 	default:
@@ -106,24 +125,68 @@ static int ztt_conf_set(struct device *dev, struct zio_attribute *zattr,
 	return 0;
 }
 
+static int ztt_info_get(struct device *dev, struct zio_attribute *zattr,
+			uint32_t *usr_val)
+{
+	struct ztt_instance *ztt = to_ztt_instance(to_zio_ti(dev));
+
+	if (zattr->id == ZTT_ATTR_MISSED)
+		*usr_val = ztt->missed;
+	return 0;
+}
+
 static struct zio_sysfs_operations ztt_s_ops = {
 	.conf_set = ztt_conf_set,
+	.info_get = ztt_info_get,
 };
 
-/* This runs when the timer expires */
-static void ztt_fn(unsigned long arg)
+/*
+ * Count lost periods and, unless they are replayed, raise the alarm.
+ * A replay only happens if the previous arm is over (the device is not
+ * self-timed): an arm of an armed trigger is a no-op, so it is lost.
+ */
+static void ztt_lost_periods(struct ztt_instance *ztt, unsigned long n)
 {
-	struct zio_ti *ti = (void *)arg;
-	struct ztt_instance *ztt;
-
-	zio_arm_trigger(ti);
+	struct zio_cset *cset = ztt->ti.cset;
+	struct zio_channel *chan;
+	unsigned long flags, i;
+
+	ztt->missed += n;
+	for (i = 0; i < n && i < ztt->catch_up; i++) {
+		if (ztt->ti.flags & (ZIO_DISABLED | ZIO_TI_ARMED))
+			break;
+		zio_arm_trigger(&ztt->ti);
+	}
+	if (i == n)
+		return;
 
-	ztt = to_ztt_instance(ti);
-	if (!ztt->period)
-		return; /* one-shot */
+	spin_lock_irqsave(&cset->lock, flags);
+	chan_for_each(chan, cset)
+		chan->current_ctrl->zio_alarms |= ZIO_ALARM_LOST_TRIGGER;
+	spin_unlock_irqrestore(&cset->lock, flags);
+}
 
-	ztt->next_run += ztt->period;
-	mod_timer(&ztt->timer, ztt->next_run);
+/* This runs when the timer expires */
+static enum hrtimer_restart ztt_fn(struct hrtimer *timer)
+{
+	struct ztt_instance *ztt;
+	unsigned long overrun;
+
+	ztt = container_of(timer, struct ztt_instance, timer);
+	/* change_status can't wait for us: if we raced a disable, stop now */
+	if (ztt->stopped)
+		return HRTIMER_NORESTART;
+	zio_arm_trigger(&ztt->ti);
+
+	/*
+	 * Move the expiration forward by a whole number of periods,
+	 * starting from the previous expiration (not from now) so we
+	 * have no drift. Anything more than one period is a lost trigger.
+	 */
+	overrun = hrtimer_forward_now(timer, ns_to_ktime(ztt->period));
+	if (overrun > 1)
+		ztt_lost_periods(ztt, overrun - 1);
+	return HRTIMER_RESTART;
 }
 
 /*
@@ -136,12 +199,6 @@ static int ztt_config(struct zio_ti *ti, struct zio_control *ctrl)
 	pr_debug("%s:%d\n", __func__, __LINE__);
 	return 0;
 }
-static void ztt_start_timer(struct ztt_instance *ztt)
-{
-	ztt->next_run = jiffies + 1;
-	ztt_resync(ztt);
-	mod_timer(&ztt->timer, ztt->next_run);
-}
 static struct zio_ti *ztt_create(struct zio_trigger_type *trig,
 				 struct zio_cset *cset,
 				 struct zio_control *ctrl, fmode_t flags)
@@ -159,11 +216,12 @@ static struct zio_ti *ztt_create(struct zio_trigger_type *trig,
 	ti->cset = cset;
 
 	/* Fill own fields */
-	setup_timer(&ztt->timer, ztt_fn,
-		    (unsigned long)(&ztt->ti));
-	ztt->period = msecs_to_jiffies(ztt_ext_attr[0].value);
-	ztt->phase = msecs_to_jiffies(ztt_ext_attr[1].value);
-	ztt_start_timer(ztt);
+	hrtimer_init(&ztt->timer, CLOCK_REALTIME, HRTIMER_MODE_ABS);
+	ztt->timer.function = ztt_fn;
+	ztt->period = (uint64_t)ztt_ext_attr[0].value * NSEC_PER_MSEC;
+	ztt->phase = (uint64_t)ztt_ext_attr[1].value * NSEC_PER_MSEC;
+	ztt->catch_up = ztt_ext_attr[2].value;
+	ztt_resync(ztt);
 
 	return ti;
 }
@@ -174,7 +232,7 @@ static void ztt_destroy(struct zio_ti *ti)
 
 	pr_debug("%s:%d\n", __func__, __LINE__);
 	ztt = to_ztt_instance(ti);
-	del_timer_sync(&ztt->timer);
+	hrtimer_cancel(&ztt->timer);
 	kfree(ztt);
 }
 
@@ -185,10 +243,12 @@ static void ztt_change_status(struct zio_ti *ti, unsigned int status)
 	pr_debug("%s:%d status=%d\n", __func__, __LINE__, status);
 	ztt = to_ztt_instance(ti);
 
+	ztt->stopped = status;
 	if (!status) {	/* enable */
-		ztt_start_timer(ztt);
-	} else {	/* disable */
-		del_timer(&ztt->timer);
+		ztt_resync(ztt);
+	} else {	/* disable: we hold the cset lock, so don't wait */
+		/* If running, ztt_fn restarts once, and then stops itself */
+		hrtimer_try_to_cancel(&ztt->timer);
 	}
 }
 
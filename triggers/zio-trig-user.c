@@ -20,6 +20,10 @@
 #define ZTU_DEFAULT_BLOCK_SIZE 16
 
 static ZIO_ATTR_DEFINE_STD(ZIO_TRG, ztu_std_attr) = {
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_N_SHOTS, ZIO_RW_PERM,
+		 0 /* no addr needed */, 0 /* infinite */),
+	ZIO_ATTR(trig, ZIO_ATTR_TRIG_PRE_SAMP, ZIO_RW_PERM,
+		 0 /* no addr needed */, 0),
 	ZIO_ATTR(trig, ZIO_ATTR_TRIG_POST_SAMP, ZIO_RW_PERM,
 		 0 /* no addr needed */, ZTU_DEFAULT_BLOCK_SIZE),
 };
@@ -36,20 +40,6 @@ struct zio_sysfs_operations ztu_s_ops = {
 	.conf_set = ztu_conf_set,
 };
 
-/*
- * zio_all_block_ready
- * It returns 1 if all channels have an active_block, otherwise it returns 0
- */
-static inline unsigned int zio_all_block_ready(struct zio_cset *cset)
-{
-	struct zio_channel *chan;
-
-	chan_for_each(chan, cset)
-		if (!chan->active_block)
-			return 0;
-	return 1;
-}
-
 static int ztu_data_done(struct zio_cset *cset)
 {
 	int rearm;
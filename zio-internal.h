@@ -16,6 +16,7 @@ extern const struct attribute_group *def_chan_groups_ptr[];
 extern const struct attribute_group *def_ti_groups_ptr[];
 extern const struct attribute_group *def_bi_groups_ptr[];
 extern struct bin_attribute zio_bin_attr[];
+extern struct bin_attribute zio_dev_bin_attr[];
 /* Defined in object.c, used also in bus.c  */
 extern struct device_type zdevhw_device_type;
 extern struct device_type zdev_device_type;
@@ -72,8 +73,28 @@ extern void zio_default_buffer_exit(void);
 extern int zio_default_trigger_init(void);
 extern void zio_default_trigger_exit(void);
 
+/* Defined in helpers.c */
+extern int zio_done_queue_init(void);
+extern void zio_done_queue_exit(void);
+extern void zio_done_queue_flush(void);
+extern int zio_cset_acq_config(struct zio_cset *cset);
+extern int zio_cset_acq_set(struct zio_cset *cset, int *value, int val);
+extern void zio_cset_set_active_blocks(struct zio_cset *cset, unsigned int n);
+extern void zio_cset_acq_stop(struct zio_cset *cset);
+extern void __zio_arm_trigger(struct zio_ti *ti);
+extern int __zio_trigger_last_shot(struct zio_ti *ti);
+
+/* Defined in history.c */
+extern int zio_history_set(struct zio_cset *cset, unsigned int chunk);
+extern void zio_history_free(struct zio_cset *cset, struct zio_history *h);
+extern void __zio_history_reset(struct zio_cset *cset);
+extern int zio_history_data_done(struct zio_cset *cset);
+extern int zio_history_fire(struct zio_cset *cset);
+extern unsigned int zio_history_chunk(struct zio_cset *cset);
+
 /* Defined in sysfs.c */
 extern void __ctrl_update_nsamples(struct zio_ti *ti);
+extern void __zio_chan_sync_enabled(struct zio_channel *chan);
 extern void __zattr_trig_init_ctrl(struct zio_ti *ti, struct zio_control *ctrl);
 extern int __check_dev_zattr(struct zio_attribute_set *parent,
 		      struct zio_attribute_set *this);